@@ -0,0 +1,292 @@
+// Copyright (c) 2024, Chang Liu <github.com/slontia>. All rights reserved.
+//
+// This source code is licensed under MIT (found in the LICENSE file).
+
+#pragma once
+
+#include <atomic>
+#include <coroutine>
+#include <cstdint>
+#include <utility>
+
+namespace slontia {
+
+// The executor of `async_shared_mutex` should provide `schedule(std::coroutine_handle<>)`, which resumes the coroutine
+// later on one of its threads. It is invoked by the thread which releases the mutex, so it should be thread-safe and
+// should not resume the coroutine inline.
+template <typename Executor>
+concept async_executor = requires(Executor& executor, std::coroutine_handle<> handle) { executor.schedule(handle); };
+
+// The `async_shared_mutex` class template is a shared mutex for coroutines. Instead of blocking the thread,
+// `co_await mutex.lock()` and `co_await mutex.lock_shared()` suspend the coroutine until the ownership is granted, and
+// the coroutine is resumed by `Executor`.
+//
+// `async_shared_mutex` has the same characteristics as `slontia::shared_mutex`, and besides:
+// - A suspended coroutine is queued in an intrusive list, and is granted the ownership before it is resumed, so it
+//   never retries;
+// - Queued writers are granted in order of arrival, and the queued readers are granted together when no writers are
+//   queued;
+// - The number of readers should be less than (1 << 29);
+// - There are no blocking `lock` and `lock_shared`.
+//
+// The state of the mutex is an atomic variable. The coroutines arriving at a held mutex are pushed to a lock-free stack.
+// Threads which release the mutex or push coroutines dispatch the ownership, but only one of them does it at a time,
+// which moves the pushed coroutines to the private FIFO queues and grants the ownership by CAS on the state.
+template <async_executor Executor>
+class async_shared_mutex
+{
+    class awaiter_base;
+
+  public:
+    class lock_awaiter;
+    class lock_shared_awaiter;
+
+    explicit async_shared_mutex(Executor& executor) noexcept : executor_{executor} {}
+
+    async_shared_mutex(const async_shared_mutex&) = delete;
+    async_shared_mutex& operator=(const async_shared_mutex&) = delete;
+
+    // Returns an awaitable which acquires an exclusive ownership of the mutex. While the mutex is held by other
+    // coroutines, `co_await` of the awaitable suspends the current coroutine until the ownership is granted.
+    lock_awaiter lock() noexcept { return lock_awaiter{*this}; }
+
+    // Tries to lock the mutex. Returns immediately. On successful lock acquisition returns true, otherwise returns
+    // false.
+    bool try_lock() noexcept
+    {
+        std::uint32_t state = 0;
+        return state_.compare_exchange_strong(state, k_writer_holding, std::memory_order::acquire,
+                std::memory_order::relaxed);
+    }
+
+    // Unlocks the mutex, and grants the ownership to the queued coroutines.
+    // The mutex must be locked in exclusive mode.
+    void unlock() noexcept
+    {
+        if (state_.fetch_sub(k_writer_holding, std::memory_order::release) & k_queued_mask) {
+            dispatch_();
+        }
+    }
+
+    // Returns an awaitable which acquires a shared ownership of the mutex. While the mutex is held or acquired by
+    // writers, `co_await` of the awaitable suspends the current coroutine until the ownership is granted.
+    lock_shared_awaiter lock_shared() noexcept { return lock_shared_awaiter{*this}; }
+
+    // Tries to lock the mutex in shared mode. Returns immediately. On successful lock acquisition returns true,
+    // otherwise returns false.
+    bool try_lock_shared() noexcept
+    {
+        auto state = state_.load(std::memory_order::relaxed);
+        do {
+            if (state & ~k_reader_mask) {
+                return false;
+            }
+        } while (!state_.compare_exchange_weak(state, state + 1, std::memory_order::acquire,
+                    std::memory_order::relaxed));
+        return true;
+    }
+
+    // Releases the shared ownership, and grants the ownership to the queued coroutines if it is the last reader.
+    // The mutex must be locked in shared mode.
+    void unlock_shared() noexcept
+    {
+        const auto state = state_.fetch_sub(1, std::memory_order::release) - 1;
+        if ((state & k_reader_mask) == 0 && (state & k_queued_mask)) {
+            dispatch_();
+        }
+    }
+
+  private:
+    // Enqueues `awaiter`, which will be granted the ownership and resumed by `executor_`.
+    void enqueue_(awaiter_base& awaiter) noexcept
+    {
+        awaiter.next_ = incoming_.load(std::memory_order::relaxed);
+        while (!incoming_.compare_exchange_weak(awaiter.next_, &awaiter, std::memory_order::release,
+                    std::memory_order::relaxed)) {
+        }
+        dispatch_();
+    }
+
+    // Grants the ownership to the queued coroutines as far as possible. If another thread is dispatching, it will
+    // dispatch again on behalf of us.
+    void dispatch_() noexcept
+    {
+        pending_.store(true, std::memory_order::seq_cst);
+        while (!dispatching_.exchange(true, std::memory_order::seq_cst)) {
+            pending_.store(false, std::memory_order::seq_cst);
+            dispatch_queued_();
+            dispatching_.store(false, std::memory_order::seq_cst);
+            if (!pending_.load(std::memory_order::seq_cst)) {
+                break;
+            }
+        }
+    }
+
+    // Only the dispatching thread invokes it.
+    void dispatch_queued_() noexcept
+    {
+        // Move the pushed awaiters to the FIFO queues. They are pushed in the reverse order.
+        awaiter_base* reversed = nullptr;
+        for (auto* awaiter = incoming_.exchange(nullptr, std::memory_order::acquire); awaiter; ) {
+            auto* const next = awaiter->next_;
+            awaiter->next_ = reversed;
+            reversed = awaiter;
+            awaiter = next;
+        }
+        while (reversed) {
+            auto* const awaiter = std::exchange(reversed, reversed->next_);
+            (awaiter->exclusive_ ? writers_ : readers_).push(*awaiter);
+        }
+
+        auto state = state_.load(std::memory_order::relaxed);
+        for (;;) {
+            if (!writers_.empty()) {
+                if ((state & (k_writer_holding | k_reader_mask)) == 0) {
+                    // Grant the exclusive ownership to the first writer. The queued readers keep waiting.
+                    const auto new_state = k_writer_holding | (writers_.size_ > 1 ? k_writer_queued : 0) |
+                        (readers_.empty() ? 0 : k_reader_queued);
+                    if (state_.compare_exchange_weak(state, new_state, std::memory_order::acquire,
+                                std::memory_order::relaxed)) {
+                        resume_(writers_.pop());
+                        return;
+                    }
+                } else if (state_.compare_exchange_weak(state,
+                            state | k_writer_queued | (readers_.empty() ? 0 : k_reader_queued),
+                            std::memory_order::relaxed, std::memory_order::relaxed)) {
+                    // Mark that writers are queued, so new readers are queued as well, and the last one releasing the
+                    // mutex dispatches again.
+                    return;
+                }
+            } else if (!readers_.empty()) {
+                if ((state & k_writer_holding) == 0) {
+                    // Grant the shared ownerships to all the queued readers.
+                    if (state_.compare_exchange_weak(state, (state & k_reader_mask) + readers_.size_,
+                                std::memory_order::acquire, std::memory_order::relaxed)) {
+                        while (!readers_.empty()) {
+                            resume_(readers_.pop());
+                        }
+                        return;
+                    }
+                } else if (state_.compare_exchange_weak(state, (state & ~k_writer_queued) | k_reader_queued,
+                            std::memory_order::relaxed, std::memory_order::relaxed)) {
+                    return;
+                }
+            } else if ((state & k_queued_mask) == 0 || state_.compare_exchange_weak(state, state & ~k_queued_mask,
+                        std::memory_order::relaxed, std::memory_order::relaxed)) {
+                return;
+            }
+        }
+    }
+
+    void resume_(awaiter_base& awaiter) noexcept { executor_.schedule(awaiter.handle_); }
+
+    // The FIFO queue of awaiters, which is only visited by the dispatching thread.
+    struct awaiter_queue
+    {
+        bool empty() const noexcept { return head_ == nullptr; }
+
+        void push(awaiter_base& awaiter) noexcept
+        {
+            awaiter.next_ = nullptr;
+            (head_ ? tail_->next_ : head_) = &awaiter;
+            tail_ = &awaiter;
+            ++size_;
+        }
+
+        awaiter_base& pop() noexcept
+        {
+            auto* const awaiter = std::exchange(head_, head_->next_);
+            --size_;
+            return *awaiter;
+        }
+
+        awaiter_base* head_{nullptr};
+        awaiter_base* tail_{nullptr};
+        std::uint32_t size_{0};
+    };
+
+    static constexpr std::uint32_t k_reader_mask = (1u << 29) - 1;
+    static constexpr std::uint32_t k_reader_queued = 1u << 29;
+    static constexpr std::uint32_t k_writer_queued = 1u << 30;
+    static constexpr std::uint32_t k_writer_holding = 1u << 31;
+    static constexpr std::uint32_t k_queued_mask = k_reader_queued | k_writer_queued;
+
+    // The bits 0-28 are the number of readers holding the mutex, the bit 29 is set if readers are queued, the bit 30 is
+    // set if writers are queued, and the bit 31 is set if a writer is holding the mutex.
+    std::atomic<std::uint32_t> state_{0};
+
+    // The stack of the awaiters which have not been moved to the queues.
+    std::atomic<awaiter_base*> incoming_{nullptr};
+
+    // Set if a thread is dispatching, and set if another thread requests to dispatch again.
+    std::atomic<bool> dispatching_{false};
+    std::atomic<bool> pending_{false};
+
+    awaiter_queue writers_;
+    awaiter_queue readers_;
+
+    Executor& executor_;
+};
+
+// The queue node of a suspended coroutine. It lives in the coroutine frame until the coroutine is resumed.
+template <async_executor Executor>
+class async_shared_mutex<Executor>::awaiter_base
+{
+    friend class async_shared_mutex;
+
+  public:
+    awaiter_base(const awaiter_base&) = delete;
+    awaiter_base& operator=(const awaiter_base&) = delete;
+
+  protected:
+    awaiter_base(async_shared_mutex& mutex, const bool exclusive) noexcept : mutex_{mutex}, exclusive_{exclusive} {}
+
+    void suspend_(const std::coroutine_handle<> handle) noexcept
+    {
+        handle_ = handle;
+        mutex_.enqueue_(*this);
+    }
+
+    async_shared_mutex& mutex_;
+
+  private:
+    const bool exclusive_;
+    std::coroutine_handle<> handle_;
+    awaiter_base* next_{nullptr};
+};
+
+// The awaitable returned by `lock`. The exclusive ownership is held after `co_await` returns.
+template <async_executor Executor>
+class async_shared_mutex<Executor>::lock_awaiter : private awaiter_base
+{
+    friend class async_shared_mutex;
+
+  public:
+    bool await_ready() noexcept { return this->mutex_.try_lock(); }
+
+    void await_suspend(const std::coroutine_handle<> handle) noexcept { this->suspend_(handle); }
+
+    void await_resume() const noexcept {}
+
+  private:
+    explicit lock_awaiter(async_shared_mutex& mutex) noexcept : awaiter_base{mutex, true} {}
+};
+
+// The awaitable returned by `lock_shared`. The shared ownership is held after `co_await` returns.
+template <async_executor Executor>
+class async_shared_mutex<Executor>::lock_shared_awaiter : private awaiter_base
+{
+    friend class async_shared_mutex;
+
+  public:
+    bool await_ready() noexcept { return this->mutex_.try_lock_shared(); }
+
+    void await_suspend(const std::coroutine_handle<> handle) noexcept { this->suspend_(handle); }
+
+    void await_resume() const noexcept {}
+
+  private:
+    explicit lock_shared_awaiter(async_shared_mutex& mutex) noexcept : awaiter_base{mutex, false} {}
+};
+
+}
@@ -0,0 +1,310 @@
+// Copyright (c) 2024, Chang Liu <github.com/slontia>. All rights reserved.
+//
+// This source code is licensed under MIT (found in the LICENSE file).
+
+#pragma once
+
+#include "shared_mutex.h"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace slontia {
+
+namespace internal {
+
+// Returns the NUMA node which the current thread runs on, or 0 if it is unknown.
+inline std::uint32_t query_this_thread_numa_node() noexcept
+{
+#if __linux__
+    unsigned cpu = 0;
+    unsigned node = 0;
+    return syscall(SYS_getcpu, &cpu, &node, nullptr) == 0 ? node : 0;
+#elif _WIN32
+    PROCESSOR_NUMBER processor;
+    GetCurrentProcessorNumberEx(&processor);
+    USHORT node = 0;
+    return GetNumaProcessorNodeEx(&processor, &node) ? node : 0;
+#else
+    return 0;
+#endif
+}
+
+inline std::uint32_t& cached_this_thread_numa_node() noexcept
+{
+    thread_local std::uint32_t node = query_this_thread_numa_node();
+    return node;
+}
+
+}
+
+// Returns the NUMA node of the current thread used by `slontia::cohort_shared_mutex`. The node is queried when the
+// thread first invokes it, so the thread should be pinned to the node (e.g. by `sched_setaffinity`) before that,
+// otherwise it may migrate to another node later.
+inline std::uint32_t this_thread_numa_node() noexcept { return internal::cached_this_thread_numa_node(); }
+
+// Overrides the NUMA node of the current thread used by `slontia::cohort_shared_mutex`, e.g. after the thread is pinned
+// to another node.
+inline void set_this_thread_numa_node(const std::uint32_t node) noexcept
+{
+    internal::cached_this_thread_numa_node() = node;
+}
+
+namespace internal {
+
+// The `slontia::internal::cohort_shared_mutex` class template is a NUMA-aware variant of
+// `slontia::internal::shared_mutex` following the cohort locking. Each of the `k_node_num` NUMA nodes has a local mutex
+// for the writers running on it, and the exclusive ownership is arbitrated among the nodes by a global
+// `slontia::internal::shared_mutex`. A writer releasing the mutex hands the global mutex over to a writer waiting on
+// the same node, so the protected data stays in the caches of the node. To avoid starving other nodes, the global mutex
+// is released after `k_max_handoff_num` consecutive handoffs.
+//
+// `slontia::internal::cohort_shared_mutex` has the same characteristics as `slontia::internal::shared_mutex`, and
+// besides:
+// - Readers only modify the reader counter of their node, which is placed in an individual cache line;
+// - Writers running on the same node as the holder are preferred, so the order of acquisition is not fair;
+// - The footprint is about `k_node_num * 2 + 2` cache lines.
+//
+// The node of a thread is decided by `slontia::this_thread_numa_node()`.
+template <typename AtomicUInt32, std::size_t k_node_num, std::uint32_t k_max_handoff_num>
+class cohort_shared_mutex
+{
+    static_assert(k_node_num > 0, "there should be at least one node");
+    static_assert(k_max_handoff_num > 0, "a writer should be able to hand the global mutex over");
+
+  public:
+    // Acquires an exclusive ownership of the `cohort_shared_mutex`. If another thread is holding an exclusive lock or
+    // a shared lock on the same `cohort_shared_mutex` the a call to lock will block execution until all such locks are
+    // released. While `cohort_shared_mutex` is locked in an exclusive mode, no other lock of any kind can also be held.
+    void lock() noexcept
+    {
+        // Ensure that no readers can hold shared ownerships anymore.
+        increase_writing_num_();
+
+        // Compete with other writers on the same node.
+        auto& node = this_thread_node_();
+        node.writer_.waiting_num_.fetch_add(1, std::memory_order::seq_cst);
+        atomic_wait_until_zero([&] { return try_lock_local_(node); }, node.writer_.holding_);
+        node.writer_.waiting_num_.fetch_sub(1, std::memory_order::relaxed);
+
+        // Compete with writers on other nodes, unless the global mutex has been handed over to us.
+        if (!node.writer_.global_owned_) {
+            global_.lock();
+            node.writer_.global_owned_ = true;
+        }
+        holding_node_ = &node;
+
+        // Wait for the readers which have held shared ownerships before we increased `writing_num_`.
+        wait_until_no_readers_();
+    }
+
+    // Tries to lock the mutex. Returns immediately. On successful lock acquisition returns true, otherwise returns
+    // false.
+    bool try_lock() noexcept
+    {
+        // Ensure that no readers can hold shared ownerships anymore.
+        increase_writing_num_();
+
+        auto& node = this_thread_node_();
+        if (try_lock_local_(node) > 0) {
+            // Another writer on the same node is holding the mutex.
+            decrease_writing_num_();
+            return false;
+        }
+        if (!node.writer_.global_owned_) {
+            if (!global_.try_lock()) {
+                // A writer on another node is holding the mutex.
+                unlock_local_(node);
+                decrease_writing_num_();
+                return false;
+            }
+            node.writer_.global_owned_ = true;
+        }
+        holding_node_ = &node;
+        if (reader_num_() > 0) {
+            // Some readers are holding the mutex.
+            unlock();
+            return false;
+        }
+        return true;
+    }
+
+    // Unlocks the mutex. If other writers are waiting on the same node as the thread which locked the mutex, the global
+    // mutex is handed over to them.
+    // The mutex must be locked by a thread. The thread need not be the current thread of execution.
+    void unlock() noexcept
+    {
+        auto& node = *holding_node_;
+        if (node.writer_.handoff_num_ < k_max_handoff_num &&
+                node.writer_.waiting_num_.load(std::memory_order::relaxed) > 0) {
+            // The waiting writer will lock the local mutex eventually, and take over the global mutex.
+            ++node.writer_.handoff_num_;
+        } else {
+            node.writer_.handoff_num_ = 0;
+            node.writer_.global_owned_ = false;
+            global_.unlock();
+        }
+        unlock_local_(node);
+
+        // Notify all waiting readers if there are no waiting writers.
+        decrease_writing_num_();
+    }
+
+    // Acquires shared ownership of the mutex. If another thread is acquiring or holding the mutex in exclusive
+    // ownership, a call to `lock_shared` will block execution until shared ownership can be acquired.
+    void lock_shared() noexcept
+    {
+        auto& node = this_thread_node_();
+        atomic_wait_until_zero([&] { return try_lock_shared_internal_(node); }, writing_num_);
+    }
+
+    // Tries to lock the mutex in shared mode. Returns immediately. On successful lock acquisition returns true,
+    // otherwise returns false.
+    bool try_lock_shared() noexcept { return try_lock_shared_internal_(this_thread_node_()) == 0; }
+
+    // Releases the mutex from shared ownership by the calling thread.
+    // The mutex must be locked by a thread in shared mode. The thread need not be the current thread of execution.
+    void unlock_shared() noexcept { unlock_shared_internal_(this_thread_node_()); }
+
+  protected:
+    // The states of a node. The reader counter and the local mutex are placed in individual cache lines, since they are
+    // modified by different threads.
+    struct node_type
+    {
+        struct alignas(k_cache_line_size) reader_type
+        {
+            // The number of threads on the node that are holding the mutex for shared ownership.
+            AtomicUInt32 holding_num_{0};
+        };
+
+        struct alignas(k_cache_line_size) writer_type
+        {
+            // The value is 1 if a writer on the node is holding the local mutex, otherwise 0.
+            AtomicUInt32 holding_{0};
+
+            // The number of writers on the node that are waiting for the local mutex.
+            AtomicUInt32 waiting_num_{0};
+
+            // Whether the global mutex is held on behalf of the node, and the number of consecutive handoffs. They are
+            // only visited by the writer holding the local mutex.
+            bool global_owned_{false};
+            std::uint32_t handoff_num_{0};
+        };
+
+        reader_type reader_;
+        writer_type writer_;
+    };
+
+    void increase_writing_num_() noexcept { writing_num_.fetch_add(1, std::memory_order::seq_cst); }
+
+    // Notify all waiting readers if there are no waiting writers.
+    // We can only decrease `writing_num_` by invoking this function. Otherwise, threads acquiring shared ownerships can
+    // be blocked infinitly.
+    bool decrease_writing_num_() noexcept
+    {
+        if (writing_num_.fetch_sub(1, std::memory_order::release) == 1) {
+            writing_num_.notify_all();
+            return true;
+        }
+        return false;
+    }
+
+    // Set 1 to the local mutex of `node` if it is 0.
+    // Return the current value of the local mutex. The value of 0 indicates we win the competition on the node.
+    static std::uint32_t try_lock_local_(node_type& node) noexcept
+    {
+        std::uint32_t holding = 0;
+        node.writer_.holding_.compare_exchange_strong(holding, 1, std::memory_order::seq_cst);
+        return holding;
+    }
+
+    static void unlock_local_(node_type& node) noexcept
+    {
+        node.writer_.holding_.store(0, std::memory_order::seq_cst);
+        // The sequentially-consistent ordering guarantees that either we observe the waiting writer here, or the
+        // waiting writer observes the release of the local mutex.
+        if (node.writer_.waiting_num_.load(std::memory_order::seq_cst) > 0) {
+            node.writer_.holding_.notify_one();
+        }
+    }
+
+    // Increase the reader counter of `node` by 1 if the value of `writing_num` is 0.
+    // Return the current value of `writing_num_`. The value of 0 indicates we lock in shared mode successfully.
+    std::uint32_t try_lock_shared_internal_(node_type& node) noexcept
+    {
+        auto writing_num = writing_num_.load(std::memory_order::acquire);
+        if (writing_num == 0) {
+            // The sequentially-consistent ordering on both the reader side and the writer side guarantees that either
+            // the writer observes our increment when summing up the reader counters, or we observe the increment of
+            // `writing_num_` here.
+            node.reader_.holding_num_.fetch_add(1, std::memory_order::seq_cst);
+            if ((writing_num = writing_num_.load(std::memory_order::seq_cst)) > 0) [[unlikely]] {
+                unlock_shared_internal_(node);
+            }
+        }
+        return writing_num;
+    }
+
+    void unlock_shared_internal_(node_type& node) noexcept
+    {
+        node.reader_.holding_num_.fetch_sub(1, std::memory_order::seq_cst);
+        // Only the writer holding the global mutex waits for the readers, and it only has to be woken up when the last
+        // reader releases.
+        if (writing_num_.load(std::memory_order::seq_cst) > 0 && reader_num_() == 0) {
+            reader_released_num_.fetch_add(1, std::memory_order::release);
+            reader_released_num_.notify_one();
+        }
+    }
+
+    // Blocks until all the readers release their shared ownerships.
+    void wait_until_no_readers_() noexcept
+    {
+        for (;;) {
+            const auto reader_released_num = reader_released_num_.load(std::memory_order::acquire);
+            if (reader_num_() == 0) {
+                return;
+            }
+            reader_released_num_.wait(reader_released_num, std::memory_order::acquire);
+        }
+    }
+
+    // Returns the number of threads holding the mutex in shared mode.
+    // Since a shared ownership can be released on a different node, a single reader counter can be underflowed, but
+    // the sum of all reader counters is always correct.
+    std::uint32_t reader_num_() const noexcept
+    {
+        std::uint32_t reader_num = 0;
+        for (const auto& node : nodes_) {
+            reader_num += node.reader_.holding_num_.load(std::memory_order::seq_cst);
+        }
+        return reader_num;
+    }
+
+    node_type& this_thread_node_() noexcept { return nodes_[this_thread_numa_node() % k_node_num]; }
+
+    // The number of threads that are acquiring the mutex for exclusive ownership.
+    alignas(k_cache_line_size) AtomicUInt32 writing_num_{0};
+
+    // Increased when the last reader releases while writers are waiting. The writer waits on it for the readers.
+    AtomicUInt32 reader_released_num_{0};
+
+    // The node on behalf of which the exclusive ownership is held, which is only visited by the writer holding it.
+    node_type* holding_node_{nullptr};
+
+    // Arbitrates the exclusive ownership among the nodes.
+    alignas(k_cache_line_size) shared_mutex<AtomicUInt32> global_;
+
+    std::array<node_type, k_node_num> nodes_;
+};
+
+}
+
+// The threads on the same one of `k_node_num` NUMA nodes share the reader counter and the local mutex, and the global
+// mutex is handed over on the same node for at most `k_max_handoff_num` consecutive acquisitions.
+template <std::size_t k_node_num = 4, std::uint32_t k_max_handoff_num = 64>
+struct cohort_shared_mutex
+    : public internal::cohort_shared_mutex<std::atomic<std::uint32_t>, k_node_num, k_max_handoff_num> {};
+
+}
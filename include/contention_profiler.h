@@ -0,0 +1,302 @@
+// Copyright (c) 2024, Chang Liu <github.com/slontia>. All rights reserved.
+//
+// This source code is licensed under MIT (found in the LICENSE file).
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <ostream>
+#include <source_location>
+#include <vector>
+
+namespace slontia {
+
+// The contention recorded for one call site by `slontia::contention_profiler`.
+struct contention_site
+{
+    std::source_location location_;
+
+    // The number of sampled acquisitions which have to wait.
+    std::uint64_t contended_num_{0};
+
+    // The total and the maximum wait time of the sampled acquisitions.
+    std::chrono::nanoseconds total_wait_time_{0};
+    std::chrono::nanoseconds max_wait_time_{0};
+};
+
+// The `slontia::contention_profiler` class attributes the wait time of the sampled acquisitions of
+// `slontia::mutex_protect_wrapper` objects with the `sampled_profile` policy to their call sites, so that the call
+// sites causing contention can be found in production.
+//
+// One of every `sample_period()` acquisitions of each thread is sampled. A sampled acquisition tries to acquire the
+// mutex without blocking first, and only if it fails, the wait time is measured and recorded in the buffer of the
+// current thread. The buffers are only written by their owner threads without locks, and are reused by the threads
+// created later after the owner threads exit, so the memory is bounded by the number of concurrent threads. The other
+// acquisitions only decrease a thread-local counter, so the profiler can be kept on in production.
+class contention_profiler
+{
+  public:
+    static constexpr std::uint32_t k_default_sample_period = 64;
+
+    // Samples one of every `period` acquisitions of each thread. The value of 0 disables the sampling.
+    static void set_sample_period(const std::uint32_t period) noexcept
+    {
+        sample_period_().store(period, std::memory_order::relaxed);
+        // Let the current thread apply the new period immediately. Other threads apply it at their next sampling.
+        sample_countdown_() = 1;
+    }
+
+    static std::uint32_t sample_period() noexcept { return sample_period_().load(std::memory_order::relaxed); }
+
+    // Returns true if the current acquisition of the current thread should be sampled.
+    static bool sample() noexcept
+    {
+        auto& countdown = sample_countdown_();
+        if (--countdown > 0) [[likely]] {
+            return false;
+        }
+        const auto period = sample_period();
+        // Check the period after a while if the sampling is disabled.
+        countdown = period > 0 ? period : k_disabled_check_period;
+        return period > 0;
+    }
+
+    // Records a sampled acquisition at `location` which has waited for `wait_time`.
+    static void record(const std::source_location& location, const std::chrono::nanoseconds wait_time) noexcept
+    {
+        this_thread_buffer_().record(location, static_cast<std::uint64_t>(std::max(wait_time.count(),
+                        std::chrono::nanoseconds::rep{0})));
+    }
+
+    // Returns the contention of all the call sites recorded by all the threads, ranked by the total wait time in
+    // descending order.
+    static std::vector<contention_site> report()
+    {
+        std::vector<contention_site> sites;
+        for (const thread_buffer* buffer = buffers_().load(std::memory_order::acquire); buffer;
+                buffer = buffer->next_) {
+            buffer->collect(sites);
+        }
+        std::sort(sites.begin(), sites.end(), [](const contention_site& a, const contention_site& b)
+                {
+                    return a.total_wait_time_ > b.total_wait_time_;
+                });
+        return sites;
+    }
+
+    // Writes the `top_n` call sites of `report()` to `os` in the form of a table.
+    static void dump(std::ostream& os, const std::size_t top_n = 10)
+    {
+        const auto sites = report();
+        os << "rank\tcontended\ttotal_wait_us\tmax_wait_us\tsite\n";
+        for (std::size_t i = 0; i < std::min(top_n, sites.size()); ++i) {
+            const auto& site = sites[i];
+            os << i + 1 << '\t' << site.contended_num_ << '\t'
+               << std::chrono::duration_cast<std::chrono::microseconds>(site.total_wait_time_).count() << '\t'
+               << std::chrono::duration_cast<std::chrono::microseconds>(site.max_wait_time_).count() << '\t'
+               << site.location_.file_name() << ':' << site.location_.line() << ' '
+               << site.location_.function_name() << '\n';
+        }
+    }
+
+    // Clears the records of all the threads. The acquisitions recorded concurrently may be lost or kept.
+    static void reset() noexcept
+    {
+        for (thread_buffer* buffer = buffers_().load(std::memory_order::acquire); buffer; buffer = buffer->next_) {
+            buffer->reset();
+        }
+    }
+
+  private:
+    static constexpr std::uint32_t k_disabled_check_period = 1 << 16;
+
+    // The number of call sites recorded by each thread. The samples of the call sites beyond it are dropped.
+    static constexpr std::size_t k_slot_num = 256;
+
+    struct slot
+    {
+        // The `location_` is published by storing its file name to `file_name_`, which is null for an unused slot.
+        std::atomic<const char*> file_name_{nullptr};
+        std::source_location location_;
+        std::atomic<std::uint64_t> contended_num_{0};
+        std::atomic<std::uint64_t> total_wait_ns_{0};
+        std::atomic<std::uint64_t> max_wait_ns_{0};
+    };
+
+    class thread_buffer
+    {
+      public:
+        void record(const std::source_location& location, const std::uint64_t wait_ns) noexcept
+        {
+            slot* const s = find_or_insert_(location);
+            if (!s) {
+                return;
+            }
+            s->contended_num_.fetch_add(1, std::memory_order::relaxed);
+            s->total_wait_ns_.fetch_add(wait_ns, std::memory_order::relaxed);
+            auto max_wait_ns = s->max_wait_ns_.load(std::memory_order::relaxed);
+            while (max_wait_ns < wait_ns && !s->max_wait_ns_.compare_exchange_weak(max_wait_ns, wait_ns,
+                        std::memory_order::relaxed)) {
+            }
+        }
+
+        // Merges the recorded call sites into `sites`. The same call site may be recorded by several threads, and
+        // `std::source_location::current()` may return different strings for it in different translation units, so
+        // the call sites are identified by the contents.
+        void collect(std::vector<contention_site>& sites) const
+        {
+            for (const auto& s : slots_) {
+                const char* const file_name = s.file_name_.load(std::memory_order::acquire);
+                const auto contended_num = s.contended_num_.load(std::memory_order::relaxed);
+                if (!file_name || contended_num == 0) {
+                    continue;
+                }
+                const auto it = std::find_if(sites.begin(), sites.end(), [&](const contention_site& site)
+                        {
+                            return site.location_.line() == s.location_.line() &&
+                                site.location_.column() == s.location_.column() &&
+                                std::strcmp(site.location_.file_name(), file_name) == 0 &&
+                                std::strcmp(site.location_.function_name(), s.location_.function_name()) == 0;
+                        });
+                auto& site = it != sites.end() ? *it : sites.emplace_back(contention_site{.location_ = s.location_});
+                site.contended_num_ += contended_num;
+                site.total_wait_time_ += std::chrono::nanoseconds(s.total_wait_ns_.load(std::memory_order::relaxed));
+                site.max_wait_time_ = std::max(site.max_wait_time_,
+                        std::chrono::nanoseconds(s.max_wait_ns_.load(std::memory_order::relaxed)));
+            }
+        }
+
+        void reset() noexcept
+        {
+            for (auto& s : slots_) {
+                s.contended_num_.store(0, std::memory_order::relaxed);
+                s.total_wait_ns_.store(0, std::memory_order::relaxed);
+                s.max_wait_ns_.store(0, std::memory_order::relaxed);
+            }
+        }
+
+        // The buffers are linked in a list which is only appended to, so the list can be traversed without locks.
+        thread_buffer* next_{nullptr};
+
+        // True if the owner thread has exited so that the buffer can be taken over by a new thread.
+        std::atomic<bool> retired_{false};
+
+      private:
+        // Only the owner thread inserts slots, so the probing needs no synchronization.
+        slot* find_or_insert_(const std::source_location& location) noexcept
+        {
+            const auto hash =
+                std::hash<const char*>{}(location.file_name()) ^ (location.line() * 31 + location.column());
+            for (std::size_t i = 0; i < k_slot_num; ++i) {
+                slot& s = slots_[(hash + i) % k_slot_num];
+                const char* const file_name = s.file_name_.load(std::memory_order::relaxed);
+                if (!file_name) {
+                    s.location_ = location;
+                    s.file_name_.store(location.file_name(), std::memory_order::release);
+                    return &s;
+                }
+                if (file_name == location.file_name() && s.location_.line() == location.line() &&
+                        s.location_.column() == location.column() &&
+                        s.location_.function_name() == location.function_name()) {
+                    return &s;
+                }
+            }
+            return nullptr;
+        }
+
+        std::array<slot, k_slot_num> slots_;
+    };
+
+    // Takes over a retired buffer, or links a new one to the list.
+    class thread_buffer_holder
+    {
+      public:
+        thread_buffer_holder()
+        {
+            auto& head = buffers_();
+            for (thread_buffer* buffer = head.load(std::memory_order::acquire); buffer; buffer = buffer->next_) {
+                bool retired = true;
+                if (buffer->retired_.compare_exchange_strong(retired, false, std::memory_order::acquire)) {
+                    buffer_ = buffer;
+                    return;
+                }
+            }
+            // The buffers are never freed, since the reports may be read after the threads exit.
+            buffer_ = new thread_buffer;
+            buffer_->next_ = head.load(std::memory_order::relaxed);
+            while (!head.compare_exchange_weak(buffer_->next_, buffer_, std::memory_order::release,
+                        std::memory_order::relaxed)) {
+            }
+        }
+
+        ~thread_buffer_holder() { buffer_->retired_.store(true, std::memory_order::release); }
+
+        thread_buffer& get() noexcept { return *buffer_; }
+
+      private:
+        thread_buffer* buffer_;
+    };
+
+    static std::atomic<std::uint32_t>& sample_period_() noexcept
+    {
+        static std::atomic<std::uint32_t> period{k_default_sample_period};
+        return period;
+    }
+
+    static std::uint32_t& sample_countdown_() noexcept
+    {
+        // The first acquisition of each thread is sampled.
+        thread_local std::uint32_t countdown = 1;
+        return countdown;
+    }
+
+    static std::atomic<thread_buffer*>& buffers_() noexcept
+    {
+        static std::atomic<thread_buffer*> head{nullptr};
+        return head;
+    }
+
+    static thread_buffer& this_thread_buffer_()
+    {
+        thread_local thread_buffer_holder holder;
+        return holder.get();
+    }
+};
+
+// The profile policies decide whether the acquisitions of `mutex_protect_wrapper` are profiled by
+// `slontia::contention_profiler`. Each profile policy provides:
+// - `k_enabled`, which is true if the acquisitions are sampled;
+// - `sample()`, which returns true if the current acquisition should be profiled;
+// - `record(location, wait_time)`, which records a contended acquisition at the call site `location`.
+//
+// `no_profile` is the default. It takes no space and records nothing.
+struct no_profile
+{
+    static constexpr bool k_enabled = false;
+
+    static bool sample() noexcept { return false; }
+
+    static void record(const std::source_location&, std::chrono::nanoseconds) noexcept {}
+};
+
+// `sampled_profile` records the sampled contended acquisitions by `slontia::contention_profiler`.
+struct sampled_profile
+{
+    static constexpr bool k_enabled = true;
+
+    static bool sample() noexcept { return contention_profiler::sample(); }
+
+    static void record(const std::source_location& location, const std::chrono::nanoseconds wait_time) noexcept
+    {
+        contention_profiler::record(location, wait_time);
+    }
+};
+
+}
@@ -0,0 +1,225 @@
+// Copyright (c) 2024, Chang Liu <github.com/slontia>. All rights reserved.
+//
+// This source code is licensed under MIT (found in the LICENSE file).
+
+#pragma once
+
+#include "shared_mutex.h"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <utility>
+
+namespace slontia {
+
+// The `cow_wrapper` class template wraps an object which is updated by copy-on-write. Readers pin the current version
+// of the object by `read`, and never block or contend with writers. A writer copies the current version, modifies the
+// copy and publishes it by swapping an atomic pointer, then reclaims the old version after all the readers which may
+// observe it have unpinned it. Writers are serialized by a `slontia::shared_mutex`.
+//
+// The retired versions are reclaimed by an epoch-based scheme. A reader announces itself on one of `k_slot_num` reader
+// counters of the current epoch, each of which occupies an individual cache line, and loads the current version. A
+// writer advances the epoch after publishing the new version, and waits until the reader counters of the previous epoch
+// drop to zero. The hot path of reading is an increment on the reader counter of the thread and a few loads of the
+// read-mostly states.
+//
+// `cow_wrapper` suits large objects which are read far more often than written (e.g. routing tables). Compared with
+// `mutex_protect_wrapper`:
+// - Reading does not modify any shared states except the reader counter of the thread;
+// - Each update copies the whole object, and blocks until the readers of the old version have unpinned it, so a thread
+//   must not update the object while it is pinning a version of the same `cow_wrapper`.
+// `cow_wrapper` is neither copyable nor movable. It must not be destructed while any versions are pinned.
+template <typename T, std::size_t k_slot_num = 16>
+class cow_wrapper
+{
+    static_assert(k_slot_num > 0, "there should be at least one reader counter");
+
+  public:
+    class snapshot_ptr;
+
+    using object_type = T;
+
+    // Constructs a `cow_wrapper` object. The first version of the object of type `T` is initialized from the arguments
+    // `std::forward<Args>(args)...`.
+    template <typename ...Args>
+    explicit cow_wrapper(Args&& ...args) : current_{new T{std::forward<Args>(args)...}} {}
+
+    cow_wrapper(const cow_wrapper&) = delete;
+    cow_wrapper(cow_wrapper&&) = delete;
+
+    cow_wrapper& operator=(const cow_wrapper&) = delete;
+    cow_wrapper& operator=(cow_wrapper&&) = delete;
+
+    ~cow_wrapper() { delete current_.load(std::memory_order::relaxed); }
+
+    // Pins the current version of the object and returns a `snapshot_ptr` which points to it. The version will not be
+    // reclaimed until the returned `snapshot_ptr` and its copies are destructed. The returned `snapshot_ptr` is never
+    // null.
+    snapshot_ptr read() noexcept
+    {
+        auto& slot = slots_[internal::this_thread_slot() % k_slot_num];
+        for (;;) {
+            const auto epoch = epoch_.load(std::memory_order::seq_cst);
+            auto& reader_num = slot.reader_nums_[epoch & 1];
+            reader_num.fetch_add(1, std::memory_order::seq_cst);
+            const T* const obj = current_.load(std::memory_order::seq_cst);
+            // If the epoch is unchanged, the writer which advances it next must observe our announcement, and the
+            // version we have loaded can only be retired by that writer or the later ones. Otherwise, the writer
+            // waiting for the readers may have missed us, so we announce again on the new epoch.
+            if (epoch_.load(std::memory_order::seq_cst) == epoch) {
+                return snapshot_ptr{this, obj, reader_num};
+            }
+            unpin_(reader_num);
+        }
+    }
+
+    // Copies the current version of the object, invokes `fn` with a reference to the copy and publishes it as the new
+    // version. Blocks until the old version is reclaimed.
+    template <typename Fn>
+    void update(Fn&& fn)
+    {
+        std::lock_guard<slontia::shared_mutex> lock{mutex_};
+        T* const old_obj = current_.load(std::memory_order::relaxed);
+        T* const new_obj = new T(std::as_const(*old_obj));
+        try {
+            std::forward<Fn>(fn)(*new_obj);
+        } catch (...) {
+            delete new_obj;
+            throw;
+        }
+        current_.store(new_obj, std::memory_order::seq_cst);
+        synchronize_();
+        delete old_obj;
+    }
+
+    // Publishes `obj` as the new version of the object. Blocks until the old version is reclaimed.
+    void store(T obj)
+    {
+        std::lock_guard<slontia::shared_mutex> lock{mutex_};
+        T* const old_obj = current_.exchange(new T(std::move(obj)), std::memory_order::seq_cst);
+        synchronize_();
+        delete old_obj;
+    }
+
+  private:
+    struct alignas(internal::k_cache_line_size) slot
+    {
+        // The number of readers announced on the even epochs and the odd epochs.
+        std::array<std::atomic<std::uint32_t>, 2> reader_nums_{};
+    };
+
+    // Advances the epoch, and blocks until all the readers announced on the previous epoch have unpinned their
+    // versions. Only the writer holding `mutex_` invokes it.
+    void synchronize_() noexcept
+    {
+        const auto parity = epoch_.fetch_add(1, std::memory_order::seq_cst) & 1;
+        synchronizing_.store(true, std::memory_order::seq_cst);
+        for (auto& slot : slots_) {
+            auto& reader_num = slot.reader_nums_[parity];
+            for (auto value = reader_num.load(std::memory_order::seq_cst); value > 0;
+                    value = reader_num.load(std::memory_order::seq_cst)) {
+                reader_num.wait(value, std::memory_order::relaxed);
+            }
+        }
+        synchronizing_.store(false, std::memory_order::relaxed);
+    }
+
+    // Unpins a version announced on `reader_num`.
+    void unpin_(std::atomic<std::uint32_t>& reader_num) noexcept
+    {
+        // Only the last reader on the counter notifies, and only when a writer may be waiting for it.
+        if (reader_num.fetch_sub(1, std::memory_order::seq_cst) == 1 &&
+                synchronizing_.load(std::memory_order::seq_cst)) {
+            reader_num.notify_all();
+        }
+    }
+
+    // The read-mostly states share one cache line, which is only modified when the object is updated.
+    alignas(internal::k_cache_line_size) std::atomic<T*> current_;
+    std::atomic<std::uint64_t> epoch_{0};
+    std::atomic<bool> synchronizing_{false};
+
+    std::array<slot, k_slot_num> slots_;
+
+    slontia::shared_mutex mutex_;
+};
+
+// The `snapshot_ptr` class wraps a pinned version of the object of `cow_wrapper`. The version is unpinned when the
+// `snapshot_ptr` is destructed.
+// `snapshot_ptr` is movable and copyable. A copy pins the same version.
+template <typename T, std::size_t k_slot_num>
+class cow_wrapper<T, k_slot_num>::snapshot_ptr
+{
+    friend class cow_wrapper;
+
+  public:
+    // Constructs a null `snapshot_ptr`, which does not pin any versions.
+    snapshot_ptr() noexcept = default;
+    snapshot_ptr(std::nullptr_t) noexcept : snapshot_ptr{} {}
+
+    // Constructs a `snapshot_ptr` which pins the same version as `o`.
+    snapshot_ptr(const snapshot_ptr& o) noexcept : wrapper_{o.wrapper_}, obj_{o.obj_}, reader_num_{o.reader_num_}
+    {
+        if (reader_num_) {
+            // The writer cannot finish waiting for the counter since `o` is still announced on it.
+            reader_num_->fetch_add(1, std::memory_order::relaxed);
+        }
+    }
+
+    // Move-construct a `snapshot_ptr` from `o`. After the construction, `o` does not pin any versions.
+    snapshot_ptr(snapshot_ptr&& o) noexcept { swap(o); }
+
+    // If `*this` points to an object, it unpins the version.
+    ~snapshot_ptr()
+    {
+        if (reader_num_) {
+            wrapper_->unpin_(*reader_num_);
+        }
+    }
+
+    snapshot_ptr& operator=(const snapshot_ptr& o) noexcept
+    {
+        snapshot_ptr(o).swap(*this);
+        return *this;
+    }
+
+    snapshot_ptr& operator=(snapshot_ptr&& o) noexcept
+    {
+        snapshot_ptr(std::move(o)).swap(*this);
+        return *this;
+    }
+
+    // Returns true if `*this` stores a non-null pointer, false otherwise.
+    operator bool() const noexcept { return obj_ != nullptr; }
+
+    // Returns true if `*this` stores a null pointer, false otherwise.
+    bool operator==(std::nullptr_t) const noexcept { return obj_ == nullptr; }
+
+    // Dereferences the stored pointer. The behavior is undefined if the stored pointer is null.
+    const T& operator*() const noexcept { return *obj_; }
+    const T* operator->() const noexcept { return obj_; }
+
+    // Unpins the version and set the stored pointer to a null pointer.
+    void reset() noexcept { snapshot_ptr{}.swap(*this); }
+
+    // Exchanges the pinned versions and stored pointer values of `*this` and `o`.
+    void swap(snapshot_ptr& o) noexcept
+    {
+        std::swap(wrapper_, o.wrapper_);
+        std::swap(obj_, o.obj_);
+        std::swap(reader_num_, o.reader_num_);
+    }
+
+  private:
+    snapshot_ptr(cow_wrapper* const wrapper, const T* const obj, std::atomic<std::uint32_t>& reader_num) noexcept
+        : wrapper_{wrapper}, obj_{obj}, reader_num_{&reader_num} {}
+
+    cow_wrapper* wrapper_{nullptr};
+    const T* obj_{nullptr};
+    std::atomic<std::uint32_t>* reader_num_{nullptr};
+};
+
+}
@@ -0,0 +1,66 @@
+// Copyright (c) 2024, Chang Liu <github.com/slontia>. All rights reserved.
+//
+// This source code is licensed under MIT (found in the LICENSE file).
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <type_traits>
+
+namespace slontia {
+
+// The `slontia::deadline` class is an absolute time point of `std::chrono::steady_clock` computed once, which can be
+// shared by several timed acquisitions under one time budget, e.g. all the locks taken by a request with a service
+// level agreement:
+//
+//     const slontia::deadline deadline{std::chrono::milliseconds(5)};
+//     auto a = wrapper_a.try_lock_until(deadline);
+//     auto b = wrapper_b.try_lock_shared_until(deadline);
+//
+// The mutexes of this library wait with the absolute time point directly, so the clock is not read again to convert
+// the timeout, and the budget is not renewed when a parked thread is woken up without acquiring the mutex.
+class deadline
+{
+  public:
+    using clock = std::chrono::steady_clock;
+
+    // Constructs a deadline which is `timeout_duration` later than now.
+    template <typename Rep, class Period>
+    explicit deadline(const std::chrono::duration<Rep, Period>& timeout_duration) noexcept
+        : time_{clock::now() + std::chrono::ceil<clock::duration>(timeout_duration)}
+    {
+    }
+
+    // Constructs a deadline at `timeout_time`, which is converted to a time point of `std::chrono::steady_clock` if
+    // `Clock` is not `std::chrono::steady_clock`.
+    template <typename Clock, class Duration>
+    explicit deadline(const std::chrono::time_point<Clock, Duration>& timeout_time) noexcept
+        : time_{to_steady_time_(timeout_time)}
+    {
+    }
+
+    // Returns the time point of the deadline.
+    clock::time_point at() const noexcept { return time_; }
+
+    // Returns true if the deadline has been reached.
+    bool expired() const noexcept { return clock::now() >= time_; }
+
+    // Returns the duration until the deadline, or zero if it has been reached.
+    clock::duration remaining() const noexcept { return std::max(time_ - clock::now(), clock::duration::zero()); }
+
+  private:
+    template <typename Clock, class Duration>
+    static clock::time_point to_steady_time_(const std::chrono::time_point<Clock, Duration>& timeout_time) noexcept
+    {
+        if constexpr (std::is_same_v<Clock, clock>) {
+            return std::chrono::ceil<clock::duration>(timeout_time);
+        } else {
+            return clock::now() + std::chrono::ceil<clock::duration>(timeout_time - Clock::now());
+        }
+    }
+
+    clock::time_point time_;
+};
+
+}
@@ -0,0 +1,212 @@
+// Copyright (c) 2024, Chang Liu <github.com/slontia>. All rights reserved.
+//
+// This source code is licensed under MIT (found in the LICENSE file).
+
+#pragma once
+
+#include "shared_mutex.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+namespace slontia {
+
+namespace internal {
+
+// Grants `slontia::lock_many` and `slontia::lock_many_shared` access to the atomic variables of
+// `slontia::internal::shared_mutex`. If `k_exclusive` is true, the mutexes are acquired in exclusive mode, otherwise in
+// shared mode.
+template <bool k_exclusive>
+struct lock_many_access
+{
+    // The thread waiting for the exclusive ownership is counted as a parked writer, otherwise as a parked reader.
+    static constexpr wake_channel k_channel = k_exclusive ? wake_channel::k_writers : wake_channel::k_readers;
+
+    template <typename AtomicUInt32, typename Layout, typename Wait, typename Wake, typename Fairness, typename Stats,
+             typename Handoff>
+    static Fairness fairness_of(const shared_mutex<AtomicUInt32, Layout, Wait, Wake, Fairness, Stats, Handoff>&);
+
+    // The protected members are accessed through the base class since we are its friend rather than the friend of the
+    // derived types.
+    template <typename AtomicUInt32, typename Layout, typename Wait, typename Wake, typename Fairness, typename Stats,
+             typename Handoff>
+    static auto& base_of(shared_mutex<AtomicUInt32, Layout, Wait, Wake, Fairness, Stats, Handoff>& mutex) noexcept
+    {
+        return mutex;
+    }
+
+    // Readers are parked on `holding_num_` by other fairness policies, whose notifications are not issued for the
+    // threads waiting in `lock_many`.
+    template <typename SharedMutex>
+    static constexpr bool k_supported =
+        std::is_same_v<decltype(fairness_of(std::declval<SharedMutex&>())), writer_preferring>;
+
+    template <typename SharedMutex>
+    static bool try_lock(SharedMutex& mutex) noexcept
+    {
+        if constexpr (k_exclusive) {
+            return mutex.try_lock();
+        } else {
+            return mutex.try_lock_shared();
+        }
+    }
+
+    template <typename SharedMutex>
+    static void unlock(SharedMutex& mutex) noexcept
+    {
+        if constexpr (k_exclusive) {
+            mutex.unlock();
+        } else {
+            mutex.unlock_shared();
+        }
+    }
+
+    // Returns the atomic variable to wait on, whose value of 0 indicates that the mutex may be acquired.
+    template <typename SharedMutex>
+    static auto& word(SharedMutex& mutex) noexcept
+    {
+        if constexpr (k_exclusive) {
+            return (base_of(mutex).holding_num_);
+        } else {
+            return (base_of(mutex).writing_num_);
+        }
+    }
+
+    // Prepares to wait for `mutex`, and returns the value to wait with, or 0 if the mutex may be acquired now.
+    // `finish_wait` must be invoked afterwards in either case.
+    template <typename SharedMutex>
+    static std::uint32_t prepare_wait(SharedMutex& mutex) noexcept
+    {
+        if constexpr (k_exclusive) {
+            // The readers releasing the mutex only notify `holding_num_` when there are registered writers, so we have
+            // to be registered as `lock` does, which also blocks new readers.
+            base_of(mutex).increase_writing_num_();
+        }
+        const auto fn = [&mutex] { return word(mutex).load(std::memory_order::acquire); };
+        return base_of(mutex).wake_.prepare_park(k_channel, fn, fn());
+    }
+
+    template <typename SharedMutex>
+    static void finish_wait(SharedMutex& mutex) noexcept
+    {
+        base_of(mutex).wake_.finish_park(k_channel);
+        if constexpr (k_exclusive) {
+            base_of(mutex).decrease_writing_num_();
+        }
+    }
+
+    // Blocks until `mutex` may be acquired, or returns immediately if it has been released.
+    template <typename SharedMutex>
+    static void wait_one(SharedMutex& mutex) noexcept
+    {
+        if (const auto value = prepare_wait(mutex); value > 0) {
+            word(mutex).wait(value, std::memory_order::acquire);
+        }
+        finish_wait(mutex);
+    }
+
+#if __linux__
+    // `futex_waitv` can be used only if all the atomic variables are futex words whose notifications are always issued.
+    template <typename ...SharedMutexes>
+    static constexpr bool k_waitv_supported =
+        (requires { futex_waitv_flags<std::remove_cvref_t<decltype(word(std::declval<SharedMutexes&>()))>>::value; }
+         && ...);
+
+    // Blocks until one of the mutexes which are not `acquired` may be acquired by `futex_waitv`, or returns
+    // immediately if one of them has been released. Returns false if `futex_waitv` is not supported.
+    template <typename ...SharedMutexes>
+    static bool wait_any(const std::array<bool, sizeof...(SharedMutexes)>& acquired, SharedMutexes&... mutexes)
+        noexcept
+    {
+        std::array<futex_waiter, sizeof...(SharedMutexes)> waiters;
+        std::uint32_t waiter_num = 0;
+        bool released = false;
+        std::size_t index = 0;
+        ((acquired[index++] || [&]
+            {
+                if (const auto value = prepare_wait(mutexes); value > 0) {
+                    using atomic_type = std::remove_cvref_t<decltype(word(mutexes))>;
+                    waiters[waiter_num++] = futex_waiter{.value_ = value,
+                        .address_ = reinterpret_cast<std::uintptr_t>(&word(mutexes)),
+                        .flags_ = futex_waitv_flags<atomic_type>::value};
+                } else {
+                    released = true;
+                }
+                return true;
+            }()), ...);
+        const bool supported = released || futex_waitv(waiters.data(), waiter_num);
+        index = 0;
+        ((acquired[index++] || (finish_wait(mutexes), true)), ...);
+        return supported;
+    }
+#endif
+};
+
+template <bool k_exclusive, typename ...SharedMutexes>
+void lock_many_internal(SharedMutexes&... mutexes) noexcept
+{
+    using access = lock_many_access<k_exclusive>;
+    static_assert(sizeof...(SharedMutexes) > 0, "there should be at least one mutex");
+    static_assert((access::template k_supported<SharedMutexes> && ...),
+            "only the mutexes preferring writers can be locked by `lock_many`");
+
+    while (true) {
+        // Try all the mutexes even if some of them fail, so that the notification consumed by us is passed on to other
+        // waiting threads by releasing the mutex.
+        const std::array<bool, sizeof...(SharedMutexes)> acquired{access::try_lock(mutexes)...};
+        if (std::find(acquired.begin(), acquired.end(), false) == acquired.end()) {
+            return;
+        }
+        std::size_t index = 0;
+        ((acquired[index++] && (access::unlock(mutexes), true)), ...);
+
+#if __linux__
+        if constexpr (access::template k_waitv_supported<SharedMutexes...>) {
+            if (access::wait_any(acquired, mutexes...)) {
+                continue;
+            }
+        }
+#endif
+        // Wait for the first mutex which fails to be acquired.
+        index = 0;
+        bool waited = false;
+        ((!waited && !acquired[index++] && (access::wait_one(mutexes), waited = true)), ...);
+    }
+}
+
+}
+
+// Acquires the exclusive ownerships of all the `mutexes` at once without deadlock. The mutexes should be
+// `slontia::shared_mutex`, `slontia::shared_timed_mutex` or their variants preferring writers, and can be of different
+// types.
+//
+// The thread tries to acquire all the mutexes, and releases the acquired ones if any of them fails, so it never holds
+// an ownership while it is blocked. Then it waits for all the failed mutexes at once, and tries again when any of them
+// is released. On Linux 5.16 or later, if all the mutexes park threads on `internal::timed_atomic_uint32_t` (e.g.
+// `slontia::shared_timed_mutex`), the thread is parked on all of them by one `futex_waitv`, so it is not woken up once
+// for each mutex. Otherwise, the thread is parked on the first failed mutex.
+//
+// Like `lock`, the thread blocks new readers of the mutexes it is parked on. The `mutexes` must be different objects,
+// and there should be at most 128 of them.
+template <typename ...SharedMutexes>
+void lock_many(SharedMutexes&... mutexes) noexcept
+{
+    static_assert(sizeof...(SharedMutexes) <= 128, "futex_waitv supports at most 128 waiters");
+    internal::lock_many_internal<true>(mutexes...);
+}
+
+// Acquires the shared ownerships of all the `mutexes` at once without deadlock, in the same manner as
+// `slontia::lock_many`.
+template <typename ...SharedMutexes>
+void lock_many_shared(SharedMutexes&... mutexes) noexcept
+{
+    static_assert(sizeof...(SharedMutexes) <= 128, "futex_waitv supports at most 128 waiters");
+    internal::lock_many_internal<false>(mutexes...);
+}
+
+}
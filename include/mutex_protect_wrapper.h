@@ -4,18 +4,182 @@
 
 #pragma once
 
+#include "contention_profiler.h"
+#include "deadline.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
 #include <chrono>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <numeric>
+#include <optional>
+#include <source_location>
+#include <stop_token>
+#include <thread>
+#include <tuple>
+#include <type_traits>
 #include <utility>
 
 namespace slontia {
 
+// The read policies decide how `snapshot` and `read_optimistic` of `mutex_protect_wrapper` read the wrapped object.
+// Each read policy provides:
+// - `k_optimistic`, which is true if the object can be read without locking the mutex;
+// - `begin_write()`, which is invoked after a `locked_ptr` acquires the exclusive ownership;
+// - `end_write()`, which is invoked before a `locked_ptr` releases the exclusive ownership.
+//
+// `locked_read` is the default. It takes no space, and the readers lock the mutex in shared mode.
+struct locked_read
+{
+    static constexpr bool k_optimistic = false;
+
+    void begin_write() noexcept {}
+
+    void end_write() noexcept {}
+};
+
+// `optimistic_read` implements a sequence lock. Writers increase the version before and after modifying the object, and
+// readers copy the object without writing any shared states, then validate that the version is even and unchanged. A
+// reader locks the mutex in shared mode after `k_retry_num` failed attempts, so it is not starved by frequent writers.
+// The object should be trivially copyable. Note that the copy may race with a writer, in which case it is discarded.
+template <std::uint32_t k_retry_num = 4>
+class optimistic_read
+{
+  public:
+    static constexpr bool k_optimistic = true;
+
+    void begin_write() noexcept
+    {
+        // Only the writer holding the exclusive ownership modifies the version.
+        version_.store(version_.load(std::memory_order::relaxed) + 1, std::memory_order::relaxed);
+        std::atomic_thread_fence(std::memory_order::release);
+    }
+
+    void end_write() noexcept
+    {
+        version_.store(version_.load(std::memory_order::relaxed) + 1, std::memory_order::release);
+    }
+
+    // Copies `obj` into `bytes`. Returns false if the copy may be inconsistent after `k_retry_num` attempts.
+    template <typename T>
+    bool try_read(const T& obj, std::array<std::byte, sizeof(T)>& bytes) const noexcept
+    {
+        static_assert(std::is_trivially_copyable_v<T>, "the object read optimistically should be trivially copyable");
+        for (std::uint32_t i = 0; i < k_retry_num; ++i) {
+            const auto version = version_.load(std::memory_order::acquire);
+            if (version & 1) {
+                // A writer is modifying the object.
+                continue;
+            }
+            std::memcpy(bytes.data(), &obj, sizeof(T));
+            std::atomic_thread_fence(std::memory_order::acquire);
+            if (version_.load(std::memory_order::relaxed) == version) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+  private:
+    // The version is odd when a writer is modifying the object.
+    std::atomic<std::uint32_t> version_{0};
+};
+
+// The write policies decide how `with_lock` of `mutex_protect_wrapper` invokes the closures which modify the wrapped
+// object. Each write policy provides `k_combining`, which is true if the closures are executed by flat combining.
+//
+// `locked_write` is the default. It takes no space, and `with_lock` invokes the closure with the mutex locked in
+// exclusive mode.
+struct locked_write
+{
+    static constexpr bool k_combining = false;
+};
+
+// `combining_write` implements flat combining. A writer enqueues its closure before trying to lock the mutex. The
+// writer which acquires the mutex executes all the enqueued closures before releasing it, so the object stays in the
+// cache of one core and the mutex is not handed off for each closure. The other writers wait for their closures to be
+// executed for `k_spin_num` rounds, after which they lock the mutex in exclusive mode and execute the closures by
+// themselves, so the closures are executed in time even if the mutex is held by a `locked_ptr`.
+template <std::uint32_t k_spin_num = 128>
+class combining_write
+{
+  public:
+    static constexpr bool k_combining = true;
+
+    // The closure enqueued by a writer, which lives on the stack of the writer until it is executed.
+    struct request
+    {
+        void (*execute_)(void* context, void* obj);
+        void* context_;
+        request* next_{nullptr};
+        std::exception_ptr exception_{};
+        std::atomic<bool> done_{false};
+    };
+
+    void push(request& r) noexcept
+    {
+        r.next_ = head_.load(std::memory_order::relaxed);
+        while (!head_.compare_exchange_weak(r.next_, &r, std::memory_order::seq_cst, std::memory_order::relaxed)) {
+        }
+    }
+
+    bool empty() const noexcept { return head_.load(std::memory_order::seq_cst) == nullptr; }
+
+    // Executes all the enqueued closures with `obj` in order of enqueuing. Only the writer holding the exclusive
+    // ownership invokes it.
+    void execute_all(void* const obj) noexcept
+    {
+        // The requests are pushed in the reverse order.
+        request* reversed = nullptr;
+        for (request* r = head_.exchange(nullptr, std::memory_order::acquire); r; ) {
+            request* const next = r->next_;
+            r->next_ = reversed;
+            reversed = r;
+            r = next;
+        }
+        while (reversed) {
+            // The request can be destructed by its writer once it is done, so load the next one first.
+            request* const r = std::exchange(reversed, reversed->next_);
+            try {
+                r->execute_(r->context_, obj);
+            } catch (...) {
+                r->exception_ = std::current_exception();
+            }
+            r->done_.store(true, std::memory_order::release);
+        }
+    }
+
+    // Waits for the closure to be executed by another writer. Returns false if it is not done after `k_spin_num`
+    // rounds.
+    static bool wait(const request& r) noexcept
+    {
+        for (std::uint32_t i = 0; i < k_spin_num; ++i) {
+            if (r.done_.load(std::memory_order::acquire)) {
+                return true;
+            }
+            std::this_thread::yield();
+        }
+        return r.done_.load(std::memory_order::acquire);
+    }
+
+  private:
+    std::atomic<request*> head_{nullptr};
+};
+
 class mutex_protect_wrapper_base
 {
-    template <typename T, typename Mutex>
+    template <typename T, typename Mutex, typename Read, typename Write, typename Profile>
     friend class mutex_protect_wrapper;
 
   public:
-    enum class lock_type { unique_mutable, unique_const, shared_const };
+    enum class lock_type { unique_mutable, unique_const, shared_const, upgrade_const };
 
   private:
     template <lock_type k_type>
@@ -27,10 +191,16 @@ class mutex_protect_wrapper_base
 template <>
 struct mutex_protect_wrapper_base::lock_helper<mutex_protect_wrapper_base::lock_type::shared_const>
 {
-    static void lock(auto& mutex) { mutex.lock_shared(); }
+    static void lock(auto& mutex)
+    {
+        static_assert(std::is_void_v<decltype(mutex.lock_shared())>, "the mutex should be locked by async_lock_shared");
+        mutex.lock_shared();
+    }
 
     static bool try_lock(auto& mutex) { return mutex.try_lock_shared(); }
 
+    static bool try_lock(auto& mutex, const std::stop_token& stop_token) { return mutex.lock_shared(stop_token); }
+
     template <typename Rep, class Period>
     static bool try_lock(auto& mutex, const std::chrono::duration<Rep, Period>& timeout_duration)
     {
@@ -43,17 +213,43 @@ struct mutex_protect_wrapper_base::lock_helper<mutex_protect_wrapper_base::lock_
         return mutex.try_lock_shared_until(timeout_time);
     }
 
+    // The mutexes not accepting a `slontia::deadline` (e.g. `std::shared_timed_mutex`) wait until its time point.
+    static bool try_lock(auto& mutex, const deadline& deadline)
+    {
+        if constexpr (requires { mutex.try_lock_shared_until(deadline); }) {
+            return mutex.try_lock_shared_until(deadline);
+        } else {
+            return mutex.try_lock_shared_until(deadline.at());
+        }
+    }
+
     static void unlock(auto& mutex) { mutex.unlock_shared(); }
 };
 
+template <>
+struct mutex_protect_wrapper_base::lock_helper<mutex_protect_wrapper_base::lock_type::upgrade_const>
+{
+    static void lock(auto& mutex) { mutex.lock_upgrade(); }
+
+    static bool try_lock(auto& mutex) { return mutex.try_lock_upgrade(); }
+
+    static void unlock(auto& mutex) { mutex.unlock_upgrade(); }
+};
+
 template <mutex_protect_wrapper_base::lock_type k_type>
 requires (k_type == mutex_protect_wrapper_base::lock_type::unique_mutable || k_type == mutex_protect_wrapper_base::lock_type::unique_const)
 struct mutex_protect_wrapper_base::lock_helper<k_type>
 {
-    static void lock(auto& mutex) { mutex.lock(); }
+    static void lock(auto& mutex)
+    {
+        static_assert(std::is_void_v<decltype(mutex.lock())>, "the mutex should be locked by async_lock");
+        mutex.lock();
+    }
 
     static bool try_lock(auto& mutex) { return mutex.try_lock(); }
 
+    static bool try_lock(auto& mutex, const std::stop_token& stop_token) { return mutex.lock(stop_token); }
+
     template <typename Rep, class Period>
     static bool try_lock(auto& mutex, const std::chrono::duration<Rep, Period>& timeout_duration)
     {
@@ -66,6 +262,15 @@ struct mutex_protect_wrapper_base::lock_helper<k_type>
         return mutex.try_lock_until(timeout_time);
     }
 
+    static bool try_lock(auto& mutex, const deadline& deadline)
+    {
+        if constexpr (requires { mutex.try_lock_until(deadline); }) {
+            return mutex.try_lock_until(deadline);
+        } else {
+            return mutex.try_lock_until(deadline.at());
+        }
+    }
+
     static void unlock(auto& mutex) { mutex.unlock(); }
 };
 
@@ -73,13 +278,26 @@ struct mutex_protect_wrapper_base::lock_helper<k_type>
 // object, it must retrieve an locked pointer first, which indicates the threads has held the mutex in exclusive or
 // shared mode. The ownership of the mutex will remain held until the locked pointer is destructed. This mechanism
 // guarantees thread safety for concurrently accessing the object.
+//
+// The `Read` policy decides how `snapshot` and `read_optimistic` read the object (`locked_read` or `optimistic_read`).
+// The `Write` policy decides how `with_lock` executes the closures (`locked_write` or `combining_write`).
+// The `Profile` policy decides whether the contended acquisitions are attributed to their call sites by
+// `slontia::contention_profiler` (`no_profile` or `sampled_profile`). The call site is the caller of the public member
+// functions acquiring the mutex, which is passed by their default arguments of `std::source_location`.
 // `mutex_protect_wrapper` is neither copyable nor movable.
-template <typename T, typename Mutex>
+template <typename T, typename Mutex, typename Read = locked_read, typename Write = locked_write,
+         typename Profile = no_profile>
 class mutex_protect_wrapper : private mutex_protect_wrapper_base
 {
     template <lock_type k_type>
     class locked_ptr_template;
 
+    template <lock_type k_type>
+    class lock_request_template;
+
+    template <lock_type k_type, typename Awaiter>
+    class async_lock_awaiter;
+
   public:
     // `locked_ptr` locks the mutex in exclusive mode.
     using locked_ptr = locked_ptr_template<lock_type::unique_mutable>;
@@ -90,6 +308,11 @@ class mutex_protect_wrapper : private mutex_protect_wrapper_base
     // `shared_locked_ptr` locks the mutex in shared mode. The reference dereferenced by the pointer is immutable.
     using shared_locked_ptr = locked_ptr_template<lock_type::shared_const>;
 
+    // `upgradable_locked_ptr` locks the mutex in upgrade mode. The reference dereferenced by the pointer is immutable.
+    // It can be moved into a `locked_ptr`, which upgrades the ownership to the exclusive mode atomically. It is only
+    // available when `Mutex` supports the upgrade ownership (e.g. `slontia::shared_mutex`).
+    using upgradable_locked_ptr = locked_ptr_template<lock_type::upgrade_const>;
+
     using object_type = T;
 
     using mutex_type = Mutex;
@@ -99,6 +322,15 @@ class mutex_protect_wrapper : private mutex_protect_wrapper_base
     template <typename ...Args>
     explicit mutex_protect_wrapper(Args&& ...args) : obj_{std::forward<Args>(args)...} {}
 
+    // Constructs a `mutex_protect_wrapper` object. The mutex of type `Mutex` is initialized from the elements of
+    // `mutex_args` (e.g. the executor of `slontia::async_shared_mutex`), and the object of type `T` is initialized from
+    // the elements of `args`.
+    template <typename ...MutexArgs, typename ...Args>
+    mutex_protect_wrapper(std::piecewise_construct_t, std::tuple<MutexArgs...> mutex_args, std::tuple<Args...> args)
+        : mutex_{std::make_from_tuple<Mutex>(std::move(mutex_args))}, obj_{std::make_from_tuple<T>(std::move(args))}
+    {
+    }
+
     mutex_protect_wrapper(const mutex_protect_wrapper&) = delete;
     mutex_protect_wrapper(mutex_protect_wrapper&&) = delete;
 
@@ -107,108 +339,366 @@ class mutex_protect_wrapper : private mutex_protect_wrapper_base
 
     // Locks the mutex in exclusive mode and returns a `locked_ptr` which points to the object. The returned
     // `locked_ptr` is never null.
-    auto lock() { return lock_<lock_type::unique_mutable>(); }
+    auto lock(const std::source_location& location = std::source_location::current())
+    {
+        return lock_<lock_type::unique_mutable>(location);
+    }
+
+    // Locks the mutex in exclusive mode, but gives up once a stop is requested on `stop_token`. On successful lock
+    // acquisition returns a `locked_ptr` which points to the object, otherwise returns a null `locked_ptr`. It is only
+    // available when `Mutex` supports the cancellable acquisition (e.g. `slontia::shared_timed_mutex`).
+    locked_ptr lock(const std::stop_token& stop_token,
+            const std::source_location& location = std::source_location::current())
+        requires requires(Mutex& mutex, const std::stop_token& stop_token) { mutex.lock(stop_token); }
+    {
+        return try_lock_<lock_type::unique_mutable>(location, stop_token);
+    }
 
     // Tries to lock the mutex in exclusive mode without blocking. On successful lock acquisition returns a `locked_ptr`
     // which points to the object, otherwise returns a null `locked_ptr`.
-    auto try_lock() { return try_lock_<lock_type::unique_mutable>(); }
+    auto try_lock(const std::source_location& location = std::source_location::current())
+    {
+        return try_lock_<lock_type::unique_mutable>(location);
+    }
 
     // Tries to lock the mutex in exclusive mode. Blocks until specified `timeout_duration` has elapsed or the lock is
     // acquired, whichever comes first. On successful lock acquisition returns a `locked_ptr` which points to the
     // object, otherwise returns a null `locked_ptr`.
     template <typename Rep, class Period>
-    auto try_lock_for(const std::chrono::duration<Rep, Period>& timeout_duration)
+    auto try_lock_for(const std::chrono::duration<Rep, Period>& timeout_duration,
+            const std::source_location& location = std::source_location::current())
     {
-        return try_lock_<lock_type::unique_mutable>(timeout_duration);
+        return try_lock_<lock_type::unique_mutable>(location, timeout_duration);
     }
 
     // Tries to lock the associated mutex in exclusive mode. Blocks until specified `timeout_time` has been reached or
     // the lock is acquired, whichever comes first. On successful lock acquisition returns a `locked_ptr` which points
     // to the object, otherwise returns a null `locked_ptr`.
     template <typename Clock, class Duration>
-    auto try_lock_until(const std::chrono::time_point<Clock, Duration>& timeout_time)
+    auto try_lock_until(const std::chrono::time_point<Clock, Duration>& timeout_time,
+            const std::source_location& location = std::source_location::current())
     {
-        return try_lock_<lock_type::unique_mutable>(timeout_time);
+        return try_lock_<lock_type::unique_mutable>(location, timeout_time);
+    }
+
+    // Tries to lock the mutex in exclusive mode until `deadline` has been reached as `try_lock_until`. The `deadline`
+    // can be shared by the acquisitions of several wrappers under one time budget.
+    auto try_lock_until(const deadline& deadline,
+            const std::source_location& location = std::source_location::current())
+    {
+        return try_lock_<lock_type::unique_mutable>(location, deadline);
     }
 
     // Locks the mutex in exclusive mode and returns a `const_locked_ptr` which points to the object. The returned
     // `const_locked_ptr` is never null.
-    auto lock_const() { return lock_<lock_type::unique_const>(); }
+    auto lock_const(const std::source_location& location = std::source_location::current())
+    {
+        return lock_<lock_type::unique_const>(location);
+    }
+
+    // Locks the mutex in exclusive mode, but gives up once a stop is requested on `stop_token`. On successful lock
+    // acquisition returns a `const_locked_ptr` which points to the object, otherwise returns a null
+    // `const_locked_ptr`.
+    const_locked_ptr lock_const(const std::stop_token& stop_token,
+            const std::source_location& location = std::source_location::current())
+        requires requires(Mutex& mutex, const std::stop_token& stop_token) { mutex.lock(stop_token); }
+    {
+        return try_lock_<lock_type::unique_const>(location, stop_token);
+    }
 
     // Tries to lock the mutex in exclusive mode without blocking. On successful lock acquisition returns a
     // `const_locked_ptr` which points to the object, otherwise returns a null `const_locked_ptr`.
-    auto try_lock_const() { return try_lock_<lock_type::unique_const>(); }
+    auto try_lock_const(const std::source_location& location = std::source_location::current())
+    {
+        return try_lock_<lock_type::unique_const>(location);
+    }
 
     // Tries to lock the mutex in exclusive mode. Blocks until specified `timeout_duration` has elapsed or the lock is
     // acquired, whichever comes first. On successful lock acquisition returns a `const_locked_ptr` which points to the
     // object, otherwise returns a null `const_locked_ptr`.
     template <typename Rep, class Period>
-    auto try_lock_const_for(const std::chrono::duration<Rep, Period>& timeout_duration)
+    auto try_lock_const_for(const std::chrono::duration<Rep, Period>& timeout_duration,
+            const std::source_location& location = std::source_location::current())
     {
-        return try_lock_<lock_type::unique_const>(timeout_duration);
+        return try_lock_<lock_type::unique_const>(location, timeout_duration);
     }
 
     // Tries to lock the mutex in exclusive mode. Blocks until specified `timeout_time` has been reached or the lock is
     // acquired, whichever comes first. On successful lock acquisition returns a `const_locked_ptr` which points to the
     // object, otherwise returns a null `const_locked_ptr`.
     template <typename Clock, class Duration>
-    auto try_lock_const_until(const std::chrono::time_point<Clock, Duration>& timeout_time)
+    auto try_lock_const_until(const std::chrono::time_point<Clock, Duration>& timeout_time,
+            const std::source_location& location = std::source_location::current())
     {
-        return try_lock_<lock_type::unique_const>(timeout_time);
+        return try_lock_<lock_type::unique_const>(location, timeout_time);
+    }
+
+    // Tries to lock the mutex in exclusive mode until `deadline` has been reached as `try_lock_const_until`.
+    auto try_lock_const_until(const deadline& deadline,
+            const std::source_location& location = std::source_location::current())
+    {
+        return try_lock_<lock_type::unique_const>(location, deadline);
     }
 
     // Locks the mutex in shared mode and returns a `shared_locked_ptr` which points to the object. The returned
     // `shared_locked_ptr` is never null.
-    auto lock_shared() { return lock_<lock_type::shared_const>(); }
+    auto lock_shared(const std::source_location& location = std::source_location::current())
+    {
+        return lock_<lock_type::shared_const>(location);
+    }
+
+    // Locks the mutex in shared mode, but gives up once a stop is requested on `stop_token`. On successful lock
+    // acquisition returns a `shared_locked_ptr` which points to the object, otherwise returns a null
+    // `shared_locked_ptr`.
+    shared_locked_ptr lock_shared(const std::stop_token& stop_token,
+            const std::source_location& location = std::source_location::current())
+        requires requires(Mutex& mutex, const std::stop_token& stop_token) { mutex.lock_shared(stop_token); }
+    {
+        return try_lock_<lock_type::shared_const>(location, stop_token);
+    }
 
     // Tries to lock the mutex in shared mode without blocking. On successful lock acquisition returns a
     // `shared_locked_ptr` which points to the object, otherwise returns a null `shared_locked_ptr`.
-    auto try_lock_shared() { return try_lock_<lock_type::shared_const>(); }
+    auto try_lock_shared(const std::source_location& location = std::source_location::current())
+    {
+        return try_lock_<lock_type::shared_const>(location);
+    }
 
     // Tries to lock the mutex in shared mode. Blocks until specified `timeout_duration` has elapsed or the lock is
     // acquired, whichever comes first. On successful lock acquisition returns a `shared_locked_ptr` which points to the
     // object, otherwise returns a null `shared_locked_ptr`.
     template <typename Rep, class Period>
-    auto try_lock_shared_for(const std::chrono::duration<Rep, Period>& timeout_duration)
+    auto try_lock_shared_for(const std::chrono::duration<Rep, Period>& timeout_duration,
+            const std::source_location& location = std::source_location::current())
     {
-        return try_lock_<lock_type::shared_const>(timeout_duration);
+        return try_lock_<lock_type::shared_const>(location, timeout_duration);
     }
 
     // Tries to lock the mutex in shared mode. Blocks until specified `timeout_time` has been reached or the lock is
     // acquired, whichever comes first. On successful lock acquisition returns a `shared_locked_ptr` which points to the
     // object, otherwise returns a null `shared_locked_ptr`.
     template <typename Clock, class Duration>
-    auto try_lock_shared_until(const std::chrono::time_point<Clock, Duration>& timeout_time)
+    auto try_lock_shared_until(const std::chrono::time_point<Clock, Duration>& timeout_time,
+            const std::source_location& location = std::source_location::current())
+    {
+        return try_lock_<lock_type::shared_const>(location, timeout_time);
+    }
+
+    // Tries to lock the mutex in shared mode until `deadline` has been reached as `try_lock_shared_until`.
+    auto try_lock_shared_until(const deadline& deadline,
+            const std::source_location& location = std::source_location::current())
+    {
+        return try_lock_<lock_type::shared_const>(location, deadline);
+    }
+
+    // Locks the mutex in upgrade mode and returns an `upgradable_locked_ptr` which points to the object. The returned
+    // `upgradable_locked_ptr` is never null.
+    auto lock_upgrade(const std::source_location& location = std::source_location::current())
+    {
+        return lock_<lock_type::upgrade_const>(location);
+    }
+
+    // Tries to lock the mutex in upgrade mode without blocking. On successful lock acquisition returns an
+    // `upgradable_locked_ptr` which points to the object, otherwise returns a null `upgradable_locked_ptr`.
+    auto try_lock_upgrade(const std::source_location& location = std::source_location::current())
+    {
+        return try_lock_<lock_type::upgrade_const>(location);
+    }
+
+    // Returns the snapshot of the stats recorded by the mutex. It is only available when `Mutex` records stats (e.g.
+    // `slontia::internal::shared_mutex` with the `lock_stats` policy).
+    auto stats() const noexcept requires requires(const Mutex& mutex) { mutex.stats(); } { return mutex_.stats(); }
+
+    // Returns a request to lock the mutex in exclusive mode, which can be passed to `slontia::lock_all` to be acquired
+    // as a `locked_ptr` together with the requests of other `mutex_protect_wrapper` objects.
+    auto lock_request() { return lock_request_template<lock_type::unique_mutable>{this}; }
+
+    // Returns a request to lock the mutex in exclusive mode, which can be passed to `slontia::lock_all` to be acquired
+    // as a `const_locked_ptr` together with the requests of other `mutex_protect_wrapper` objects.
+    auto lock_const_request() { return lock_request_template<lock_type::unique_const>{this}; }
+
+    // Returns a request to lock the mutex in shared mode, which can be passed to `slontia::lock_all` to be acquired as
+    // a `shared_locked_ptr` together with the requests of other `mutex_protect_wrapper` objects.
+    auto lock_shared_request() { return lock_request_template<lock_type::shared_const>{this}; }
+
+    // Returns an awaitable which locks the mutex in exclusive mode, and returns a `locked_ptr` which points to the object
+    // by `co_await`. The returned `locked_ptr` is never null. It is only available when `Mutex` is locked by
+    // `co_await` (e.g. `slontia::async_shared_mutex`).
+    auto async_lock() requires requires(Mutex& mutex) { mutex.lock().await_resume(); }
+    {
+        return async_lock_awaiter<lock_type::unique_mutable, decltype(mutex_.lock())>{*this, [&] { return mutex_.lock(); }};
+    }
+
+    // Returns an awaitable which locks the mutex in shared mode, and returns a `shared_locked_ptr` which points to the
+    // object by `co_await`. The returned `shared_locked_ptr` is never null. It is only available when `Mutex` is locked
+    // by `co_await` (e.g. `slontia::async_shared_mutex`).
+    auto async_lock_shared() requires requires(Mutex& mutex) { mutex.lock_shared().await_resume(); }
     {
-        return try_lock_<lock_type::shared_const>(timeout_time);
+        return async_lock_awaiter<lock_type::shared_const, decltype(mutex_.lock_shared())>{*this,
+            [&] { return mutex_.lock_shared(); }};
+    }
+
+    // Invokes `fn` with a reference to the object while the mutex is locked in exclusive mode, and returns the result.
+    // With the `combining_write` policy, `fn` may be executed by another thread which is holding the mutex, and the
+    // exception thrown by `fn` is rethrown in the current thread.
+    template <typename Fn>
+    decltype(auto) with_lock(Fn&& fn, const std::source_location& location = std::source_location::current())
+    {
+        if constexpr (Write::k_combining) {
+            return with_lock_combining_(std::forward<Fn>(fn), location);
+        } else {
+            const auto locked_obj = lock(location);
+            return std::invoke(std::forward<Fn>(fn), *locked_obj);
+        }
+    }
+
+    // Invokes `fn` with a const reference to the object while the mutex is locked in shared mode, and returns the
+    // result.
+    template <typename Fn>
+    decltype(auto) with_shared_lock(Fn&& fn, const std::source_location& location = std::source_location::current())
+    {
+        const auto locked_obj = lock_shared(location);
+        return std::invoke(std::forward<Fn>(fn), *locked_obj);
+    }
+
+    // Returns a copy of the object. With the `optimistic_read` policy, the object is copied without locking the mutex
+    // unless it is modified concurrently, otherwise the mutex is locked in shared mode.
+    T snapshot(const std::source_location& location = std::source_location::current())
+    {
+        if constexpr (Read::k_optimistic) {
+            std::array<std::byte, sizeof(T)> bytes;
+            if (read_.try_read(obj_, bytes)) {
+                return std::bit_cast<T>(bytes);
+            }
+        }
+        return *lock_shared(location);
+    }
+
+    // Invokes `fn` with a const reference to the object, and returns the result. With the `optimistic_read` policy,
+    // `fn` is invoked with a copy returned by `snapshot`, otherwise the mutex is locked in shared mode while `fn` is
+    // invoked.
+    template <typename Fn>
+    decltype(auto) read_optimistic(Fn&& fn, const std::source_location& location = std::source_location::current())
+    {
+        if constexpr (Read::k_optimistic) {
+            const T obj = snapshot(location);
+            return std::invoke(std::forward<Fn>(fn), obj);
+        } else {
+            const auto locked_obj = lock_shared(location);
+            return std::invoke(std::forward<Fn>(fn), *locked_obj);
+        }
     }
 
   private:
     template <lock_type k_type>
-    auto lock_()
+    auto lock_(const std::source_location& location)
     {
-        lock_helper<k_type>::lock(mutex_);
-        return locked_ptr_template<k_type>{this};
+        profile_acquisition_<k_type>(location, [this]
+                {
+                    lock_helper<k_type>::lock(mutex_);
+                    return true;
+                });
+        return adopt_<k_type>();
     }
 
     template <lock_type k_type, typename ...Args>
-    auto try_lock_(Args&& ...args)
+    auto try_lock_(const std::source_location& location, Args&& ...args)
+    {
+        return profile_acquisition_<k_type>(location,
+                [&] { return lock_helper<k_type>::try_lock(mutex_, std::forward<Args>(args)...); })
+            ? adopt_<k_type>() : locked_ptr_template<k_type>{};
+    }
+
+    // Acquires the ownership by `acquire`, and returns whether it is acquired. If the `Profile` policy samples the
+    // acquisition, the mutex is tried without blocking first, and if it fails, the time spent by `acquire` is recorded
+    // at `location`. So a failed `try_lock` is recorded with little wait time.
+    template <lock_type k_type, typename Acquire>
+    bool profile_acquisition_(const std::source_location& location, const Acquire& acquire)
+    {
+        if constexpr (Profile::k_enabled) {
+            if (Profile::sample()) {
+                if (lock_helper<k_type>::try_lock(mutex_)) {
+                    return true;
+                }
+                const auto start_time = std::chrono::steady_clock::now();
+                const bool acquired = acquire();
+                Profile::record(location, std::chrono::steady_clock::now() - start_time);
+                return acquired;
+            }
+        }
+        return acquire();
+    }
+
+    // Returns a locked pointer which takes over the acquired ownership of the mutex.
+    template <lock_type k_type>
+    locked_ptr_template<k_type> adopt_() noexcept
     {
-        return locked_ptr_template<k_type>{
-            lock_helper<k_type>::try_lock(mutex_, std::forward<Args>(args)...) ? this : nullptr};
+        if constexpr (k_type == lock_type::unique_mutable) {
+            read_.begin_write();
+        }
+        return locked_ptr_template<k_type>{this};
+    }
+
+    template <typename Fn>
+    auto with_lock_combining_(Fn&& fn, const std::source_location& location)
+    {
+        using result_type = std::invoke_result_t<Fn, T&>;
+        static_assert(!std::is_reference_v<result_type>, "the closure executed by combining should return a value");
+        struct context
+        {
+            Fn& fn_;
+            std::optional<std::conditional_t<std::is_void_v<result_type>, bool, result_type>> result_{};
+        } ctx{fn};
+
+        typename Write::request request{
+            [](void* const context_ptr, void* const obj)
+            {
+                auto& ctx = *static_cast<context*>(context_ptr);
+                if constexpr (std::is_void_v<result_type>) {
+                    std::invoke(std::forward<Fn>(ctx.fn_), *static_cast<T*>(obj));
+                    ctx.result_.emplace(true);
+                } else {
+                    ctx.result_.emplace(std::invoke(std::forward<Fn>(ctx.fn_), *static_cast<T*>(obj)));
+                }
+            }, &ctx};
+        write_.push(request);
+
+        // Become the combiner if the mutex is available, otherwise wait for the combiner to execute our closure.
+        auto locked_obj = try_lock(location);
+        if (locked_obj || !Write::wait(request)) {
+            if (!locked_obj) {
+                locked_obj = lock(location);
+            }
+            // The closures enqueued before the mutex is released may be missed by the other writers which have failed
+            // to lock it, so check again after releasing.
+            do {
+                write_.execute_all(&*locked_obj);
+                locked_obj.reset();
+            } while (!write_.empty() && (locked_obj = try_lock(location)));
+        }
+
+        if (request.exception_) {
+            std::rethrow_exception(request.exception_);
+        }
+        if constexpr (!std::is_void_v<result_type>) {
+            return std::move(*ctx.result_);
+        }
     }
 
     mutable Mutex mutex_;
+    [[no_unique_address]] Read read_;
+    [[no_unique_address]] Write write_;
     T obj_;
 };
 
 // The `locked_ptr_template` class template wraps a mutex ownership and a pointer which points to the object. The held
-// ownership of the mutex is exclusive when `k_type` is `unique_mutable` or `unique_const`, and shared when `k_type` is
-// `shared_const`. `locked_ptr_template` does not hold any ownerships of the pointed object.
+// ownership of the mutex is exclusive when `k_type` is `unique_mutable` or `unique_const`, shared when `k_type` is
+// `shared_const`, and upgrade when `k_type` is `upgrade_const`. `locked_ptr_template` does not hold any ownerships of
+// the pointed object.
 // `locked_ptr_template` is movable, and only copyable when it locks the mutex in shared mode.
-template <typename T, typename Mutex>
+template <typename T, typename Mutex, typename Read, typename Write, typename Profile>
 template <mutex_protect_wrapper_base::lock_type k_type>
-class mutex_protect_wrapper<T, Mutex>::locked_ptr_template
+class mutex_protect_wrapper<T, Mutex, Read, Write, Profile>::locked_ptr_template
 {
     template <mutex_protect_wrapper_base::lock_type>
     friend class locked_ptr_template;
@@ -225,11 +715,19 @@ class mutex_protect_wrapper<T, Mutex>::locked_ptr_template
 
     // Constructs a `locked_ptr_template` which shares ownership of the mutex managed by `o`. The constructed
     // `locked_ptr_template` points to the same object as `o`.
+    // If the mutex supports `add_shared` (e.g. `slontia::shared_mutex`), the shared ownership is added without
+    // blocking, so copying never waits for the writers waiting for the ownership held by `o`, which would never be
+    // released.
     locked_ptr_template(const locked_ptr_template& o)
         requires (k_type == lock_type::shared_const)
         : locked_ptr_template{o.mutex_protect_wrapper_}
     {
-        if (mutex_protect_wrapper_) {
+        if (!mutex_protect_wrapper_) {
+            return;
+        }
+        if constexpr (requires (Mutex& mutex) { mutex.add_shared(); }) {
+            mutex_protect_wrapper_->mutex_.add_shared();
+        } else {
             mutex_protect_wrapper_->mutex_.lock_shared();
         }
     }
@@ -242,6 +740,52 @@ class mutex_protect_wrapper<T, Mutex>::locked_ptr_template
         requires (k_type == lock_type::unique_const)
         : locked_ptr_template{o.mutex_protect_wrapper_}
     {
+        o.end_write_();
+        o.mutex_protect_wrapper_ = nullptr;
+    }
+
+    // Move-construct a `shared_locked_ptr` from a `locked_ptr` or a `const_locked_ptr` `o`. The exclusive ownership
+    // held by `o` is downgraded to a shared ownership atomically. It is only available when `Mutex` supports
+    // `unlock_and_lock_shared` (e.g. `slontia::shared_mutex`).
+    locked_ptr_template(locked_ptr_template<lock_type::unique_mutable>&& o) noexcept
+        requires (k_type == lock_type::shared_const && requires (Mutex& mutex) { mutex.unlock_and_lock_shared(); })
+        : locked_ptr_template{o.mutex_protect_wrapper_}
+    {
+        o.end_write_();
+        downgrade_();
+        o.mutex_protect_wrapper_ = nullptr;
+    }
+    locked_ptr_template(locked_ptr_template<lock_type::unique_const>&& o) noexcept
+        requires (k_type == lock_type::shared_const && requires (Mutex& mutex) { mutex.unlock_and_lock_shared(); })
+        : locked_ptr_template{o.mutex_protect_wrapper_}
+    {
+        downgrade_();
+        o.mutex_protect_wrapper_ = nullptr;
+    }
+
+    // Move-construct a `shared_locked_ptr` from an `upgradable_locked_ptr` `o`. The upgrade ownership held by `o` is
+    // downgraded to a shared ownership atomically.
+    locked_ptr_template(locked_ptr_template<lock_type::upgrade_const>&& o) noexcept
+        requires (k_type == lock_type::shared_const)
+        : locked_ptr_template{o.mutex_protect_wrapper_}
+    {
+        if (mutex_protect_wrapper_) {
+            mutex_protect_wrapper_->mutex_.unlock_upgrade_and_lock_shared();
+        }
+        o.mutex_protect_wrapper_ = nullptr;
+    }
+
+    // Move-construct a `locked_ptr_template` from an `upgradable_locked_ptr` `o`. The upgrade ownership held by `o` is
+    // upgraded to the exclusive ownership atomically, which blocks until all the shared ownerships are released.
+    locked_ptr_template(locked_ptr_template<lock_type::upgrade_const>&& o)
+        requires (k_type == lock_type::unique_mutable)
+        // `o` can only be created by the non-const `lock_upgrade` or `try_lock_upgrade`, so the wrapper is mutable.
+        : locked_ptr_template{const_cast<mutex_protect_wrapper*>(o.mutex_protect_wrapper_)}
+    {
+        if (mutex_protect_wrapper_) {
+            mutex_protect_wrapper_->mutex_.unlock_upgrade_and_lock();
+            mutex_protect_wrapper_->read_.begin_write();
+        }
         o.mutex_protect_wrapper_ = nullptr;
     }
 
@@ -249,6 +793,7 @@ class mutex_protect_wrapper<T, Mutex>::locked_ptr_template
     ~locked_ptr_template()
     {
         if (mutex_protect_wrapper_) {
+            end_write_();
             lock_helper<k_type>::unlock(mutex_protect_wrapper_->mutex_);
         }
     }
@@ -289,15 +834,155 @@ class mutex_protect_wrapper<T, Mutex>::locked_ptr_template
     void swap(locked_ptr_template& o) noexcept { std::swap(mutex_protect_wrapper_, o.mutex_protect_wrapper_); }
 
   private:
+    // Notifies the read policy that the object will not be modified through `*this` anymore.
+    void end_write_() noexcept
+    {
+        if constexpr (k_type == lock_type::unique_mutable) {
+            if (mutex_protect_wrapper_) {
+                mutex_protect_wrapper_->read_.end_write();
+            }
+        }
+    }
+
+    void downgrade_() noexcept
+    {
+        if (mutex_protect_wrapper_) {
+            mutex_protect_wrapper_->mutex_.unlock_and_lock_shared();
+        }
+    }
+
     // Constructs with a `mutex_protect_wrapper`. After the construction, `*this` will lock the mutex and stores a
     // pointer to the object owned by `wrapper`.
     explicit locked_ptr_template(mutex_protect_wrapper* const wrapper) noexcept : mutex_protect_wrapper_{wrapper} {}
     explicit locked_ptr_template(const mutex_protect_wrapper* const wrapper) noexcept
-        requires (k_type == lock_type::unique_const || k_type == lock_type::shared_const)
+        requires (k_type != lock_type::unique_mutable)
         : mutex_protect_wrapper_{wrapper} {}
 
     std::conditional_t<k_type == lock_type::unique_mutable, mutex_protect_wrapper, const mutex_protect_wrapper>*
         mutex_protect_wrapper_{nullptr};
 };
 
+// The `lock_request_template` class template refers to a `mutex_protect_wrapper` and the mode to lock it. It does not
+// hold any ownerships of the mutex by itself, and can only be acquired by `slontia::lock_all`.
+template <typename T, typename Mutex, typename Read, typename Write, typename Profile>
+template <mutex_protect_wrapper_base::lock_type k_type>
+class mutex_protect_wrapper<T, Mutex, Read, Write, Profile>::lock_request_template
+{
+    friend class mutex_protect_wrapper;
+
+    template <typename ...Requests>
+    friend std::tuple<typename Requests::locked_ptr_type...> lock_all(Requests... requests);
+
+  public:
+    // The type of the locked pointer returned by `slontia::lock_all` for this request.
+    using locked_ptr_type = locked_ptr_template<k_type>;
+
+  private:
+    explicit lock_request_template(mutex_protect_wrapper* const wrapper) noexcept : mutex_protect_wrapper_{wrapper} {}
+
+    const void* address_() const noexcept { return mutex_protect_wrapper_; }
+
+    void lock_() const { lock_helper<k_type>::lock(mutex_protect_wrapper_->mutex_); }
+
+    bool try_lock_() const { return lock_helper<k_type>::try_lock(mutex_protect_wrapper_->mutex_); }
+
+    void unlock_() const { lock_helper<k_type>::unlock(mutex_protect_wrapper_->mutex_); }
+
+    // Returns a locked pointer which takes over the ownership acquired by `lock_` or `try_lock_`.
+    locked_ptr_type adopt_() const noexcept { return mutex_protect_wrapper_->template adopt_<k_type>(); }
+
+    mutex_protect_wrapper* mutex_protect_wrapper_;
+};
+
+// The `async_lock_awaiter` class template wraps the awaitable to lock the mutex, and returns a locked pointer after the
+// ownership is acquired.
+template <typename T, typename Mutex, typename Read, typename Write, typename Profile>
+template <mutex_protect_wrapper_base::lock_type k_type, typename Awaiter>
+class mutex_protect_wrapper<T, Mutex, Read, Write, Profile>::async_lock_awaiter
+{
+    friend class mutex_protect_wrapper;
+
+  public:
+    bool await_ready() { return awaiter_.await_ready(); }
+
+    decltype(auto) await_suspend(const std::coroutine_handle<> handle) { return awaiter_.await_suspend(handle); }
+
+    locked_ptr_template<k_type> await_resume()
+    {
+        awaiter_.await_resume();
+        return mutex_protect_wrapper_.template adopt_<k_type>();
+    }
+
+  private:
+    // The awaitable of the mutex may be neither copyable nor movable, so it is constructed in place by `make_awaiter`.
+    template <typename MakeAwaiter>
+    async_lock_awaiter(mutex_protect_wrapper& wrapper, const MakeAwaiter& make_awaiter)
+        : mutex_protect_wrapper_{wrapper}, awaiter_{make_awaiter()} {}
+
+    mutex_protect_wrapper& mutex_protect_wrapper_;
+    Awaiter awaiter_;
+};
+
+// Acquires the ownerships described by `requests` without deadlock, and returns a tuple of the locked pointers in the
+// same order as `requests`. The requests are created by `lock_request`, `lock_const_request` or `lock_shared_request`
+// of `mutex_protect_wrapper` objects, which can wrap different types of objects and mutexes.
+//
+// The thread blocks on the request of the wrapper with the lowest address, and tries to acquire the others in order of
+// the addresses. If one of them fails, all the acquired ownerships are released, and the thread blocks on the failed
+// one first in the next round. So the threads locking the same wrappers by `lock_all` acquire them in the same order,
+// and no thread keeps an ownership while it is blocked, even if other threads lock the wrappers in arbitrary orders.
+//
+// The requests must refer to different `mutex_protect_wrapper` objects.
+template <typename ...Requests>
+std::tuple<typename Requests::locked_ptr_type...> lock_all(Requests... requests)
+{
+    constexpr std::size_t k_request_num = sizeof...(Requests);
+    static_assert(k_request_num > 0, "there should be at least one request");
+
+    const std::tuple<const Requests&...> request_tuple{requests...};
+    const std::array<const void*, k_request_num> addresses{requests.address_()...};
+
+    // Invokes `fn` with the `index`-th request and returns the result.
+    const auto visit = [&](const std::size_t index, const auto& fn)
+    {
+        return [&]<std::size_t ...k_indexes>(std::index_sequence<k_indexes...>)
+        {
+            bool result = false;
+            ((index == k_indexes && (result = fn(std::get<k_indexes>(request_tuple)), true)) || ...);
+            return result;
+        }(std::index_sequence_for<Requests...>{});
+    };
+    const auto lock = [](const auto& request) { return request.lock_(), true; };
+    const auto try_lock = [](const auto& request) { return request.try_lock_(); };
+    const auto unlock = [](const auto& request) { return request.unlock_(), true; };
+
+    std::array<std::size_t, k_request_num> order;
+    std::iota(order.begin(), order.end(), 0);
+    std::ranges::sort(order, std::less<const void*>{}, [&](const std::size_t index) { return addresses[index]; });
+
+    for (std::size_t blocking_pos = 0; ; ) {
+        visit(order[blocking_pos], lock);
+        std::size_t failed_pos = 0;
+        while (failed_pos < k_request_num &&
+                (failed_pos == blocking_pos || visit(order[failed_pos], try_lock))) {
+            ++failed_pos;
+        }
+        if (failed_pos == k_request_num) {
+            break;
+        }
+        // Back off and block on the failed request in the next round. Yielding gives the thread holding it a chance
+        // to release it before we are parked.
+        for (std::size_t pos = 0; pos < failed_pos; ++pos) {
+            if (pos != blocking_pos) {
+                visit(order[pos], unlock);
+            }
+        }
+        visit(order[blocking_pos], unlock);
+        blocking_pos = failed_pos;
+        std::this_thread::yield();
+    }
+
+    return std::tuple<typename Requests::locked_ptr_type...>{requests.adopt_()...};
+}
+
 }
@@ -0,0 +1,155 @@
+// Copyright (c) 2024, Chang Liu <github.com/slontia>. All rights reserved.
+//
+// This source code is licensed under MIT (found in the LICENSE file).
+
+#pragma once
+
+#include "shared_mutex.h"
+
+#include <atomic>
+#include <cstdint>
+
+namespace slontia {
+namespace internal {
+
+// The `slontia::internal::packed_shared_mutex` class template is a variant of `slontia::internal::shared_mutex` which
+// packs the number of writers, the holding state of the writer and the number of readers into one 32-bit atomic
+// variable. Since the whole state can be observed and modified at once, a reader acquires the mutex with a single CAS
+// instead of increasing the reader count and rolling back when a writer arrives in between.
+//
+// `slontia::internal::packed_shared_mutex` has the same characteristics as `slontia::internal::shared_mutex`, and
+// besides:
+// - Readers never modify the state when writers are waiting, so no rollbacks and spurious notifications happen;
+// - Readers contend with each other by CAS rather than `fetch_add`, which may be slower with many concurrent readers;
+// - All threads are parked on the same atomic variable, so a notification wakes up both readers and writers;
+// - The number of readers should be less than (1 << 20), and the number of writers should be less than (1 << 11).
+//
+// The `Wait` and `Wake` policies are the same as `slontia::internal::shared_mutex`.
+template <typename AtomicUInt32, typename Wait = spin_wait<>, typename Wake = notify_always>
+class packed_shared_mutex
+{
+  public:
+    // Acquires an exclusive ownership of the `packed_shared_mutex`. If another thread is holding an exclusive lock or
+    // a shared lock on the same `packed_shared_mutex` the a call to lock will block execution until all such locks are
+    // released. While `packed_shared_mutex` is locked in an exclusive mode, no other lock of any kind can also be held.
+    void lock() noexcept
+    {
+        // Ensure that no readers can hold shared ownerships anymore.
+        state_.fetch_add(k_writer_unit, std::memory_order::acquire);
+
+        atomic_wait_until_zero([this] { return try_set_holding_state_(); }, state_, wait_, wake_,
+                wake_channel::k_writers);
+    }
+
+    // Tries to lock the mutex. Returns immediately. On successful lock acquisition returns true, otherwise returns
+    // false.
+    bool try_lock() noexcept
+    {
+        // Register as a writer and set the holding state at once, so there is nothing to roll back on failure.
+        auto state = state_.load(std::memory_order::relaxed);
+        do {
+            if (state & (k_reader_mask | k_holding_state)) {
+                return false;
+            }
+        } while (!state_.compare_exchange_weak(state, state + k_writer_unit + k_holding_state,
+                    std::memory_order::acquire, std::memory_order::relaxed));
+        return true;
+    }
+
+    // Unlocks the mutex.
+    // The mutex must be locked by a thread. The thread need not be the current thread of execution.
+    void unlock() noexcept
+    {
+        state_.fetch_sub(k_writer_unit + k_holding_state, std::memory_order::release);
+        // Readers and writers are parked on the same atomic variable, so we cannot only notify one of the writers.
+        notify_all_();
+    }
+
+    // Atomically downgrades the exclusive ownership to a shared ownership. Unlike calling `unlock` and `lock_shared`
+    // in turn, no other writers can lock the mutex in between.
+    // The mutex must be locked by a thread in exclusive mode. The thread need not be the current thread of execution.
+    void unlock_and_lock_shared() noexcept
+    {
+        state_.fetch_sub(k_writer_unit + k_holding_state - 1, std::memory_order::release);
+        notify_all_();
+    }
+
+    // Acquires shared ownership of the mutex. If another thread is acquiring or holding the mutex in exclusive
+    // ownership, a call to `lock_shared` will block execution until shared ownership can be acquired.
+    void lock_shared() noexcept
+    {
+        atomic_wait_until_zero([this] { return try_lock_shared_internal_(); }, state_, wait_, wake_,
+                wake_channel::k_readers);
+    }
+
+    // Tries to lock the mutex in shared mode. Returns immediately. On successful lock acquisition returns true,
+    // otherwise returns false.
+    bool try_lock_shared() noexcept { return try_lock_shared_internal_() == 0; }
+
+    // Releases the mutex from shared ownership by the calling thread.
+    // The mutex must be locked by a thread in shared mode. The thread need not be the current thread of execution.
+    void unlock_shared() noexcept
+    {
+        const auto state = state_.fetch_sub(1, std::memory_order::release) - 1;
+        // Only the writers have to be notified when the last reader releases, but the readers are parked on the same
+        // atomic variable.
+        if ((state & k_reader_mask) == 0 && (state & k_writer_mask) > 0 && wake_.has_parked(wake_channel::k_writers)) {
+            state_.notify_all();
+        }
+    }
+
+  private:
+    // Set `k_holding_state` to `state_` if there are neither readers nor another writer holding the mutex.
+    // Return 0 if we lock in exclusive mode successfully, otherwise the current value of `state_`.
+    std::uint32_t try_set_holding_state_() noexcept
+    {
+        auto state = state_.load(std::memory_order::relaxed);
+        while ((state & (k_reader_mask | k_holding_state)) == 0) {
+            if (state_.compare_exchange_weak(state, state | k_holding_state, std::memory_order::acquire,
+                        std::memory_order::relaxed)) {
+                return 0;
+            }
+        }
+        return state;
+    }
+
+    // Increase the number of readers by 1 if there are no writers.
+    // Return 0 if we lock in shared mode successfully, otherwise the current value of `state_`.
+    std::uint32_t try_lock_shared_internal_() noexcept
+    {
+        auto state = state_.load(std::memory_order::relaxed);
+        while ((state & k_writer_mask) == 0) {
+            if (state_.compare_exchange_weak(state, state + 1, std::memory_order::acquire,
+                        std::memory_order::relaxed)) {
+                return 0;
+            }
+        }
+        return state;
+    }
+
+    void notify_all_() noexcept
+    {
+        if (wake_.has_parked(wake_channel::k_readers) || wake_.has_parked(wake_channel::k_writers)) {
+            state_.notify_all();
+        }
+    }
+
+    static constexpr std::uint32_t k_reader_mask = (1u << 20) - 1;
+    static constexpr std::uint32_t k_holding_state = (1u << 20);
+    static constexpr std::uint32_t k_writer_unit = (1u << 21);
+    static constexpr std::uint32_t k_writer_mask = ~(k_reader_mask | k_holding_state);
+
+    // The bits 0-19 are the number of threads holding the mutex for shared ownership, the bit 20 is set if a thread is
+    // holding the mutex for exclusive ownership, and the bits 21-31 are the number of threads acquiring or holding the
+    // mutex for exclusive ownership.
+    AtomicUInt32 state_{0};
+
+    [[no_unique_address]] Wait wait_;
+    [[no_unique_address]] Wake wake_;
+};
+
+}
+
+struct packed_shared_mutex : public internal::packed_shared_mutex<std::atomic<std::uint32_t>> {};
+
+}
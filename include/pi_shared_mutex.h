@@ -0,0 +1,92 @@
+// Copyright (c) 2024, Chang Liu <github.com/slontia>. All rights reserved.
+//
+// This source code is licensed under MIT (found in the LICENSE file).
+
+#pragma once
+
+#include "shared_mutex.h"
+
+#if !defined(__linux__)
+#error "Priority-inheritance mutexes are only supported on Linux"
+#endif
+
+#include <atomic>
+#include <cstdint>
+
+namespace slontia {
+
+// The `slontia::pi_shared_mutex` class is a variant of `slontia::shared_mutex` whose exclusive ownership supports
+// priority inheritance, which avoids the priority inversion when real-time threads wait for a preempted writer of a
+// lower priority.
+//
+// The writers are serialized by an `internal::pi_futex_t` storing the thread ID of the writer, which is held from the
+// beginning of `lock` to the end of `unlock`, and then arbitrate with the readers by an inner `slontia::shared_mutex`.
+// A reader failing to acquire the shared ownership blocks on the `internal::pi_futex_t` until the writer releases it,
+// so the kernel boosts the writer for both the blocked writers and readers. The uncontended readers only count
+// themselves as `slontia::shared_mutex` does, without touching the `internal::pi_futex_t`.
+//
+// In return, `slontia::pi_shared_mutex` has the following trade-offs:
+// - Unlike other mutexes of this library, the exclusive ownership must be released by the thread which acquires it,
+//   since the kernel tracks the owner by its thread ID. The shared ownership can still be released by any thread;
+// - The readers holding the shared ownership are not boosted, so a writer waiting for them can still be blocked by
+//   preempted readers of lower priority;
+// - The contended readers pass through the `internal::pi_futex_t` one by one after the writer releases it, and
+//   acquiring the exclusive ownership takes one more CAS.
+class pi_shared_mutex
+{
+  public:
+    // Acquires an exclusive ownership of the mutex. The ownership must be released by the same thread.
+    void lock() noexcept
+    {
+        writer_lock_.lock();
+        mutex_.lock();
+    }
+
+    // Tries to lock the mutex. Returns immediately. On successful lock acquisition returns true, otherwise returns
+    // false.
+    bool try_lock() noexcept
+    {
+        if (!writer_lock_.try_lock()) {
+            return false;
+        }
+        if (!mutex_.try_lock()) {
+            writer_lock_.unlock();
+            return false;
+        }
+        return true;
+    }
+
+    // Unlocks the mutex. The mutex must be locked by the current thread of execution. If some threads are blocked on
+    // the mutex, the priority of the current thread is restored.
+    void unlock() noexcept
+    {
+        mutex_.unlock();
+        writer_lock_.unlock();
+    }
+
+    // Acquires shared ownership of the mutex. If a writer is acquiring or holding the mutex, blocks until the writer
+    // releases it, and the writer inherits the priority of the current thread meanwhile.
+    void lock_shared() noexcept
+    {
+        // The `writing_num_` of `mutex_` is increased only by the writer holding `writer_lock_`, so the failure implies
+        // that `writer_lock_` has been held by the writer blocking us, unless it has just been released.
+        while (!mutex_.try_lock_shared()) {
+            writer_lock_.lock();
+            writer_lock_.unlock();
+        }
+    }
+
+    // Tries to lock the mutex in shared mode. Returns immediately. On successful lock acquisition returns true,
+    // otherwise returns false.
+    bool try_lock_shared() noexcept { return mutex_.try_lock_shared(); }
+
+    // Unlocks the mutex from shared mode.
+    // The mutex must be locked by a thread in shared mode. The thread need not be the current thread of execution.
+    void unlock_shared() noexcept { mutex_.unlock_shared(); }
+
+  private:
+    internal::pi_futex_t writer_lock_;
+    slontia::shared_mutex mutex_;
+};
+
+}
@@ -0,0 +1,200 @@
+// Copyright (c) 2024, Chang Liu <github.com/slontia>. All rights reserved.
+//
+// This source code is licensed under MIT (found in the LICENSE file).
+
+#pragma once
+
+#include "shared_mutex.h"
+
+#if !defined(__linux__) && !defined(__APPLE__) && !defined(__FreeBSD__)
+#error "Process-shared mutexes are not supported on this platform"
+#endif
+
+#include <signal.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <optional>
+#include <type_traits>
+
+namespace slontia {
+
+// The variant of `slontia::shared_timed_mutex` which can be placed in a memory region shared by several processes
+// (e.g. memory mapped by `mmap` with `MAP_SHARED`), so that the processes can share the data in the region as threads
+// do. The mutex should be constructed in the region by placement new before any process accesses it.
+//
+// The parked threads are woken up by the shared (non-private) futex operations on Linux, which look up the physical
+// address of the atomic variables. All the states, including the counts of the `notify_parked` policy, are stored in
+// atomic variables in the mutex, so the mutex works no matter where the region is mapped in each process.
+struct process_shared_mutex
+    : public internal::shared_timed_mutex<internal::process_shared_timed_atomic_uint32_t, compact_layout,
+        spin_wait<>, notify_parked>
+{};
+
+static_assert(std::is_trivially_destructible_v<process_shared_mutex>,
+        "the mutex in the shared memory region may be unmapped without being destructed");
+
+// The `slontia::robust_process_shared_mutex` class is a variant of `slontia::process_shared_mutex` which recovers from
+// the death of the process holding the exclusive ownership, so one crashed process will not block all the others
+// forever.
+//
+// The exclusive owner records its process ID in the mutex. The threads failing to acquire the mutex check whether the
+// owner is still alive every `k_owner_check_interval`, and the first one finding the owner dead releases the exclusive
+// ownership on behalf of the owner. The next exclusive owner can tell it by `recovered()`, and should repair the
+// protected data, which may be left inconsistent by the dead owner.
+//
+// There are some limitations:
+// - Only the death of the exclusive owner is recovered. A process dying while holding a shared ownership or waiting for
+//   the exclusive ownership blocks the writers or the readers forever;
+// - A process dying between acquiring the exclusive ownership and recording its process ID cannot be recovered;
+// - A dead process is detected only after it is reaped by its parent, and a reused process ID is regarded as alive.
+class robust_process_shared_mutex
+{
+    static_assert(std::atomic<pid_t>::is_always_lock_free, "the process ID should be stored in the shared memory");
+
+  public:
+    // The period to check whether the exclusive owner is alive when the mutex cannot be acquired.
+    static constexpr auto k_owner_check_interval = std::chrono::milliseconds(100);
+
+    void lock() noexcept
+    {
+        acquire_until_([this](const auto& check_time) { return try_lock_until_internal_(check_time); }, std::nullopt);
+    }
+
+    bool try_lock() noexcept
+    {
+        if (!mutex_.try_lock()) {
+            return false;
+        }
+        owner_pid_.store(::getpid(), std::memory_order::relaxed);
+        return true;
+    }
+
+    template <typename Rep, class Period>
+    bool try_lock_for(const std::chrono::duration<Rep, Period>& timeout_duration) noexcept
+    {
+        return try_lock_until(std::chrono::steady_clock::now() + timeout_duration);
+    }
+
+    template <typename Clock, class Duration>
+    bool try_lock_until(const std::chrono::time_point<Clock, Duration>& timeout_time) noexcept
+    {
+        return acquire_until_([this](const auto& check_time) { return try_lock_until_internal_(check_time); },
+                to_steady_time_(timeout_time));
+    }
+
+    bool try_lock_until(const slontia::deadline& deadline) noexcept
+    {
+        return acquire_until_([this](const auto& check_time) { return try_lock_until_internal_(check_time); },
+                deadline.at());
+    }
+
+    void unlock() noexcept
+    {
+        // The process ID is cleared before the exclusive ownership is released, so the recovering threads checking our
+        // liveness never release the ownership of the next owner.
+        owner_pid_.store(0, std::memory_order::relaxed);
+        mutex_.unlock();
+    }
+
+    void lock_shared() noexcept
+    {
+        acquire_until_([this](const auto& check_time) { return mutex_.try_lock_shared_until(check_time); },
+                std::nullopt);
+    }
+
+    bool try_lock_shared() noexcept { return mutex_.try_lock_shared(); }
+
+    template <typename Rep, class Period>
+    bool try_lock_shared_for(const std::chrono::duration<Rep, Period>& timeout_duration) noexcept
+    {
+        return try_lock_shared_until(std::chrono::steady_clock::now() + timeout_duration);
+    }
+
+    template <typename Clock, class Duration>
+    bool try_lock_shared_until(const std::chrono::time_point<Clock, Duration>& timeout_time) noexcept
+    {
+        return acquire_until_([this](const auto& check_time) { return mutex_.try_lock_shared_until(check_time); },
+                to_steady_time_(timeout_time));
+    }
+
+    bool try_lock_shared_until(const slontia::deadline& deadline) noexcept
+    {
+        return acquire_until_([this](const auto& check_time) { return mutex_.try_lock_shared_until(check_time); },
+                deadline.at());
+    }
+
+    void unlock_shared() noexcept { mutex_.unlock_shared(); }
+
+    // Returns true if the exclusive ownership has been released on behalf of a dead owner since the last call. It
+    // should be called by the exclusive owner.
+    bool recovered() noexcept { return recovered_.exchange(false, std::memory_order::relaxed); }
+
+  private:
+    template <typename Clock, class Duration>
+    static std::chrono::steady_clock::time_point to_steady_time_(
+            const std::chrono::time_point<Clock, Duration>& timeout_time) noexcept
+    {
+        if constexpr (std::is_same_v<Clock, std::chrono::steady_clock>) {
+            return std::chrono::ceil<std::chrono::steady_clock::duration>(timeout_time);
+        } else {
+            return std::chrono::steady_clock::now() + std::chrono::ceil<std::chrono::steady_clock::duration>(
+                    timeout_time - Clock::now());
+        }
+    }
+
+    bool try_lock_until_internal_(const std::chrono::steady_clock::time_point& check_time) noexcept
+    {
+        if (!mutex_.try_lock_until(check_time)) {
+            return false;
+        }
+        owner_pid_.store(::getpid(), std::memory_order::relaxed);
+        return true;
+    }
+
+    // Keeps trying to acquire the mutex by `try_acquire_until`, which gives up at the next check of the owner, until the
+    // mutex is acquired or the `deadline` is reached. A `deadline` of `std::nullopt` means no timeout.
+    template <typename TryAcquireUntil>
+    bool acquire_until_(const TryAcquireUntil& try_acquire_until,
+            const std::optional<std::chrono::steady_clock::time_point> deadline) noexcept
+    {
+        while (true) {
+            auto check_time = std::chrono::steady_clock::now() + k_owner_check_interval;
+            const bool is_last_try = deadline.has_value() && *deadline <= check_time;
+            if (is_last_try) {
+                check_time = *deadline;
+            }
+            if (try_acquire_until(check_time)) {
+                return true;
+            }
+            if (is_last_try) {
+                return false;
+            }
+            recover_if_owner_died_();
+        }
+    }
+
+    void recover_if_owner_died_() noexcept
+    {
+        auto pid = owner_pid_.load(std::memory_order::relaxed);
+        if (pid == 0 || ::kill(pid, 0) == 0 || errno != ESRCH) {
+            return;
+        }
+        // Only one thread wins the recovery. The dead owner never clears its process ID, so the exchange fails if the
+        // ownership has been released.
+        if (owner_pid_.compare_exchange_strong(pid, 0, std::memory_order::relaxed)) {
+            recovered_.store(true, std::memory_order::relaxed);
+            mutex_.unlock();
+        }
+    }
+
+    process_shared_mutex mutex_;
+    std::atomic<pid_t> owner_pid_{0};
+    std::atomic<bool> recovered_{false};
+};
+
+}
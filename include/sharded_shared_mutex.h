@@ -0,0 +1,202 @@
+// Copyright (c) 2024, Chang Liu <github.com/slontia>. All rights reserved.
+//
+// This source code is licensed under MIT (found in the LICENSE file).
+
+#pragma once
+
+#include "shared_mutex.h"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+namespace slontia {
+namespace internal {
+
+// The `slontia::internal::sharded_shared_mutex` class template is a variant of `slontia::internal::shared_mutex`
+// which distributes the number of shared ownerships over `k_shard_num` reader counters. Each reader counter occupies an
+// individual cache line, and each thread only modifies the reader counter it is assigned to, so threads acquiring shared
+// ownerships concurrently do not contend for the same cache line.
+//
+// `slontia::internal::sharded_shared_mutex` has the same characteristics as `slontia::internal::shared_mutex`, and
+// besides:
+// - Concurrent acquisition for shared ownerships scales better with the number of threads;
+// - Acquisition for exclusive ownership is more expensive because all the reader counters have to be visited;
+// - The footprint is about `k_shard_num + 2` cache lines.
+template <typename AtomicUInt32, std::size_t k_shard_num>
+class sharded_shared_mutex
+{
+    static_assert(k_shard_num > 0, "there should be at least one reader counter");
+
+  public:
+    // Acquires an exclusive ownership of the `sharded_shared_mutex`. If another thread is holding an exclusive lock or
+    // a shared lock on the same `sharded_shared_mutex` the a call to lock will block execution until all such locks are
+    // released. While `sharded_shared_mutex` is locked in an exclusive mode, no other lock of any kind can also be held.
+    void lock() noexcept
+    {
+        // Ensure that no readers can hold shared ownerships anymore.
+        increase_writing_num_();
+
+        // Compete with other writers.
+        atomic_wait_until_zero([this] { return try_set_writer_holding_(); }, writer_holding_);
+
+        // Wait for the readers which have held shared ownerships before we increased `writing_num_`.
+        wait_until_no_readers_();
+    }
+
+    // Tries to lock the mutex. Returns immediately. On successful lock acquisition returns true, otherwise returns
+    // false.
+    bool try_lock() noexcept
+    {
+        // Ensure that no readers can hold shared ownerships anymore.
+        increase_writing_num_();
+
+        if (try_set_writer_holding_() > 0) {
+            // Another writer is holding the mutex.
+            decrease_writing_num_();
+            return false;
+        }
+        if (reader_num_() > 0) {
+            // Some readers are holding the mutex.
+            unlock();
+            return false;
+        }
+        return true;
+    }
+
+    // Unlocks the mutex.
+    // The mutex must be locked by a thread. The thread need not be the current thread of execution.
+    void unlock() noexcept
+    {
+        writer_holding_.store(0, std::memory_order::release);
+
+        // Notify all waiting readers if there are no waiting writers.
+        if (!decrease_writing_num_()) {
+            // There are some waiting writers, so we notify one of them.
+            writer_holding_.notify_one();
+        }
+    }
+
+    // Acquires shared ownership of the mutex. If another thread is acquiring or holding the mutex in exclusive
+    // ownership, a call to `lock_shared` will block execution until shared ownership can be acquired.
+    void lock_shared() noexcept
+    {
+        auto& reader_counter = this_thread_reader_counter_();
+        atomic_wait_until_zero([&] { return try_lock_shared_internal_(reader_counter); }, writing_num_);
+    }
+
+    // Tries to lock the mutex in shared mode. Returns immediately. On successful lock acquisition returns true,
+    // otherwise returns false.
+    bool try_lock_shared() noexcept { return try_lock_shared_internal_(this_thread_reader_counter_()) == 0; }
+
+    // Releases the mutex from shared ownership by the calling thread.
+    // The mutex must be locked by a thread in shared mode. The thread need not be the current thread of execution.
+    void unlock_shared() noexcept { unlock_shared_internal_(this_thread_reader_counter_()); }
+
+  private:
+    // Each reader counter is aligned to a cache line to avoid false sharing.
+    struct alignas(k_cache_line_size) reader_counter
+    {
+        AtomicUInt32 value_{0};
+    };
+
+    void increase_writing_num_() noexcept { writing_num_.fetch_add(1, std::memory_order::seq_cst); }
+
+    // Notify all waiting readers if there are no waiting writers.
+    // We can only decrease `writing_num_` by invoking this function. Otherwise, threads acquiring shared ownerships can
+    // be blocked infinitly.
+    bool decrease_writing_num_() noexcept
+    {
+        if (writing_num_.fetch_sub(1, std::memory_order::release) == 1) {
+            writing_num_.notify_all();
+            return true;
+        }
+        return false;
+    }
+
+    // Set 1 to `writer_holding_` if the value of `writer_holding_` is 0.
+    // Return the current value of `writer_holding_`. The value of 0 indicates we win the competition among writers.
+    std::uint32_t try_set_writer_holding_() noexcept
+    {
+        std::uint32_t writer_holding = 0;
+        writer_holding_.compare_exchange_strong(writer_holding, 1, std::memory_order::acquire);
+        return writer_holding;
+    }
+
+    // Increase `reader_counter` by 1 if the value of `writing_num` is 0.
+    // Return the current value of `writing_num_`. The value of 0 indicates we lock in shared mode successfully.
+    std::uint32_t try_lock_shared_internal_(reader_counter& reader_counter) noexcept
+    {
+        auto writing_num = writing_num_.load(std::memory_order::acquire);
+        if (writing_num == 0) {
+            // The sequentially-consistent ordering on both the reader side and the writer side guarantees that either
+            // the writer observes our increment when summing up the reader counters, or we observe the increment of
+            // `writing_num_` here.
+            reader_counter.value_.fetch_add(1, std::memory_order::seq_cst);
+            if ((writing_num = writing_num_.load(std::memory_order::seq_cst)) > 0) [[unlikely]] {
+                unlock_shared_internal_(reader_counter);
+            }
+        }
+        return writing_num;
+    }
+
+    void unlock_shared_internal_(reader_counter& reader_counter) noexcept
+    {
+        reader_counter.value_.fetch_sub(1, std::memory_order::seq_cst);
+        // Only the writer holding `writer_holding_` waits for the readers, and it only has to be woken up when the last
+        // reader releases.
+        if (writing_num_.load(std::memory_order::seq_cst) > 0 && reader_num_() == 0) {
+            reader_released_num_.fetch_add(1, std::memory_order::release);
+            reader_released_num_.notify_one();
+        }
+    }
+
+    // Blocks until all the readers release their shared ownerships.
+    void wait_until_no_readers_() noexcept
+    {
+        for (;;) {
+            const auto reader_released_num = reader_released_num_.load(std::memory_order::acquire);
+            if (reader_num_() == 0) {
+                return;
+            }
+            reader_released_num_.wait(reader_released_num, std::memory_order::acquire);
+        }
+    }
+
+    // Returns the number of threads holding the mutex in shared mode.
+    // Since a shared ownership can be released in a different thread, a single reader counter can be underflowed, but
+    // the sum of all reader counters is always correct.
+    std::uint32_t reader_num_() const noexcept
+    {
+        std::uint32_t reader_num = 0;
+        for (const auto& reader_counter : reader_counters_) {
+            reader_num += reader_counter.value_.load(std::memory_order::seq_cst);
+        }
+        return reader_num;
+    }
+
+    reader_counter& this_thread_reader_counter_() noexcept
+    {
+        return reader_counters_[this_thread_slot() % k_shard_num];
+    }
+
+    // The number of threads that are acquiring the mutex for exclusive ownership.
+    alignas(k_cache_line_size) AtomicUInt32 writing_num_{0};
+
+    // The value is 1 if a thread is holding the mutex for exclusive ownership, otherwise 0.
+    alignas(k_cache_line_size) AtomicUInt32 writer_holding_{0};
+
+    // Increased when the last reader releases while writers are waiting. The writer waits on it for the readers.
+    AtomicUInt32 reader_released_num_{0};
+
+    // The numbers of threads that are holding the mutex for shared ownership.
+    std::array<reader_counter, k_shard_num> reader_counters_;
+};
+
+}
+
+// Each thread is assigned to one of the `k_shard_num` reader counters in a round-robin way.
+template <std::size_t k_shard_num = 16>
+struct sharded_shared_mutex : public internal::sharded_shared_mutex<std::atomic<std::uint32_t>, k_shard_num> {};
+
+}
@@ -0,0 +1,163 @@
+// Copyright (c) 2024, Chang Liu <github.com/slontia>. All rights reserved.
+//
+// This source code is licensed under MIT (found in the LICENSE file).
+
+#pragma once
+
+#include "mutex_protect_wrapper.h"
+#include "shared_mutex.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <source_location>
+#include <type_traits>
+#include <utility>
+
+namespace slontia {
+
+// The `sharded_wrapper` class template wraps `k_shard_num` objects, each of which is protected by an individual
+// `mutex_protect_wrapper` occupying individual cache lines. A key is routed to one of the shards by its hash, so the
+// threads visiting different keys rarely contend for the same mutex. It is useful to split a big container (e.g.
+// `std::unordered_map`) protected by one mutex into several small ones.
+//
+// The shard of a key is decided by `Hash`, whose result is mixed before being reduced to the shard index, so hashes
+// which only differ in the high bits (e.g. the identity hash of aligned pointers) are distributed as well. The `Profile`
+// policy of the shards decides whether the acquisitions are profiled by `slontia::contention_profiler` (`no_profile`
+// or `sampled_profile`), and the acquisitions are attributed to the callers of `sharded_wrapper`.
+// `sharded_wrapper` is neither copyable nor movable.
+template <typename T, typename Mutex, std::size_t k_shard_num = 16, typename Profile = no_profile>
+class sharded_wrapper
+{
+    static_assert(k_shard_num > 0, "there should be at least one shard");
+
+  public:
+    using wrapper_type = mutex_protect_wrapper<T, Mutex, locked_read, locked_write, Profile>;
+
+    using locked_ptr = typename wrapper_type::locked_ptr;
+
+    using const_locked_ptr = typename wrapper_type::const_locked_ptr;
+
+    using shared_locked_ptr = typename wrapper_type::shared_locked_ptr;
+
+    using object_type = T;
+
+    using mutex_type = Mutex;
+
+    // Constructs a `sharded_wrapper` object. Each object of type `T` is initialized from the arguments `args...`.
+    template <typename ...Args>
+    explicit sharded_wrapper(const Args& ...args)
+        : sharded_wrapper{std::make_index_sequence<k_shard_num>{}, args...} {}
+
+    sharded_wrapper(const sharded_wrapper&) = delete;
+    sharded_wrapper(sharded_wrapper&&) = delete;
+
+    sharded_wrapper& operator=(const sharded_wrapper&) = delete;
+    sharded_wrapper& operator=(sharded_wrapper&&) = delete;
+
+    // Returns the number of shards.
+    static constexpr std::size_t shard_num() noexcept { return k_shard_num; }
+
+    // Returns the index of the shard which `key` is routed to.
+    template <typename Key, typename Hash = std::hash<std::remove_cvref_t<Key>>>
+    static std::size_t shard_index(const Key& key, const Hash& hash = Hash{})
+    {
+        // Take the high bits of the Fibonacci hashing, which depend on all the bits of the hash.
+        const auto mixed = static_cast<std::uint64_t>(hash(key)) * 0x9E3779B97F4A7C15ull;
+        return static_cast<std::size_t>((mixed >> 32) % k_shard_num);
+    }
+
+    // Returns the `mutex_protect_wrapper` of the `index`-th shard.
+    wrapper_type& shard(const std::size_t index) noexcept { return shards_[index].wrapper_; }
+
+    // Returns the `mutex_protect_wrapper` of the shard which `key` is routed to.
+    template <typename Key>
+    wrapper_type& shard_of(const Key& key) { return shard(shard_index(key)); }
+
+    // Locks the shard which `key` is routed to in exclusive mode and returns a `locked_ptr` which points to the object
+    // of the shard. The returned `locked_ptr` is never null.
+    template <typename Key>
+    auto lock(const Key& key, const std::source_location& location = std::source_location::current())
+    {
+        return shard_of(key).lock(location);
+    }
+
+    // Tries to lock the shard which `key` is routed to in exclusive mode without blocking. On successful lock
+    // acquisition returns a `locked_ptr` which points to the object of the shard, otherwise returns a null
+    // `locked_ptr`.
+    template <typename Key>
+    auto try_lock(const Key& key, const std::source_location& location = std::source_location::current())
+    {
+        return shard_of(key).try_lock(location);
+    }
+
+    // Locks the shard which `key` is routed to in exclusive mode and returns a `const_locked_ptr` which points to the
+    // object of the shard. The returned `const_locked_ptr` is never null.
+    template <typename Key>
+    auto lock_const(const Key& key, const std::source_location& location = std::source_location::current())
+    {
+        return shard_of(key).lock_const(location);
+    }
+
+    // Locks the shard which `key` is routed to in shared mode and returns a `shared_locked_ptr` which points to the
+    // object of the shard. The returned `shared_locked_ptr` is never null.
+    template <typename Key>
+    auto lock_shared(const Key& key, const std::source_location& location = std::source_location::current())
+    {
+        return shard_of(key).lock_shared(location);
+    }
+
+    // Tries to lock the shard which `key` is routed to in shared mode without blocking. On successful lock acquisition
+    // returns a `shared_locked_ptr` which points to the object of the shard, otherwise returns a null
+    // `shared_locked_ptr`.
+    template <typename Key>
+    auto try_lock_shared(const Key& key, const std::source_location& location = std::source_location::current())
+    {
+        return shard_of(key).try_lock_shared(location);
+    }
+
+    // Locks all the shards in exclusive mode and returns the `locked_ptr`s in order of the shards. The shards are
+    // always locked in the same order, so it does not deadlock with other `lock_all` or `lock_all_shared` calls.
+    std::array<locked_ptr, k_shard_num> lock_all(
+            const std::source_location& location = std::source_location::current())
+    {
+        return lock_all_(&wrapper_type::lock, location);
+    }
+
+    // Locks all the shards in shared mode and returns the `shared_locked_ptr`s in order of the shards. `*this` can be
+    // scanned consistently with the returned pointers since no shards can be modified until they are released.
+    std::array<shared_locked_ptr, k_shard_num> lock_all_shared(
+            const std::source_location& location = std::source_location::current())
+    {
+        return lock_all_(&wrapper_type::lock_shared, location);
+    }
+
+  private:
+    struct alignas(internal::k_cache_line_size) shard_type
+    {
+        template <typename ...Args>
+        explicit shard_type(const Args& ...args) : wrapper_{args...} {}
+
+        wrapper_type wrapper_;
+    };
+
+    template <std::size_t ...k_indexes, typename ...Args>
+    explicit sharded_wrapper(std::index_sequence<k_indexes...>, const Args& ...args)
+        : shards_{(static_cast<void>(k_indexes), shard_type{args...})...} {}
+
+    template <typename LockedPtr>
+    std::array<LockedPtr, k_shard_num> lock_all_(LockedPtr (wrapper_type::* const lock_fn)(const std::source_location&),
+            const std::source_location& location)
+    {
+        std::array<LockedPtr, k_shard_num> locked_ptrs;
+        for (std::size_t i = 0; i < k_shard_num; ++i) {
+            locked_ptrs[i] = (shard(i).*lock_fn)(location);
+        }
+        return locked_ptrs;
+    }
+
+    std::array<shard_type, k_shard_num> shards_;
+};
+
+}
@@ -8,16 +8,557 @@
 #include "timed_atomic_uint32/timed_atomic_uint32_linux.h"
 #elif _WIN32
 #include "timed_atomic_uint32/timed_atomic_uint32_windows.h"
+#elif __APPLE__
+#include "timed_atomic_uint32/timed_atomic_uint32_darwin.h"
+#elif __FreeBSD__
+#include "timed_atomic_uint32/timed_atomic_uint32_freebsd.h"
 #else
-#error "Unsupported platform"
+#include "timed_atomic_uint32/timed_atomic_uint32_generic.h"
 #endif
 
+#include "deadline.h"
+
+#include <algorithm>
+#include <array>
 #include <atomic>
+#include <bit>
 #include <chrono>
+#include <cstddef>
+#include <stop_token>
+#include <thread>
+#include <type_traits>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#endif
 
 namespace slontia {
+
+namespace internal {
+
+// The size of a cache line, which is used to separate frequently modified atomic variables to avoid false sharing.
+// We do not use `std::hardware_destructive_interference_size` because its value can vary between compiler versions and
+// tuning flags, which makes it unsuitable for a header-only library.
+inline constexpr std::size_t k_cache_line_size = 64;
+
+// Returns an index which is unique for each thread. The indexes are assigned in the order that threads firstly invoke
+// this function, so the indexes of concurrently running threads are usually continuous.
+inline std::size_t this_thread_slot() noexcept
+{
+    static std::atomic<std::size_t> next_slot{0};
+    thread_local const std::size_t slot = next_slot.fetch_add(1, std::memory_order::relaxed);
+    return slot;
+}
+
+// Hints the processor that the thread is spinning, which reduces the power consumption and the penalty of leaving the
+// spinning loop.
+inline void cpu_relax() noexcept
+{
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    _mm_pause();
+#elif defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+// The result of `spin_until_zero`.
+struct spin_result
+{
+    // The last value returned by `fn`. The value of 0 indicates `fn` succeeded while spinning.
+    std::uint32_t value_;
+
+    // The number of rounds that have been spun.
+    std::uint32_t rounds_;
+};
+
+// Spins at most `max_rounds` rounds until the value returned by `fn` becomes 0. In the i-th round, the thread pauses
+// 2^i times if i is less than `k_pause_rounds`, otherwise it yields the processor. The value returned by `fn` should be
+// loaded from `atom`, and `fn` is invoked again only when the value of `atom` changes, so that the spinning thread does
+// not keep invalidating the cache line by read-modify-write operations.
+template <typename Fn, typename AtomicUInt32>
+spin_result spin_until_zero(const Fn& fn, const AtomicUInt32& atom, const std::uint32_t max_rounds) noexcept
+{
+    constexpr std::uint32_t k_pause_rounds = 6;
+    std::uint32_t current_value = fn();
+    std::uint32_t round = 0;
+    for (; current_value > 0 && round < max_rounds; ++round) {
+        if (round < k_pause_rounds) {
+            for (std::uint32_t i = 0; i < (1u << round); ++i) {
+                cpu_relax();
+            }
+        } else {
+            std::this_thread::yield();
+        }
+        if (atom.load(std::memory_order::relaxed) != current_value) {
+            current_value = fn();
+        }
+    }
+    return spin_result{current_value, round};
+}
+
+}
+
+// The layout policies decide how the atomic variables of `slontia::internal::shared_mutex` are placed in memory.
+//
+// `compact_layout` places the atomic variables next to each other, so the mutex takes as little memory as possible
+// (8 bytes for a 32-bit atomic type). However, the atomic variables are likely to share the same cache line, so
+// modifying one of them invalidates the cache line that other threads are polling.
+struct compact_layout
+{
+    template <typename AtomicUInt32>
+    static constexpr std::size_t alignment = alignof(AtomicUInt32);
+};
+
+// `padded_layout` places each atomic variable in an individual cache line to avoid false sharing between readers and
+// writers, at the cost of taking two cache lines. It is suitable for hot mutexes which are heavily contended.
+struct padded_layout
+{
+    template <typename AtomicUInt32>
+    static constexpr std::size_t alignment = internal::k_cache_line_size;
+};
+
+// The wait policies decide how a thread waits for the mutex before it is parked in the kernel. Each wait policy provides
+// a `spin(fn, atom)` member function, which returns 0 if the value returned by `fn` has become 0 while spinning, or
+// otherwise the last value returned by `fn`, with which the thread is going to be parked on `atom`.
+//
+// `park_wait` parks the thread as soon as the first attempt fails. It is suitable for long critical sections.
+struct park_wait
+{
+    template <typename Fn, typename AtomicUInt32>
+    std::uint32_t spin(const Fn& fn, const AtomicUInt32&) noexcept
+    {
+        return fn();
+    }
+};
+
+// `spin_wait` spins at most `k_spin_rounds` rounds with exponential backoff before the thread is parked, which saves
+// the system calls for short critical sections.
+template <std::uint32_t k_spin_rounds = 8>
+struct spin_wait
+{
+    template <typename Fn, typename AtomicUInt32>
+    std::uint32_t spin(const Fn& fn, const AtomicUInt32& atom) noexcept
+    {
+        return internal::spin_until_zero(fn, atom, k_spin_rounds).value_;
+    }
+};
+
+// `adaptive_spin_wait` learns the number of rounds to spin from the recent acquisitions, and spins at most
+// `k_max_spin_rounds` rounds. If recent acquisitions succeed by spinning, the thread spins longer, otherwise the
+// thread is parked sooner. Unlike the other wait policies, `adaptive_spin_wait` stores a state in the mutex.
+template <std::uint32_t k_max_spin_rounds = 12>
+class adaptive_spin_wait
+{
+  public:
+    template <typename Fn, typename AtomicUInt32>
+    std::uint32_t spin(const Fn& fn, const AtomicUInt32& atom) noexcept
+    {
+        const auto estimation = estimation_.load(std::memory_order::relaxed);
+        const auto spin_rounds = static_cast<std::uint32_t>((estimation + k_scale - 1) / k_scale);
+        const auto result = internal::spin_until_zero(fn, atom, std::min(spin_rounds * 2 + 2, k_max_spin_rounds));
+        // Move the estimation a quarter of the way towards the rounds spun this time. A failed spinning counts as zero
+        // round so that the waste of spinning is limited when the mutex is held for a long time.
+        const auto target = result.value_ == 0 ? static_cast<std::int32_t>(result.rounds_) * k_scale : 0;
+        estimation_.store(estimation + (target - estimation) / 4, std::memory_order::relaxed);
+        return result.value_;
+    }
+
+  private:
+    // The estimation is stored in the unit of `1 / k_scale` round to keep the precision.
+    static constexpr std::int32_t k_scale = 16;
+
+    std::atomic<std::int32_t> estimation_{k_scale};
+};
+
+// Readers are parked on `writing_num_` and writers are parked on `holding_num_`, so each kind of threads has its own
+// wake channel. Releasing the mutex wakes all the parked readers, or one of the parked writers.
+enum class wake_channel { k_readers, k_writers };
+
+// The wake policies decide whether a thread releasing the mutex has to issue a notification to a wake channel. Each
+// wake policy provides:
+// - `prepare_park(channel, fn, value)`, which is invoked before a thread is parked on `channel`, and returns the value
+//   to park with, or 0 if the value returned by `fn` has become 0;
+// - `finish_park(channel)`, which is invoked after the thread is woken up, or after `prepare_park` returns 0;
+// - `has_parked(channel)`, which returns false only if no threads are parked on `channel`. It should be invoked after
+//   the state of the mutex is modified.
+//
+// `notify_always` always issues notifications. It takes no space, and is suitable for atomic types (e.g.
+// `std::atomic<std::uint32_t>`) whose notifications are cheap when no threads are waiting.
+struct notify_always
+{
+    template <typename Fn>
+    std::uint32_t prepare_park(wake_channel, const Fn&, const std::uint32_t value) noexcept { return value; }
+
+    void finish_park(wake_channel) noexcept {}
+
+    bool has_parked(wake_channel) const noexcept { return true; }
+};
+
+// `notify_parked` counts the threads parked on each wake channel, and issues a notification only when there are
+// threads parked on the channel. It saves the system calls for atomic types (e.g. `internal::timed_atomic_uint32_t`)
+// whose notifications always enter the kernel, at the cost of two more atomic operations for each parking.
+class notify_parked
+{
+  public:
+    template <typename Fn>
+    std::uint32_t prepare_park(const wake_channel channel, const Fn& fn, std::uint32_t) noexcept
+    {
+        parked_num_(channel).fetch_add(1, std::memory_order::seq_cst);
+        std::atomic_thread_fence(std::memory_order::seq_cst);
+        // We must try again after the thread is counted. Otherwise, the mutex can be released after our last attempt
+        // but before we are counted, and the releasing thread will not notify us.
+        return fn();
+    }
+
+    void finish_park(const wake_channel channel) noexcept
+    {
+        parked_num_(channel).fetch_sub(1, std::memory_order::relaxed);
+    }
+
+    bool has_parked(const wake_channel channel) const noexcept
+    {
+        // Order the load after the modification of the state of the mutex.
+        std::atomic_thread_fence(std::memory_order::seq_cst);
+        return parked_num_(channel).load(std::memory_order::relaxed) > 0;
+    }
+
+  private:
+    std::atomic<std::uint32_t>& parked_num_(const wake_channel channel) noexcept
+    {
+        return channel == wake_channel::k_readers ? parked_reader_num_ : parked_writer_num_;
+    }
+
+    const std::atomic<std::uint32_t>& parked_num_(const wake_channel channel) const noexcept
+    {
+        return channel == wake_channel::k_readers ? parked_reader_num_ : parked_writer_num_;
+    }
+
+    std::atomic<std::uint32_t> parked_reader_num_{0};
+    std::atomic<std::uint32_t> parked_writer_num_{0};
+};
+
+// The fairness policies decide which kind of threads acquire the mutex first when readers and writers are contending.
+//
+// `writer_preferring` is the default. Readers cannot acquire the mutex when there are writers acquiring or holding it,
+// which gives the best throughput for writers, but readers can be starved by a steady stream of writers.
+struct writer_preferring {};
+
+// `reader_preferring` lets readers acquire the mutex unless a writer is holding it. A reader arriving when a writer is
+// holding the mutex registers itself, and acquires the mutex as soon as the writer releases it. The writers can be
+// starved by a steady stream of readers.
+struct reader_preferring {};
+
+// `phase_fair` alternates reader phases and writer phases. A reader arriving when a writer is waiting for the current
+// readers waits for a writer phase to end, and a reader arriving when a writer is holding the mutex acquires the mutex
+// as soon as the writer releases it. The writer phases are counted by the releases of the exclusive ownership, so the
+// writers arriving or giving up later cannot let the waiting readers join the current reader phase. A waiting reader
+// acquires the mutex after at most two writer phases, so neither readers nor writers can be starved.
+struct phase_fair {};
+
+// The handoff policies decide how a writer releases the mutex when other writers are waiting for it. Each handoff policy
+// provides `k_enabled`, which is false if the mutex is always released to everyone.
+//
+// `no_handoff` is the default. The woken writer competes with the running threads, so a thread calling `try_lock` can
+// steal the mutex before the woken writer is scheduled, and the woken writer is parked again.
+struct no_handoff
+{
+    static constexpr bool k_enabled = false;
+};
+
+// `writer_handoff` hands the exclusive ownership over to one of the writers parked in `lock` directly. A writer blocked
+// by another writer is parked on a ticket, which is advanced when the mutex is handed over or released, so the woken
+// writer owns the mutex without competing. It costs two more atomic operations for each releasing of the exclusive
+// ownership, and nothing for the acquisitions without contention. It only works with `writer_preferring`, and the
+// writers acquiring the mutex with a timeout or a `std::stop_token` are not handed over to.
+class writer_handoff
+{
+  public:
+    static constexpr bool k_enabled = true;
+
+    // Counts the thread as a parked writer and returns the ticket to park with. The thread should check the state of
+    // the mutex again after it is counted.
+    std::uint32_t prepare_park() noexcept
+    {
+        parked_num_.fetch_add(1, std::memory_order::seq_cst);
+        return ticket_.load(std::memory_order::seq_cst);
+    }
+
+    // Parks the thread until the ticket is advanced from `ticket`.
+    void park(const std::uint32_t ticket) noexcept { ticket_.wait(ticket, std::memory_order::acquire); }
+
+    // It is invoked after the thread is woken up, or after the thread stops parking.
+    void finish_park() noexcept { parked_num_.fetch_sub(1, std::memory_order::relaxed); }
+
+    // Returns false only if no writers are parked. It should be invoked after the state of the mutex is modified.
+    bool has_parked() const noexcept
+    {
+        std::atomic_thread_fence(std::memory_order::seq_cst);
+        return parked_num_.load(std::memory_order::relaxed) > 0;
+    }
+
+    // Advances the ticket and wakes up one of the parked writers.
+    void notify_one() noexcept
+    {
+        ticket_.fetch_add(1, std::memory_order::release);
+        ticket_.notify_one();
+    }
+
+  private:
+    std::atomic<std::uint32_t> parked_num_{0};
+    std::atomic<std::uint32_t> ticket_{0};
+};
+
+// The stats policies decide whether the acquisitions and releases of the mutex are recorded. Each stats policy provides:
+// - `k_enabled`, which is false if nothing is recorded;
+// - `now()`, which returns the time point when a thread starts acquiring the mutex;
+// - `on_acquired(channel, start_time, contended)`, which is invoked after a thread acquires the mutex. The ownership is
+//   exclusive if `channel` is `k_writers`, and shared if `channel` is `k_readers`. `contended` is true if the thread
+//   failed in the first attempt;
+// - `on_released(channel)`, which is invoked after a thread releases the mutex;
+// - `on_parked(channel)`, which is invoked before a thread is parked;
+// - `on_timeout(channel)`, which is invoked after a thread fails to acquire the mutex within the timeout.
+//
+// `no_stats` is the default. It takes no space and all the hooks are empty, so it costs nothing.
+struct no_stats
+{
+    static constexpr bool k_enabled = false;
+
+    static std::chrono::steady_clock::time_point now() noexcept { return {}; }
+
+    void on_acquired(wake_channel, std::chrono::steady_clock::time_point, bool) noexcept {}
+
+    void on_released(wake_channel) noexcept {}
+
+    void on_parked(wake_channel) noexcept {}
+
+    void on_timeout(wake_channel) noexcept {}
+};
+
+// The number of buckets of the time histograms recorded by `lock_stats`. The i-th bucket counts the durations which are
+// less than (1 << i) nanoseconds but not less than (1 << (i - 1)) nanoseconds. The last bucket also counts the longer
+// durations.
+inline constexpr std::size_t k_time_histogram_bucket_num = 40;
+
+using time_histogram = std::array<std::uint64_t, k_time_histogram_bucket_num>;
+
+// The snapshot of the stats recorded by `lock_stats`.
+struct lock_stats_snapshot
+{
+    struct ownership_stats
+    {
+        // The number of acquisitions, and the number of acquisitions failed in the first attempt.
+        std::uint64_t acquisition_num_{0};
+        std::uint64_t contended_acquisition_num_{0};
+
+        // The number of times the threads are parked.
+        std::uint64_t park_num_{0};
+
+        // The number of failed acquisitions by `try_lock_for`, `try_lock_until`, `try_lock_shared_for` or
+        // `try_lock_shared_until`.
+        std::uint64_t timeout_num_{0};
+
+        // The wait time of the contended acquisitions.
+        time_histogram wait_time_histogram_{};
+
+        // The hold time of each ownership. It is only recorded for exclusive ownerships since a shared ownership can be
+        // released by another thread.
+        time_histogram hold_time_histogram_{};
+
+        // The total hold time of all ownerships, including the ones being held.
+        std::chrono::nanoseconds hold_time_{0};
+    };
+
+    ownership_stats exclusive_;
+    ownership_stats shared_;
+};
+
+// `lock_stats` records the stats of the mutex. To avoid contention, the stats are recorded on `k_shard_num` shards, and
+// each thread only modifies the shard it is assigned to, like the reader counters of `sharded_shared_mutex`. The
+// `snapshot()` member function aggregates the shards.
+// Each acquisition and release reads the steady clock once, and a contended acquisition reads it once more.
+template <std::size_t k_shard_num = 8>
+class lock_stats
+{
+    static_assert(k_shard_num > 0, "there should be at least one shard");
+
+  public:
+    static constexpr bool k_enabled = true;
+
+    static std::chrono::steady_clock::time_point now() noexcept { return std::chrono::steady_clock::now(); }
+
+    void on_acquired(const wake_channel channel, const std::chrono::steady_clock::time_point start_time,
+            const bool contended) noexcept
+    {
+        auto& counters = this_thread_counters_(channel);
+        const auto acquired_time = contended ? now() : start_time;
+        increase_(counters.acquisition_num_);
+        if (contended) {
+            increase_(counters.contended_acquisition_num_);
+            record_(counters.wait_time_histogram_, acquired_time - start_time);
+        }
+        if (channel == wake_channel::k_writers) {
+            exclusive_acquired_time_.store(to_nanoseconds_(acquired_time), std::memory_order::relaxed);
+        } else {
+            // The hold time of shared ownerships is the sum of the release time points minus the sum of the
+            // acquisition time points. The sums can be overflowed, but the difference is always correct.
+            increase_(counters.hold_time_, -to_nanoseconds_(acquired_time));
+        }
+    }
+
+    void on_released(const wake_channel channel) noexcept
+    {
+        auto& counters = this_thread_counters_(channel);
+        const auto released_time = to_nanoseconds_(now());
+        increase_(counters.release_num_);
+        if (channel == wake_channel::k_writers) {
+            const auto hold_time = released_time - exclusive_acquired_time_.load(std::memory_order::relaxed);
+            record_(counters.hold_time_histogram_, std::chrono::nanoseconds{hold_time});
+            increase_(counters.hold_time_, hold_time);
+        } else {
+            increase_(counters.hold_time_, released_time);
+        }
+    }
+
+    void on_parked(const wake_channel channel) noexcept { increase_(this_thread_counters_(channel).park_num_); }
+
+    void on_timeout(const wake_channel channel) noexcept { increase_(this_thread_counters_(channel).timeout_num_); }
+
+    // Returns the stats aggregated from all the threads. The stats recorded concurrently may be partially observed.
+    lock_stats_snapshot snapshot() const noexcept
+    {
+        lock_stats_snapshot snapshot;
+        const auto now_time = to_nanoseconds_(now());
+        const auto aggregate = [&](lock_stats_snapshot::ownership_stats& stats, const wake_channel channel)
+        {
+            std::uint64_t release_num = 0;
+            std::uint64_t hold_time = 0;
+            for (const auto& shard : shards_) {
+                const auto& counters = shard.counters_[static_cast<std::size_t>(channel)];
+                stats.acquisition_num_ += counters.acquisition_num_.load(std::memory_order::relaxed);
+                stats.contended_acquisition_num_ +=
+                    counters.contended_acquisition_num_.load(std::memory_order::relaxed);
+                stats.park_num_ += counters.park_num_.load(std::memory_order::relaxed);
+                stats.timeout_num_ += counters.timeout_num_.load(std::memory_order::relaxed);
+                release_num += counters.release_num_.load(std::memory_order::relaxed);
+                hold_time += counters.hold_time_.load(std::memory_order::relaxed);
+                for (std::size_t i = 0; i < k_time_histogram_bucket_num; ++i) {
+                    stats.wait_time_histogram_[i] += counters.wait_time_histogram_[i].load(std::memory_order::relaxed);
+                    stats.hold_time_histogram_[i] += counters.hold_time_histogram_[i].load(std::memory_order::relaxed);
+                }
+            }
+            // Count the ownerships being held until now.
+            const auto holding_num = stats.acquisition_num_ - release_num;
+            if (channel == wake_channel::k_writers) {
+                if (holding_num > 0) {
+                    hold_time += now_time - exclusive_acquired_time_.load(std::memory_order::relaxed);
+                }
+            } else {
+                hold_time += holding_num * now_time;
+            }
+            stats.hold_time_ = std::chrono::nanoseconds{static_cast<std::int64_t>(hold_time)};
+        };
+        aggregate(snapshot.exclusive_, wake_channel::k_writers);
+        aggregate(snapshot.shared_, wake_channel::k_readers);
+        return snapshot;
+    }
+
+  private:
+    struct ownership_counters
+    {
+        std::atomic<std::uint64_t> acquisition_num_{0};
+        std::atomic<std::uint64_t> contended_acquisition_num_{0};
+        std::atomic<std::uint64_t> release_num_{0};
+        std::atomic<std::uint64_t> park_num_{0};
+        std::atomic<std::uint64_t> timeout_num_{0};
+        std::atomic<std::uint64_t> hold_time_{0};
+        std::array<std::atomic<std::uint64_t>, k_time_histogram_bucket_num> wait_time_histogram_{};
+        std::array<std::atomic<std::uint64_t>, k_time_histogram_bucket_num> hold_time_histogram_{};
+    };
+
+    // Each shard is aligned to a cache line to avoid false sharing. The counters are indexed by `wake_channel`.
+    struct alignas(internal::k_cache_line_size) shard
+    {
+        std::array<ownership_counters, 2> counters_;
+    };
+
+    static std::uint64_t to_nanoseconds_(const std::chrono::steady_clock::time_point time_point) noexcept
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(time_point.time_since_epoch()).count();
+    }
+
+    // A shard can be shared by several threads, so the counters are increased atomically. The operations are not
+    // contended in most cases.
+    static void increase_(std::atomic<std::uint64_t>& counter, const std::uint64_t value = 1) noexcept
+    {
+        counter.fetch_add(value, std::memory_order::relaxed);
+    }
+
+    static void record_(std::array<std::atomic<std::uint64_t>, k_time_histogram_bucket_num>& histogram,
+            const std::chrono::nanoseconds duration) noexcept
+    {
+        const auto index = std::bit_width(static_cast<std::uint64_t>(std::max<std::int64_t>(duration.count(), 0)));
+        increase_(histogram[std::min<std::size_t>(index, k_time_histogram_bucket_num - 1)]);
+    }
+
+    ownership_counters& this_thread_counters_(const wake_channel channel) noexcept
+    {
+        return shards_[internal::this_thread_slot() % k_shard_num].counters_[static_cast<std::size_t>(channel)];
+    }
+
+    std::array<shard, k_shard_num> shards_;
+
+    // The time point when the exclusive ownership is acquired, which is only modified by the thread holding it.
+    std::atomic<std::uint64_t> exclusive_acquired_time_{0};
+};
+
 namespace internal {
 
+enum class park_result { k_acquired, k_woken, k_timeout };
+
+template <bool k_exclusive>
+struct lock_many_access;
+
+// Parks the thread on `atom` with `current_value` by `park_fn`, and counts the thread on `channel` following the `wake`
+// policy while it is parked. `park_fn` should return false on timeout or cancellation. Returns `k_acquired` if the
+// value returned by `fn` has become 0 before the thread is parked.
+template <typename Fn, typename AtomicUInt32, typename Wake, typename ParkFn>
+park_result park(const Fn& fn, AtomicUInt32& atom, std::uint32_t current_value, Wake& wake,
+        const wake_channel channel, const ParkFn park_fn) noexcept
+{
+    auto result = park_result::k_acquired;
+    if ((current_value = wake.prepare_park(channel, fn, current_value)) > 0) {
+        result = park_fn(atom, current_value) ? park_result::k_woken : park_result::k_timeout;
+    }
+    wake.finish_park(channel);
+    return result;
+}
+
+// Blocks until the value returned by `fn` becomes 0. The thread spins following the `wait` policy before it is parked
+// on `atom`, and is counted on `channel` following the `wake` policy while it is parked. Each parking is recorded on
+// `channel` following the `stats` policy.
+// The value returned by `fn` should be loaded from `atom`.
+template <typename Fn, typename AtomicUInt32, typename Wait = park_wait, typename Wake = notify_always,
+         typename Stats = no_stats>
+void atomic_wait_until_zero(const Fn fn, AtomicUInt32& atom, Wait&& wait = Wait{}, Wake&& wake = Wake{},
+        const wake_channel channel = wake_channel::k_readers, Stats&& stats = Stats{}) noexcept
+{
+    std::uint32_t current_value = 0;
+    while ((current_value = wait.spin(fn, atom)) > 0) {
+        const auto result = park(fn, atom, current_value, wake, channel,
+                [&](AtomicUInt32& atom, const std::uint32_t value)
+                {
+                    stats.on_parked(channel);
+                    atom.wait(value, std::memory_order::acquire);
+                    return true;
+                });
+        if (result == park_result::k_acquired) {
+            return;
+        }
+    }
+}
+
 // The `slontia::internal::shared_mutex` class template is a synchronization primitive that can be used to protect
 // shared data from being simultaneously accessed by multiple threads. In contrast to other mutex types which facilitate
 // exclusive access, a `slontia::internal::shared_mutex` has two levels of access:
@@ -27,22 +568,56 @@ namespace internal {
 // `slontia::internal::shared_mutex` is similar to `std::shared_mutex`, but has the following characteristics:
 // - Concurrent acquisition for shared ownerships can be efficient;
 // - Locking and unlocking in different threads is allowed;
-// - Acquisition for exclusive ownership has higher priority than shared ownership;
+// - Acquisition for exclusive ownership has higher priority than shared ownership by default;
 // - Requirements of `StandardLayoutType` are not satisfied.
-template <typename AtomicUInt32>
+//
+// Besides, `slontia::internal::shared_mutex` supports the upgrade ownership following the semantics of
+// `boost::upgrade_mutex`. The upgrade ownership can be held by at most one thread, and can coexist with shared
+// ownerships. A thread holding the upgrade ownership can upgrade it to the exclusive ownership atomically, so no other
+// writers can lock the mutex in between.
+//
+// The `Layout` policy decides whether the atomic variables share a cache line (`compact_layout`) or are placed in
+// individual cache lines (`padded_layout`). The `Wait` policy decides how long a thread spins before it is parked
+// (`park_wait`, `spin_wait` or `adaptive_spin_wait`). The `Wake` policy decides whether releasing the mutex issues
+// notifications only when there are parked threads (`notify_always` or `notify_parked`). The `Fairness` policy decides
+// whether readers or writers are preferred (`writer_preferring`, `reader_preferring` or `phase_fair`). The `Stats`
+// policy decides whether the acquisitions and releases are recorded (`no_stats` or `lock_stats`). The recorded stats
+// can be retrieved by `stats()`. The upgrade ownership is not recorded, but upgrading to and downgrading from the
+// exclusive ownership are recorded as acquiring and releasing it. The `Handoff` policy decides whether a writer releasing
+// the mutex hands it over to a parked writer (`no_handoff` or `writer_handoff`).
+template <typename AtomicUInt32, typename Layout = compact_layout, typename Wait = spin_wait<>,
+         typename Wake = notify_always, typename Fairness = writer_preferring, typename Stats = no_stats,
+         typename Handoff = no_handoff>
 class shared_mutex
 {
+    static_assert(!Handoff::k_enabled || std::is_same_v<Fairness, writer_preferring>,
+            "the exclusive ownership can only be handed over when writers are preferred");
+
+    template <bool k_exclusive>
+    friend struct lock_many_access;
+
   public:
     // Acquires an exclusive ownership of the `shared_mutex`. If another thread is holding an exclusive lock or a shared
     // lock on the same `shared_mutex` the a call to lock will block execution until all such locks are released. While
     // `shared_mutex` is locked in an exclusive mode, no other lock of any kind can also be held.
     void lock() noexcept
     {
+        const auto start_time = stats_.now();
+
         // Ensure that no readers can hold shared ownerships anymore.
         increase_writing_num_();
 
         // Acquire an exclusive ownership.
-        atomic_wait_until_zero([this] { return try_set_writing_state_to_holding_num_(); }, holding_num_);
+        if constexpr (Handoff::k_enabled) {
+            const bool contended = try_set_writing_state_to_holding_num_() > 0;
+            if (contended) {
+                wait_until_locked_or_handed_over_();
+            }
+            stats_.on_acquired(wake_channel::k_writers, start_time, contended);
+        } else {
+            wait_until_acquired_([this] { return try_set_writing_state_to_holding_num_(); }, holding_num_,
+                    wake_channel::k_writers, start_time);
+        }
     }
 
     // Tries to lock the mutex. Returns immediately. On successful lock acquisition returns true, otherwise returns
@@ -58,58 +633,269 @@ class shared_mutex
             decrease_writing_num_();
             return false;
         }
+        stats_.on_acquired(wake_channel::k_writers, stats_.now(), false);
         return true;
     }
 
-    // Unlocks the mutex.
+    // Unlocks the mutex. If the `Handoff` policy is enabled and some writers are parked, the exclusive ownership is
+    // handed over to one of them.
     // The mutex must be locked by a thread. The thread need not be the current thread of execution.
     void unlock() noexcept
     {
+        stats_.on_released(wake_channel::k_writers);
+
+        if constexpr (Handoff::k_enabled) {
+            if (handoff_.has_parked()) {
+                // Keep `k_writing_state` so that no running threads can steal the mutex, and mark that it is being
+                // handed over. The readers are still blocked by the parked writer we hand over to.
+                holding_num_.fetch_or(k_handoff_state, std::memory_order::release);
+                decrease_writing_num_();
+                handoff_.notify_one();
+                return;
+            }
+        }
+
         // We should subtract `k_writing_state` from `holding_num_` rather than set zero to `holding_num_` directly.
         // The reason is that some readers can temporarily increase `holding_num_` to a higher value. If we set zero to
         // `holding_num_` here, the value of `holding_num_` will be caused downward overflow by there readers.
-        holding_num_.fetch_sub(k_writing_state, std::memory_order::release);
+        release_writing_state_(k_writing_state);
 
         // Notify all waiting readers if there are no waiting writers.
-        if (!decrease_writing_num_()) {
+        if (!decrease_writing_num_(true) && wake_.has_parked(wake_channel::k_writers)) {
             // There are some waiting writers, so we notify one of them.
             holding_num_.notify_one();
         }
     }
 
+    // Atomically downgrades the exclusive ownership to a shared ownership. Unlike calling `unlock` and `lock_shared`
+    // in turn, no other writers can lock the mutex in between.
+    // The mutex must be locked by a thread in exclusive mode. The thread need not be the current thread of execution.
+    void unlock_and_lock_shared() noexcept
+    {
+        stats_.on_released(wake_channel::k_writers);
+        stats_.on_acquired(wake_channel::k_readers, stats_.now(), false);
+        release_writing_state_(k_writing_state - 1);
+        // The waiting writers cannot lock the mutex until the shared ownership is released, so we only have to notify
+        // the waiting readers.
+        decrease_writing_num_(true);
+    }
+
     // Acquires shared ownership of the mutex. If another thread is acquiring or holding the mutex in exclusive
     // ownership, a call to `lock_shared_base` will block execution until shared ownership can be acquired.
-    void lock_shared() noexcept
+    void lock_shared() noexcept { lock_shared(1); }
+
+    // Acquires `reader_num` shared ownerships of the mutex at once with one atomic operation, e.g. on behalf of
+    // `reader_num` sub-tasks. The ownerships can be released together by `unlock_shared(reader_num)`, or separately by
+    // `unlock_shared()`, and the releasing threads need not be the current thread of execution.
+    // `reader_num` should be greater than 0, and the stats policy records `reader_num` acquisitions.
+    void lock_shared(const std::uint32_t reader_num) noexcept
     {
-        atomic_wait_until_zero([this] { return try_lock_shared_internal_(); }, writing_num_);
+        const auto start_time = stats_.now();
+        if constexpr (std::is_same_v<Fairness, writer_preferring>) {
+            wait_until_acquired_([this, reader_num] { return try_lock_shared_internal_(reader_num); }, writing_num_,
+                    wake_channel::k_readers, start_time, reader_num);
+        } else if constexpr (std::is_same_v<Fairness, phase_fair>) {
+            // Load the writer phase before trying, so a writer phase ending after our attempt is never missed.
+            const auto writer_phase = writer_phase_.load(std::memory_order::acquire);
+            if (try_lock_shared_internal_(reader_num) == 0) {
+                on_acquired_(wake_channel::k_readers, start_time, false, reader_num);
+                return;
+            }
+            atomic_wait_until_zero([this, writer_phase] { return waiting_writer_phase_(writer_phase); },
+                    writer_phase_, wait_, wake_, wake_channel::k_readers, stats_);
+            register_reader_(reader_num);
+            atomic_wait_until_zero([this] { return holding_writer_phase_(); }, holding_num_, wait_, wake_,
+                    wake_channel::k_readers, stats_);
+            on_acquired_(wake_channel::k_readers, start_time, true, reader_num);
+        } else {
+            register_reader_(reader_num);
+            wait_until_acquired_([this] { return holding_writer_phase_(); }, holding_num_, wake_channel::k_readers,
+                    start_time, reader_num);
+        }
     }
 
     // Tries to lock the mutex in shared mode. Returns immediately. On successful lock acquisition returns true,
     // otherwise returns false.
-    bool try_lock_shared() noexcept { return try_lock_shared_internal_() == 0; }
+    bool try_lock_shared() noexcept { return try_lock_shared(1); }
+
+    // Tries to acquire `reader_num` shared ownerships of the mutex at once as `lock_shared(reader_num)`. Returns
+    // immediately. On successful lock acquisition returns true, otherwise returns false and no ownerships are held.
+    bool try_lock_shared(const std::uint32_t reader_num) noexcept
+    {
+        if constexpr (std::is_same_v<Fairness, reader_preferring>) {
+            auto holding_num = holding_num_.load(std::memory_order::relaxed);
+            do {
+                if (holding_num & k_writing_state) {
+                    return false;
+                }
+            } while (!holding_num_.compare_exchange_weak(holding_num, holding_num + reader_num,
+                        std::memory_order::acquire, std::memory_order::relaxed));
+        } else if (try_lock_shared_internal_(reader_num) > 0) {
+            return false;
+        }
+        on_acquired_(wake_channel::k_readers, stats_.now(), false, reader_num);
+        return true;
+    }
+
+    // Acquires `reader_num` more shared ownerships of the mutex, which never blocks since writers cannot acquire the
+    // mutex until all the shared ownerships are released. It is cheaper than `lock_shared`, which would be blocked by
+    // the waiting writers and may deadlock with them.
+    // The mutex must be locked by the current thread of execution in shared mode.
+    void add_shared(const std::uint32_t reader_num = 1) noexcept
+    {
+        holding_num_.fetch_add(reader_num, std::memory_order::relaxed);
+        on_acquired_(wake_channel::k_readers, stats_.now(), false, reader_num);
+    }
 
     // Releases the mutex from shared ownership by the calling thread.
     // The mutex must be locked by a thread in shared mode. The thread need not be the current thread of execution.
-    void unlock_shared() noexcept
+    void unlock_shared() noexcept { unlock_shared(1); }
+
+    // Releases `reader_num` shared ownerships of the mutex at once with one atomic operation.
+    // The mutex must be locked in shared mode for at least `reader_num` times. The threads need not be the current
+    // thread of execution.
+    void unlock_shared(const std::uint32_t reader_num) noexcept
     {
-        if (holding_num_.fetch_sub(1, std::memory_order::release) == 1 &&
-                writing_num_.load(std::memory_order::release) > 0) {
-            holding_num_.notify_one();
+        for (std::uint32_t i = 0; i < reader_num && Stats::k_enabled; ++i) {
+            stats_.on_released(wake_channel::k_readers);
+        }
+        unlock_shared_internal_(reader_num);
+    }
+
+    // Acquires the upgrade ownership of the mutex. If another thread is acquiring or holding the mutex in exclusive
+    // ownership, or holding the upgrade ownership, a call to `lock_upgrade` will block execution until the upgrade
+    // ownership can be acquired.
+    void lock_upgrade() noexcept
+    {
+        while (!try_lock_upgrade()) {
+            // Wait until there are no writers, as readers do.
+            atomic_wait_until_zero([this] { return writing_num_.load(std::memory_order::acquire); }, writing_num_,
+                    wait_, wake_, wake_channel::k_readers);
+            // Wait until the upgrade ownership is released by another thread.
+            atomic_wait_until_zero(
+                    [this]
+                    {
+                        const auto holding_num = holding_num_.load(std::memory_order::acquire);
+                        return (holding_num & k_upgrading_state) ? holding_num : 0;
+                    },
+                    holding_num_, wait_, wake_, wake_channel::k_writers);
+        }
+    }
+
+    // Tries to lock the mutex in upgrade mode. Returns immediately. On successful lock acquisition returns true,
+    // otherwise returns false.
+    bool try_lock_upgrade() noexcept
+    {
+        // Writers have higher priority than upgraders.
+        if (writing_num_.load(std::memory_order::acquire) > 0) {
+            return false;
+        }
+        auto holding_num = holding_num_.load(std::memory_order::relaxed);
+        do {
+            if (holding_num & (k_writing_state | k_upgrading_state)) {
+                return false;
+            }
+        } while (!holding_num_.compare_exchange_weak(holding_num, holding_num | k_upgrading_state,
+                    std::memory_order::acquire, std::memory_order::relaxed));
+        // Check the value of `writing_num_` again for the same reason as `try_lock_shared_internal_`.
+        if (writing_num_.load(std::memory_order::acquire) > 0) [[unlikely]] {
+            unlock_upgrade();
+            return false;
+        }
+        return true;
+    }
+
+    // Releases the upgrade ownership of the mutex.
+    // The mutex must be locked by a thread in upgrade mode. The thread need not be the current thread of execution.
+    void unlock_upgrade() noexcept
+    {
+        holding_num_.fetch_sub(k_upgrading_state, std::memory_order::release);
+        // Both the writers and the threads acquiring the upgrade ownership are parked on `holding_num_`, so we notify
+        // all of them.
+        if (wake_.has_parked(wake_channel::k_writers)) {
+            holding_num_.notify_all();
         }
     }
 
+    // Atomically upgrades the upgrade ownership to the exclusive ownership. Blocks until all the shared ownerships are
+    // released. Since the upgrade ownership is held, no other writers can lock the mutex in between.
+    // The mutex must be locked by a thread in upgrade mode. The thread need not be the current thread of execution.
+    void unlock_upgrade_and_lock() noexcept
+    {
+        const auto start_time = stats_.now();
+
+        // Ensure that no readers can hold shared ownerships anymore.
+        increase_writing_num_();
+
+        wait_until_acquired_([this] { return try_set_upgrading_state_to_writing_state_(); }, holding_num_,
+                wake_channel::k_writers, start_time);
+    }
+
+    // Tries to upgrade the upgrade ownership to the exclusive ownership. Returns immediately. On successful upgrade
+    // returns true, otherwise returns false and the upgrade ownership is still held.
+    bool try_unlock_upgrade_and_lock() noexcept
+    {
+        increase_writing_num_();
+        if (try_set_upgrading_state_to_writing_state_() > 0) {
+            decrease_writing_num_();
+            return false;
+        }
+        stats_.on_acquired(wake_channel::k_writers, stats_.now(), false);
+        return true;
+    }
+
+    // Atomically downgrades the exclusive ownership to the upgrade ownership.
+    // The mutex must be locked by a thread in exclusive mode. The thread need not be the current thread of execution.
+    void unlock_and_lock_upgrade() noexcept
+    {
+        stats_.on_released(wake_channel::k_writers);
+        release_writing_state_(k_writing_state - k_upgrading_state);
+        // The waiting writers cannot lock the mutex until the upgrade ownership is released, so we only have to notify
+        // the waiting readers.
+        decrease_writing_num_(true);
+    }
+
+    // Atomically downgrades the upgrade ownership to a shared ownership.
+    // The mutex must be locked by a thread in upgrade mode. The thread need not be the current thread of execution.
+    void unlock_upgrade_and_lock_shared() noexcept
+    {
+        stats_.on_acquired(wake_channel::k_readers, stats_.now(), false);
+        holding_num_.fetch_sub(k_upgrading_state - 1, std::memory_order::release);
+        // Notify the threads acquiring the upgrade ownership.
+        if (wake_.has_parked(wake_channel::k_writers)) {
+            holding_num_.notify_all();
+        }
+    }
+
+    // Returns the snapshot of the stats recorded by the `Stats` policy.
+    auto stats() const noexcept requires Stats::k_enabled { return stats_.snapshot(); }
+
   protected:
     void increase_writing_num_() noexcept { writing_num_.fetch_add(1, std::memory_order::acquire); }
 
-    // Notify all waiting readers if there are no waiting writers.
+    // Notify all waiting readers if there are no waiting writers. `released` should be true if the caller has just
+    // released the exclusive ownership.
     // We can only decrease `writing_num_` by invoking this function. Otherwise, threads acquiring shared ownerships can
     // be blocked infinitly.
-    bool decrease_writing_num_() noexcept
+    bool decrease_writing_num_(const bool released = false) noexcept
     {
-        if (writing_num_.fetch_sub(1, std::memory_order::release) == 1) {
+        const bool no_writers = writing_num_.fetch_sub(1, std::memory_order::release) == 1;
+        if constexpr (std::is_same_v<Fairness, phase_fair>) {
+            // The writer phase ends when the writer releases the mutex, or when the last writer gives up acquiring it.
+            // The readers waiting for the writer phase to end can go on, even if there are other waiting writers.
+            if (released || no_writers) {
+                writer_phase_.fetch_add(k_writer_phase_step, std::memory_order::release);
+                if (wake_.has_parked(wake_channel::k_readers)) {
+                    writer_phase_.notify_all();
+                }
+            }
+        }
+        if (no_writers) {
             // Now, there are no threads acquiring exclusive ownerships. We can notify all threads acquiring shared
             // ownerships.
-            writing_num_.notify_all();
+            if (wake_.has_parked(wake_channel::k_readers)) {
+                writing_num_.notify_all();
+            }
             return true;
         }
         return false;
@@ -126,49 +912,207 @@ class shared_mutex
         return holding_num;
     }
 
-    // Increase `holding_num_` by 1 if the value of `writing_num` is 0.
+    // Set `k_writing_state` to `holding_num_` if the value of `holding_num_` is `k_upgrading_state`, i.e. only the
+    // upgrade ownership is held.
+    // Return 0 if we upgrade successfully, otherwise the current value of `holding_num_`.
+    std::uint32_t try_set_upgrading_state_to_writing_state_() noexcept
+    {
+        std::uint32_t holding_num = k_upgrading_state;
+        return holding_num_.compare_exchange_strong(holding_num, k_writing_state, std::memory_order::acquire) ?
+            0 : holding_num;
+    }
+
+    // Increase `holding_num_` by `reader_num` if the value of `writing_num` is 0.
     // Return the current value of `writing_num_`. The value of 0 indicates we lock in shared mode successfully.
-    std::uint32_t try_lock_shared_internal_() noexcept
+    std::uint32_t try_lock_shared_internal_(const std::uint32_t reader_num = 1) noexcept
     {
         auto writing_num = writing_num_.load(std::memory_order::acquire);
         // Writers have higher priority than readers. Readers can hold the mutex in shared mode only when there are no
         // waiting writeres.
         if (writing_num == 0) {
-            holding_num_.fetch_add(1, std::memory_order::acquire);
+            holding_num_.fetch_add(reader_num, std::memory_order::acquire);
             // No more writers can lock the mutex since we have increased the `holding_num_`.
             // However, there can be some threads which had increased `writing_num_` before we increased `holding_num_`,
             // so we must check the value of `writing_num_` again. Otherwise, a reader and a writer can both hold the
             // mutex unexpectedly.
             if ((writing_num = writing_num_.load(std::memory_order::acquire)) > 0) [[unlikely]] {
-                unlock_shared();
+                unlock_shared_internal_(reader_num);
             }
         }
         return writing_num;
     }
 
+    // Releases `reader_num` shared ownerships without recording them following the `Stats` policy.
+    void unlock_shared_internal_(const std::uint32_t reader_num = 1) noexcept
+    {
+        const auto holding_num = holding_num_.fetch_sub(reader_num, std::memory_order::release) - reader_num;
+        if ((holding_num == 0 || holding_num == k_upgrading_state) &&
+                writing_num_.load(std::memory_order::seq_cst) > 0 && wake_.has_parked(wake_channel::k_writers)) {
+            if (holding_num == 0) {
+                holding_num_.notify_one();
+            } else {
+                // The thread holding the upgrade ownership may be waiting to upgrade, and it is parked together with
+                // other writers, so we notify all of them.
+                holding_num_.notify_all();
+            }
+        }
+    }
+
+    // Records `acquisition_num` acquisitions on `channel` following the `Stats` policy.
+    void on_acquired_(const wake_channel channel, const std::chrono::steady_clock::time_point start_time,
+            const bool contended, const std::uint32_t acquisition_num) noexcept
+    {
+        for (std::uint32_t i = 0; i < acquisition_num && Stats::k_enabled; ++i) {
+            stats_.on_acquired(channel, start_time, contended);
+        }
+    }
+
+    // Blocks until the value returned by `fn` becomes 0 by `atomic_wait_until_zero`, and records `acquisition_num`
+    // acquisitions on `channel` following the `Stats` policy.
+    void wait_until_acquired_(const auto fn, AtomicUInt32& atom, const wake_channel channel,
+            const std::chrono::steady_clock::time_point start_time, const std::uint32_t acquisition_num = 1) noexcept
+    {
+        if constexpr (Stats::k_enabled) {
+            const bool contended = fn() > 0;
+            if (contended) {
+                atomic_wait_until_zero(fn, atom, wait_, wake_, channel, stats_);
+            }
+            on_acquired_(channel, start_time, contended, acquisition_num);
+        } else {
+            atomic_wait_until_zero(fn, atom, wait_, wake_, channel);
+        }
+    }
+
+    // Blocks until the exclusive ownership is acquired. While another writer is holding the mutex, the thread is parked
+    // following the `Handoff` policy, and takes over the mutex once it is handed over. Otherwise, the thread competes
+    // for the mutex released by the readers or the upgrader as `lock` does without handoff.
+    void wait_until_locked_or_handed_over_() noexcept
+    {
+        for (;;) {
+            auto holding_num = holding_num_.load(std::memory_order::acquire);
+            if (!(holding_num & k_writing_state)) {
+                // Stop waiting once another writer locks the mutex, so that it can hand the mutex over to us.
+                bool locked = false;
+                atomic_wait_until_zero(
+                        [&]
+                        {
+                            const auto holding_num = try_set_writing_state_to_holding_num_();
+                            locked = holding_num == 0;
+                            return (holding_num & k_writing_state) ? 0 : holding_num;
+                        },
+                        holding_num_, wait_, wake_, wake_channel::k_writers, stats_);
+                if (locked) {
+                    return;
+                }
+            } else if (holding_num & k_handoff_state) {
+                // Take over the mutex handed over to the parked writers. A reader may have increased `holding_num_`
+                // temporarily, so we retry on failure.
+                if (holding_num_.compare_exchange_weak(holding_num, holding_num & ~k_handoff_state,
+                            std::memory_order::acquire, std::memory_order::relaxed)) {
+                    return;
+                }
+            } else {
+                const auto ticket = handoff_.prepare_park();
+                // The sequentially-consistent ordering guarantees that either the writer releasing the mutex observes
+                // that we are parked, or we observe the release here. The ticket has been loaded before, so the
+                // advance of the ticket after the check can never be missed.
+                holding_num = holding_num_.load(std::memory_order::seq_cst);
+                if ((holding_num & k_writing_state) && !(holding_num & k_handoff_state)) {
+                    stats_.on_parked(wake_channel::k_writers);
+                    handoff_.park(ticket);
+                }
+                handoff_.finish_park();
+            }
+        }
+    }
+
+    // Subtract `value` from `holding_num_` to clear `k_writing_state` when a writer releases the mutex.
+    void release_writing_state_(const std::uint32_t value) noexcept
+    {
+        const auto holding_num = holding_num_.fetch_sub(value, std::memory_order::release);
+        if constexpr (Handoff::k_enabled) {
+            // The writers parked following the `Handoff` policy compete for the released mutex.
+            if (handoff_.has_parked()) {
+                handoff_.notify_one();
+            }
+        }
+        if constexpr (!std::is_same_v<Fairness, writer_preferring>) {
+            // Notify the readers registered while the writer was holding the mutex.
+            if ((holding_num & ~(k_writing_state | k_upgrading_state)) > 0 &&
+                    wake_.has_parked(wake_channel::k_readers)) {
+                holding_num_.notify_all();
+            }
+        }
+    }
+
+    // Increase `holding_num_` by `reader_num` regardless of the writers. If no writer is holding the mutex, we lock in
+    // shared mode successfully. Otherwise, we should wait with `holding_writer_phase_` until the writer releases the
+    // mutex, and no other writers can lock the mutex before we release it.
+    void register_reader_(const std::uint32_t reader_num = 1) noexcept
+    {
+        holding_num_.fetch_add(reader_num, std::memory_order::acquire);
+    }
+
+    // Return the current value of `holding_num_` if a writer is holding the mutex, otherwise 0. It is invoked by a
+    // registered reader, which locks in shared mode successfully when the value of 0 is returned.
+    // No other writers can set `k_writing_state` again since we are registered, so the registered reader parked on
+    // `holding_num_` can never miss the release of the writer.
+    std::uint32_t holding_writer_phase_() const noexcept
+    {
+        const auto holding_num = holding_num_.load(std::memory_order::acquire);
+        return (holding_num & k_writing_state) ? holding_num : 0;
+    }
+
+    // Return the current value of `writer_phase_` if it is still `writer_phase`, some writers are acquiring the mutex
+    // and no writer is holding it, otherwise 0. It is invoked by a reader which has observed waiting writers to wait for
+    // the writer phase to end. Once a writer is holding the mutex, the reader registers itself and acquires the mutex as
+    // soon as the writer releases it.
+    // `writer_phase_` is only advanced when a writer phase ends, so the writers arriving or giving up while the last
+    // writer phase is not finished can never wake the reader up.
+    std::uint32_t waiting_writer_phase_(const std::uint32_t writer_phase) const noexcept
+    {
+        const auto current_writer_phase = writer_phase_.load(std::memory_order::acquire);
+        return (current_writer_phase == writer_phase && writing_num_.load(std::memory_order::acquire) > 0 &&
+                !(holding_num_.load(std::memory_order::acquire) & k_writing_state)) ? current_writer_phase : 0;
+    }
+
+    // Takes the place of `writer_phase_` when the fairness policy is not `phase_fair`.
+    struct no_writer_phase
+    {
+        constexpr explicit no_writer_phase(std::uint32_t) noexcept {}
+    };
+
     // The number of threads that are acquiring the mutex for exclusive ownership.
-    AtomicUInt32 writing_num_{0};
+    alignas(Layout::template alignment<AtomicUInt32>) AtomicUInt32 writing_num_{0};
 
     // The number of threads that are holding the mutex for shared ownership.
-    // Besides, if the mutex is being locked for exclusive ownership, the value will be equal or greater than
-    // `k_writing_state`.
-    AtomicUInt32 holding_num_{0};
+    // Besides, if the mutex is being locked for exclusive ownership, the bit of `k_writing_state` is set, and if the
+    // upgrade ownership is being held, the bit of `k_upgrading_state` is set. If the exclusive ownership is being handed
+    // over to a parked writer, the bit of `k_handoff_state` is set together with `k_writing_state`.
+    alignas(Layout::template alignment<AtomicUInt32>) AtomicUInt32 holding_num_{0};
+
+    // The counter of the writer phases, on which the readers waiting for a writer phase to end are parked. It is only
+    // kept with `phase_fair`.
+    [[no_unique_address]] std::conditional_t<std::is_same_v<Fairness, phase_fair>, AtomicUInt32, no_writer_phase>
+        writer_phase_{1};
+
+    // The states of the wait policy, the wake policy, the stats policy and the handoff policy, which take no space if
+    // the policies are stateless.
+    [[no_unique_address]] Wait wait_;
+    [[no_unique_address]] Wake wake_;
+    [[no_unique_address]] Stats stats_;
+    [[no_unique_address]] Handoff handoff_;
 
   private:
-    // We assume that the number of readers acquiring the mutex concurrently should be less than (1 << 31). Otherwise,
+    // We assume that the number of readers acquiring the mutex concurrently should be less than (1 << 29). Otherwise,
     // the mutex will behave unexpectedly.
-    static constexpr std::uint32_t k_writing_state = (1 << 31);
+    static constexpr std::uint32_t k_writing_state = (1u << 31);
+    static constexpr std::uint32_t k_upgrading_state = (1u << 30);
+    static constexpr std::uint32_t k_handoff_state = (1u << 29);
 
-    // Blocks until the value returned by `fn` becomes 0.
-    // The value returned by `fn` should be loaded from `atom`.
-    template <typename Fn>
-    static void atomic_wait_until_zero(const Fn fn, AtomicUInt32& atom) noexcept
-    {
-        std::uint32_t current_value = 0;
-        while ((current_value = fn()) > 0) {
-            atom.wait(current_value, std::memory_order::acquire);
-        }
-    }
+    // The writer phase is advanced by `k_writer_phase_step` from an odd value, so it never becomes 0, which indicates
+    // that the waiting reader can go on.
+    static constexpr std::uint32_t k_writer_phase_step = 2;
 };
 
 // The `slontia::internal::shared_timed_mutex` class template is a synchronization primitive that can be used to protect
@@ -181,19 +1125,89 @@ class shared_mutex
 // characteristics:
 // - Concurrent acquisition for shared ownerships can be efficient;
 // - Locking and unlocking in different threads is allowed;
-// - Acquisition for exclusive ownership has higher priority than shared ownership;
+// - Acquisition for exclusive ownership has higher priority than shared ownership by default;
 // - Requirements of `StandardLayoutType` are not satisfied.
-template <typename AtomicUInt32>
-class shared_timed_mutex : public shared_mutex<AtomicUInt32>
+//
+// The policies are the same as `slontia::internal::shared_mutex`. Besides, the stats policy records the acquisitions
+// failed within the timeout or cancelled by a `std::stop_token` as timeouts.
+template <typename AtomicUInt32, typename Layout = compact_layout, typename Wait = spin_wait<>,
+         typename Wake = notify_always, typename Fairness = writer_preferring, typename Stats = no_stats,
+         typename Handoff = no_handoff>
+class shared_timed_mutex : public shared_mutex<AtomicUInt32, Layout, Wait, Wake, Fairness, Stats, Handoff>
 {
   public:
+    using shared_mutex<AtomicUInt32, Layout, Wait, Wake, Fairness, Stats, Handoff>::lock;
+    using shared_mutex<AtomicUInt32, Layout, Wait, Wake, Fairness, Stats, Handoff>::lock_shared;
+
+    // Acquires an exclusive ownership of the mutex as `lock`, but gives up once a stop is requested on `stop_token`.
+    // The thread parked on the mutex is woken up by the stop request. On successful lock acquisition returns true,
+    // otherwise returns false.
+    bool lock(const std::stop_token& stop_token) noexcept
+    {
+        const auto start_time = stats_.now();
+
+        // Ensure that no readers can hold shared ownerships anymore.
+        this->increase_writing_num_();
+
+        // Try to acquire an exclusive ownership.
+        if (!wait_until_acquired_or_stopped_([this] { return try_set_writing_state_to_holding_num_(); },
+                    holding_num_, wake_channel::k_writers, start_time, stop_token)) {
+            // Give up the acquisition, and let the readers blocked by us go on.
+            this->decrease_writing_num_();
+            return false;
+        }
+        return true;
+    }
+
+    // Acquires shared ownership of the mutex as `lock_shared`, but gives up once a stop is requested on `stop_token`.
+    // The thread parked on the mutex is woken up by the stop request. On successful lock acquisition returns true,
+    // otherwise returns false.
+    bool lock_shared(const std::stop_token& stop_token) noexcept
+    {
+        const auto start_time = stats_.now();
+        if constexpr (std::is_same_v<Fairness, writer_preferring>) {
+            return wait_until_acquired_or_stopped_([this] { return try_lock_shared_internal_(); }, writing_num_,
+                    wake_channel::k_readers, start_time, stop_token);
+        } else {
+            auto contended = true;
+            if constexpr (std::is_same_v<Fairness, phase_fair>) {
+                const auto writer_phase = writer_phase_.load(std::memory_order::acquire);
+                if (try_lock_shared_internal_() == 0) {
+                    stats_.on_acquired(wake_channel::k_readers, start_time, false);
+                    return true;
+                }
+                if (!atomic_wait_until_zero_or_stopped_(
+                            [this, writer_phase] { return waiting_writer_phase_(writer_phase); }, writer_phase_,
+                            wake_channel::k_readers, stop_token)) {
+                    stats_.on_timeout(wake_channel::k_readers);
+                    return false;
+                }
+                register_reader_();
+            } else {
+                register_reader_();
+                contended = holding_writer_phase_() > 0;
+            }
+            if (contended && !atomic_wait_until_zero_or_stopped_([this] { return holding_writer_phase_(); },
+                        holding_num_, wake_channel::k_readers, stop_token)) {
+                // Cancel the registration, as `try_lock_shared_for` does on timeout.
+                this->unlock_shared_internal_();
+                stats_.on_timeout(wake_channel::k_readers);
+                return false;
+            }
+            stats_.on_acquired(wake_channel::k_readers, start_time, contended);
+            return true;
+        }
+    }
+
     // Tries to lock the mutex. Blocks until the specified duration `timeout_duration` has elapsed (timeout) or the lock
     // is acquired (owns the mutex), whichever comes first. On successful lock acquisition returns true, otherwise
     // returns false.
+    // The duration is converted to a `slontia::deadline` once, so it is not renewed when the thread is woken up
+    // without acquiring the mutex.
     template <typename Rep, class Period>
     bool try_lock_for(const std::chrono::duration<Rep, Period>& timeout_duration) noexcept
     {
-        return try_lock_timeout_(timeout_duration);
+        return try_lock_until(slontia::deadline{timeout_duration});
     }
 
     // Tries to lock the mutex. Blocks until specified `timeout_time` has been reached (timeout) or the lock is acquired
@@ -204,12 +1218,16 @@ class shared_timed_mutex : public shared_mutex<AtomicUInt32>
         return try_lock_timeout_(timeout_time);
     }
 
+    // Tries to lock the mutex until `deadline` has been reached as `try_lock_until`. The time point of `deadline` is
+    // waited with directly, so several acquisitions can share one time budget.
+    bool try_lock_until(const slontia::deadline& deadline) noexcept { return try_lock_timeout_(deadline.at()); }
+
     // Tries to lock the mutex in shared mode. Blocks until specified `timeout_duration` has elapsed or the shared lock
     // is acquired, whichever comes first. On successful lock acquisition returns true, otherwise returns false.
     template <typename Rep, class Period>
     bool try_lock_shared_for(const std::chrono::duration<Rep, Period>& timeout_duration) noexcept
     {
-        return try_lock_shared_timeout_(timeout_duration);
+        return try_lock_shared_until(slontia::deadline{timeout_duration});
     }
 
     // Tries to lock the mutex in shared mode. Blocks until specified `timeout_time` has been reached or the lock is
@@ -220,21 +1238,32 @@ class shared_timed_mutex : public shared_mutex<AtomicUInt32>
         return try_lock_shared_timeout_(timeout_time);
     }
 
-  private:
-    using shared_mutex<AtomicUInt32>::try_set_writing_state_to_holding_num_;
-    using shared_mutex<AtomicUInt32>::try_lock_shared_internal_;
-    using shared_mutex<AtomicUInt32>::writing_num_;
-    using shared_mutex<AtomicUInt32>::holding_num_;
-
-    template <typename Rep, typename Period>
-    static bool atomic_wait_timeout_(
-            AtomicUInt32& atom,
-            const std::uint32_t expected_value,
-            const std::chrono::duration<Rep, Period>& timeout_duration) noexcept
+    // Tries to lock the mutex in shared mode until `deadline` has been reached as `try_lock_shared_until`.
+    bool try_lock_shared_until(const slontia::deadline& deadline) noexcept
     {
-        return atom.wait_for(expected_value, timeout_duration, std::memory_order::acquire);
+        return try_lock_shared_timeout_(deadline.at());
     }
 
+  protected:
+    using shared_mutex_base = shared_mutex<AtomicUInt32, Layout, Wait, Wake, Fairness, Stats, Handoff>;
+
+    using shared_mutex_base::try_set_writing_state_to_holding_num_;
+    using shared_mutex_base::try_lock_shared_internal_;
+    using shared_mutex_base::register_reader_;
+    using shared_mutex_base::holding_writer_phase_;
+    using shared_mutex_base::waiting_writer_phase_;
+    using shared_mutex_base::writer_phase_;
+    using shared_mutex_base::writing_num_;
+    using shared_mutex_base::holding_num_;
+    using shared_mutex_base::wait_;
+    using shared_mutex_base::wake_;
+    using shared_mutex_base::stats_;
+
+  private:
+    // The longest time for which a thread acquiring the mutex with a `std::stop_token` is parked before checking the
+    // stop request again. It only bounds the delay of a stop request issued just before the thread is parked.
+    static constexpr auto k_stop_check_period = std::chrono::milliseconds(10);
+
     template <typename Clock, typename Duration>
     static bool atomic_wait_timeout_(
         AtomicUInt32& atom,
@@ -244,29 +1273,106 @@ class shared_timed_mutex : public shared_mutex<AtomicUInt32>
         return atom.wait_until(expected_value, timeout_time, std::memory_order::acquire);
     }
 
-    // Blocks until specified `timeout` has elapsed or been reached or the value returned by `fn` becomes 0.
+    // Blocks until specified `timeout` has been reached or the value returned by `fn` becomes 0. The thread
+    // spins following the wait policy before it is parked on `atom`, and is counted on `channel` following the wake
+    // policy while it is parked. Each parking is recorded on `channel` following the stats policy.
     // The value returned by `fn` should be loaded from `atom`.
-    static bool atomic_wait_until_zero_with_timeout_(
-            const auto fn, AtomicUInt32& atom, const auto& timeout) noexcept
+    bool atomic_wait_until_zero_with_timeout_(
+            const auto fn, AtomicUInt32& atom, const auto& timeout, const wake_channel channel) noexcept
     {
         std::uint32_t current_value = 0;
-        while ((current_value = fn()) > 0) {
-            if (!atomic_wait_timeout_(atom, current_value, timeout)) {
+        while ((current_value = wait_.spin(fn, atom)) > 0) {
+            const auto result = park(fn, atom, current_value, wake_, channel,
+                    [&](AtomicUInt32& atom, const std::uint32_t value)
+                    {
+                        stats_.on_parked(channel);
+                        return atomic_wait_timeout_(atom, value, timeout);
+                    });
+            if (result != park_result::k_woken) {
+                return result == park_result::k_acquired;
+            }
+        }
+        return true;
+    }
+
+    // The same as `atomic_wait_until_zero_with_timeout_`, and records the acquisition or the timeout on `channel`
+    // following the stats policy.
+    bool wait_until_acquired_with_timeout_(const auto fn, AtomicUInt32& atom, const auto& timeout,
+            const wake_channel channel, const std::chrono::steady_clock::time_point start_time) noexcept
+    {
+        if constexpr (Stats::k_enabled) {
+            const bool contended = fn() > 0;
+            if (contended && !atomic_wait_until_zero_with_timeout_(fn, atom, timeout, channel)) {
+                stats_.on_timeout(channel);
                 return false;
             }
+            stats_.on_acquired(channel, start_time, contended);
+            return true;
+        } else {
+            return atomic_wait_until_zero_with_timeout_(fn, atom, timeout, channel);
+        }
+    }
+
+    // Blocks until the value returned by `fn` becomes 0 or a stop is requested on `stop_token`, whichever comes first.
+    // Returns true if the value has become 0, otherwise returns false. The value is checked once more after the stop
+    // request, so a notification which has been consumed by us is never lost.
+    // Unlike `std::atomic`, a parked thread of `AtomicUInt32` is woken up by a notification even if the value is
+    // unchanged, so the stop request notifies `atom` once to wake us up. The stop request can still be issued after our
+    // last check but before we are parked, so we park for at most `k_stop_check_period` each time and check again.
+    bool atomic_wait_until_zero_or_stopped_(const auto fn, AtomicUInt32& atom, const wake_channel channel,
+            const std::stop_token& stop_token) noexcept
+    {
+        if (!stop_token.stop_possible()) {
+            atomic_wait_until_zero(fn, atom, wait_, wake_, channel, stats_);
+            return true;
+        }
+        const std::stop_callback notify_on_stop{stop_token, [&atom] { atom.notify_all(); }};
+        std::uint32_t current_value = 0;
+        while ((current_value = wait_.spin(fn, atom)) > 0 && !stop_token.stop_requested()) {
+            const auto result = park(fn, atom, current_value, wake_, channel,
+                    [&](AtomicUInt32& atom, const std::uint32_t value)
+                    {
+                        if (stop_token.stop_requested()) {
+                            return false;
+                        }
+                        stats_.on_parked(channel);
+                        // Timing out is regarded as being woken up, after which the stop request is checked again.
+                        atomic_wait_timeout_(atom, value, std::chrono::steady_clock::now() + k_stop_check_period);
+                        return true;
+                    });
+            if (result != park_result::k_woken) {
+                return result == park_result::k_acquired;
+            }
+        }
+        return current_value == 0;
+    }
+
+    // The same as `atomic_wait_until_zero_or_stopped_`, and records the acquisition or the cancellation on `channel`
+    // following the `Stats` policy. The cancellation is recorded as a timeout.
+    bool wait_until_acquired_or_stopped_(const auto fn, AtomicUInt32& atom, const wake_channel channel,
+            const std::chrono::steady_clock::time_point start_time, const std::stop_token& stop_token) noexcept
+    {
+        const bool contended = fn() > 0;
+        if (contended && !atomic_wait_until_zero_or_stopped_(fn, atom, channel, stop_token)) {
+            stats_.on_timeout(channel);
+            return false;
         }
+        stats_.on_acquired(channel, start_time, contended);
         return true;
     }
 
     // The generic function invoked by `try_lock_for` and `try_lock_until`.
     bool try_lock_timeout_(const auto& timeout) noexcept
     {
+        const auto start_time = stats_.now();
+
         // Ensure that no readers can hold shared ownerships anymore.
         this->increase_writing_num_();
 
         // Try to acquire an exclusive ownership.
-        if (!atomic_wait_until_zero_with_timeout_(
-                    [this] { return try_set_writing_state_to_holding_num_(); }, holding_num_, timeout)) {
+        if (!wait_until_acquired_with_timeout_(
+                    [this] { return try_set_writing_state_to_holding_num_(); }, holding_num_, timeout,
+                    wake_channel::k_writers, start_time)) {
             // Fail to acquire.
             this->decrease_writing_num_();
             return false;
@@ -277,8 +1383,41 @@ class shared_timed_mutex : public shared_mutex<AtomicUInt32>
     // The generic function invoked by `try_lock_shared_for` and `try_lock_shared_until`.
     bool try_lock_shared_timeout_(const auto& timeout) noexcept
     {
-        return atomic_wait_until_zero_with_timeout_(
-                [this] { return try_lock_shared_internal_(); }, writing_num_, timeout);
+        const auto start_time = stats_.now();
+        if constexpr (std::is_same_v<Fairness, writer_preferring>) {
+            return wait_until_acquired_with_timeout_(
+                    [this] { return try_lock_shared_internal_(); }, writing_num_, timeout, wake_channel::k_readers,
+                    start_time);
+        } else {
+            auto contended = true;
+            if constexpr (std::is_same_v<Fairness, phase_fair>) {
+                const auto writer_phase = writer_phase_.load(std::memory_order::acquire);
+                if (try_lock_shared_internal_() == 0) {
+                    stats_.on_acquired(wake_channel::k_readers, start_time, false);
+                    return true;
+                }
+                if (!atomic_wait_until_zero_with_timeout_(
+                            [this, writer_phase] { return waiting_writer_phase_(writer_phase); }, writer_phase_,
+                            timeout, wake_channel::k_readers)) {
+                    stats_.on_timeout(wake_channel::k_readers);
+                    return false;
+                }
+                register_reader_();
+            } else {
+                register_reader_();
+                contended = holding_writer_phase_() > 0;
+            }
+            if (contended && !atomic_wait_until_zero_with_timeout_(
+                        [this] { return holding_writer_phase_(); }, holding_num_, timeout, wake_channel::k_readers)) {
+                // Cancel the registration. The writer may have released the mutex after the timeout, but it is
+                // harmless to release the shared ownership which we have just acquired.
+                this->unlock_shared_internal_();
+                stats_.on_timeout(wake_channel::k_readers);
+                return false;
+            }
+            stats_.on_acquired(wake_channel::k_readers, start_time, contended);
+            return true;
+        }
     }
 };
 
@@ -287,8 +1426,19 @@ class shared_timed_mutex : public shared_mutex<AtomicUInt32>
 struct shared_mutex : public internal::shared_mutex<std::atomic<std::uint32_t>> {};
 
 // Till C++23, `std::atomic<std::uint32_t>` has not support waiting with a timeout timepoint or duration yet. We use
-// self-implemented `internal::timed_atomic_uint32_t` instead.
-struct shared_timed_mutex : public internal::shared_timed_mutex<internal::timed_atomic_uint32_t> {};
+// self-implemented `internal::timed_atomic_uint32_t` instead. Since each notification of
+// `internal::timed_atomic_uint32_t` enters the kernel, the parked threads are counted to skip needless notifications.
+struct shared_timed_mutex
+    : public internal::shared_timed_mutex<internal::timed_atomic_uint32_t, compact_layout, spin_wait<>, notify_parked>
+{};
+
+// The variants of `slontia::shared_mutex` and `slontia::shared_timed_mutex` whose atomic variables are placed in
+// individual cache lines. They are suitable for hot mutexes which are heavily contended.
+struct padded_shared_mutex : public internal::shared_mutex<std::atomic<std::uint32_t>, padded_layout> {};
+
+struct padded_shared_timed_mutex
+    : public internal::shared_timed_mutex<internal::timed_atomic_uint32_t, padded_layout, spin_wait<>, notify_parked>
+{};
 
 }
 
@@ -0,0 +1,103 @@
+// Copyright (c) 2024, Chang Liu <github.com/slontia>. All rights reserved.
+//
+// This source code is licensed under MIT (found in the LICENSE file).
+
+#pragma once
+
+#include "shared_mutex.h"
+
+#include <atomic>
+#include <cstdint>
+
+namespace slontia {
+
+// The `slontia::shared_mutex_builder` class template composes the policies of `slontia::internal::shared_mutex` and
+// `slontia::internal::shared_timed_mutex` by name, so each policy can be chosen without spelling out the policies
+// before it in the template parameter list:
+//
+//     using my_shared_mutex = slontia::shared_mutex_builder<>
+//         ::with_layout<slontia::padded_layout>
+//         ::with_fairness<slontia::phase_fair>
+//         ::type;
+//
+// Each `with_*` member replaces one policy and leaves the others, and the defaults are the same as
+// `slontia::internal::shared_mutex`. The built types are exactly the instantiations of the class templates, since all
+// the policies are resolved at compile time: a policy left disabled (e.g. `no_stats` or `no_handoff`) takes no space
+// and is discarded by `if constexpr` from the acquisitions.
+template <typename AtomicUInt32 = std::atomic<std::uint32_t>, typename Layout = compact_layout,
+         typename Wait = spin_wait<>, typename Wake = notify_always, typename Fairness = writer_preferring,
+         typename Stats = no_stats, typename Handoff = no_handoff>
+struct shared_mutex_builder
+{
+    // The atomic type whose `wait` parks the threads (e.g. `internal::timed_atomic_uint32_t` for the timed mutex, or
+    // `internal::process_shared_timed_atomic_uint32_t` for the mutex placed in the shared memory).
+    template <typename T>
+    using with_atomic = shared_mutex_builder<T, Layout, Wait, Wake, Fairness, Stats, Handoff>;
+
+    template <typename T>
+    using with_layout = shared_mutex_builder<AtomicUInt32, T, Wait, Wake, Fairness, Stats, Handoff>;
+
+    template <typename T>
+    using with_wait = shared_mutex_builder<AtomicUInt32, Layout, T, Wake, Fairness, Stats, Handoff>;
+
+    template <typename T>
+    using with_wake = shared_mutex_builder<AtomicUInt32, Layout, Wait, T, Fairness, Stats, Handoff>;
+
+    template <typename T>
+    using with_fairness = shared_mutex_builder<AtomicUInt32, Layout, Wait, Wake, T, Stats, Handoff>;
+
+    template <typename T>
+    using with_stats = shared_mutex_builder<AtomicUInt32, Layout, Wait, Wake, Fairness, T, Handoff>;
+
+    template <typename T>
+    using with_handoff = shared_mutex_builder<AtomicUInt32, Layout, Wait, Wake, Fairness, Stats, T>;
+
+    // The mutex composed of the policies.
+    using type = internal::shared_mutex<AtomicUInt32, Layout, Wait, Wake, Fairness, Stats, Handoff>;
+
+    // The mutex composed of the policies which also supports the timed and cancellable acquisitions. `AtomicUInt32`
+    // should support waiting with a timeout (e.g. `internal::timed_atomic_uint32_t`).
+    using timed_type = internal::shared_timed_mutex<AtomicUInt32, Layout, Wait, Wake, Fairness, Stats, Handoff>;
+};
+
+// The predefined mutexes for the common production profiles.
+
+// For the data read far more often than written. The atomic variables are placed in individual cache lines so the
+// readers counting themselves do not invalidate the cache line checked by other readers, the spinning rounds are
+// learned from the recent acquisitions, and releasing the mutex skips the notifications when no threads are parked.
+struct read_mostly_shared_mutex
+    : public shared_mutex_builder<>
+        ::with_layout<padded_layout>
+        ::with_wait<adaptive_spin_wait<>>
+        ::with_wake<notify_parked>
+        ::type
+{};
+
+// For the mutexes where neither the readers nor the writers may be starved, e.g. a reader serving requests with a
+// latency target and a writer refreshing the data periodically.
+struct fair_shared_mutex
+    : public shared_mutex_builder<>
+        ::with_fairness<phase_fair>
+        ::with_wake<notify_parked>
+        ::type
+{};
+
+// For the data written by many threads. The exclusive ownership is handed over to a parked writer directly, so the
+// woken writer never loses the mutex to the running threads.
+struct write_heavy_shared_mutex
+    : public shared_mutex_builder<>
+        ::with_layout<padded_layout>
+        ::with_handoff<writer_handoff>
+        ::type
+{};
+
+// `slontia::shared_timed_mutex` which also records the stats of the acquisitions, for the mutexes being investigated
+// in production. The stats can be retrieved by `stats()`.
+struct instrumented_shared_timed_mutex
+    : public shared_mutex_builder<internal::timed_atomic_uint32_t>
+        ::with_wake<notify_parked>
+        ::with_stats<lock_stats<>>
+        ::timed_type
+{};
+
+}
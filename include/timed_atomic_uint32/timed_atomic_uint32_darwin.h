@@ -0,0 +1,92 @@
+// Copyright (c) 2024, Chang Liu <github.com/slontia>. All rights reserved.
+//
+// This source code is licensed under MIT (found in the LICENSE file).
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+
+// The private system calls of Darwin, which are also used by libc++ to implement `std::atomic::wait`. They are available
+// since macOS 10.12.
+extern "C" int __ulock_wait(std::uint32_t operation, void* address, std::uint64_t value, std::uint32_t timeout_us);
+extern "C" int __ulock_wake(std::uint32_t operation, void* address, std::uint64_t wake_value);
+
+namespace slontia {
+
+namespace internal {
+
+// The `basic_timed_atomic_uint32_t` class template is an atomic 32-bit unsigned integer which supports waiting with a
+// timeout, implemented by the `__ulock_wait` and `__ulock_wake` system calls.
+//
+// If `k_process_shared` is false, the waiting is private to the process. Otherwise, the atomic integer can be placed in
+// a memory region shared by several processes (e.g. memory mapped by `mmap` with `MAP_SHARED`).
+template <bool k_process_shared>
+class basic_timed_atomic_uint32_t : public std::atomic<std::uint32_t>
+{
+    static_assert(sizeof(std::atomic<std::uint32_t>) == sizeof(std::uint32_t) &&
+            std::atomic<std::uint32_t>::is_always_lock_free, "the waited address should be a plain 32-bit integer");
+
+  public:
+    basic_timed_atomic_uint32_t() noexcept : std::atomic<std::uint32_t>{0} {}
+
+    basic_timed_atomic_uint32_t(const std::uint32_t value) noexcept : std::atomic<std::uint32_t>{value} {}
+
+    void wait(const std::uint32_t value, const std::memory_order order = std::memory_order_seq_cst) noexcept
+    {
+        // The timeout of 0 means no timeout.
+        __ulock_wait(k_operation | k_no_errno_flag, address_(), value, 0);
+    }
+
+    // Returns false if the `timeout_duration` has elapsed, otherwise returns true.
+    template <typename Rep, typename Period>
+    bool wait_for(
+            const std::uint32_t value,
+            const std::chrono::duration<Rep, Period>& timeout_duration,
+            const std::memory_order order = std::memory_order_seq_cst) noexcept
+    {
+        if (timeout_duration <= timeout_duration.zero()) [[unlikely]] {
+            return load(order) != value;
+        }
+        // The timeout is clamped since 0 means no timeout. A longer timeout returns early, which is regarded as a
+        // spurious wakeup.
+        const auto timeout_us = static_cast<std::uint32_t>(std::clamp<long long>(
+                    std::chrono::ceil<std::chrono::microseconds>(timeout_duration).count(), 1, UINT32_MAX));
+        return __ulock_wait(k_operation | k_no_errno_flag, address_(), value, timeout_us) != -ETIMEDOUT;
+    }
+
+    // Returns false if the `timeout_time` has been reached, otherwise returns true.
+    template <typename Clock, typename Duration>
+    bool wait_until(
+            const std::uint32_t value,
+            const std::chrono::time_point<Clock, Duration>& timeout_time,
+            const std::memory_order order = std::memory_order_seq_cst) noexcept
+    {
+        return wait_for(value, timeout_time - Clock::now(), order);
+    }
+
+    void notify_one() noexcept { __ulock_wake(k_operation | k_no_errno_flag, address_(), 0); }
+
+    void notify_all() noexcept { __ulock_wake(k_operation | k_no_errno_flag | k_wake_all_flag, address_(), 0); }
+
+  private:
+    // The values of `UL_COMPARE_AND_WAIT`, `UL_COMPARE_AND_WAIT_SHARED`, `ULF_WAKE_ALL` and `ULF_NO_ERRNO` defined in
+    // the `sys/ulock.h` of the XNU kernel, which is not shipped with the SDK.
+    static constexpr std::uint32_t k_operation = k_process_shared ? 3 : 1;
+    static constexpr std::uint32_t k_wake_all_flag = 0x00000100;
+    static constexpr std::uint32_t k_no_errno_flag = 0x01000000;
+
+    void* address_() noexcept { return static_cast<std::atomic<std::uint32_t>*>(this); }
+};
+
+using timed_atomic_uint32_t = basic_timed_atomic_uint32_t<false>;
+
+// The atomic integer which can be placed in a memory region shared by several processes.
+using process_shared_timed_atomic_uint32_t = basic_timed_atomic_uint32_t<true>;
+
+}
+
+}
@@ -0,0 +1,113 @@
+// Copyright (c) 2024, Chang Liu <github.com/slontia>. All rights reserved.
+//
+// This source code is licensed under MIT (found in the LICENSE file).
+
+#pragma once
+
+#include <sys/types.h>
+#include <sys/umtx.h>
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <ctime>
+
+namespace slontia {
+
+namespace internal {
+
+// The clock which makes `UMTX_OP_WAIT_UINT` measure the absolute timeout against the clock `Clock`. Only the clocks
+// supported by the kernel are specialized.
+template <typename Clock>
+struct umtx_clock_id;
+
+template <>
+struct umtx_clock_id<std::chrono::steady_clock>
+{
+    static constexpr clockid_t value = CLOCK_MONOTONIC;
+};
+
+template <>
+struct umtx_clock_id<std::chrono::system_clock>
+{
+    static constexpr clockid_t value = CLOCK_REALTIME;
+};
+
+// The `basic_timed_atomic_uint32_t` class template is an atomic 32-bit unsigned integer which supports waiting with a
+// timeout, implemented by the `_umtx_op` system call.
+//
+// If `k_process_shared` is false, private umtx operations are issued, which saves the kernel from looking up the memory
+// mapping of the address. Otherwise, the atomic integer can be placed in a memory region shared by several processes
+// (e.g. memory mapped by `mmap` with `MAP_SHARED`).
+template <bool k_process_shared>
+class basic_timed_atomic_uint32_t : public std::atomic<std::uint32_t>
+{
+    static_assert(sizeof(std::atomic<std::uint32_t>) == sizeof(std::uint32_t) &&
+            std::atomic<std::uint32_t>::is_always_lock_free, "the umtx word should be a plain 32-bit integer");
+
+  public:
+    basic_timed_atomic_uint32_t() noexcept : std::atomic<std::uint32_t>{0} {}
+
+    basic_timed_atomic_uint32_t(const std::uint32_t value) noexcept : std::atomic<std::uint32_t>{value} {}
+
+    void wait(const std::uint32_t value, const std::memory_order order = std::memory_order_seq_cst) noexcept
+    {
+        _umtx_op(address_(), k_wait_op, value, nullptr, nullptr);
+    }
+
+    // Returns false if the `timeout_duration` has elapsed, otherwise returns true.
+    template <typename Rep, typename Period>
+    bool wait_for(
+            const std::uint32_t value,
+            const std::chrono::duration<Rep, Period>& timeout_duration,
+            const std::memory_order order = std::memory_order_seq_cst) noexcept
+    {
+        return wait_until(value, std::chrono::steady_clock::now() + timeout_duration, order);
+    }
+
+    // Returns false if the `timeout_time` has been reached, otherwise returns true.
+    // The absolute `timeout_time` is passed to the kernel directly if `Clock` is `std::chrono::steady_clock` or
+    // `std::chrono::system_clock`. Otherwise, it is converted to a time point of `std::chrono::steady_clock`.
+    template <typename Clock, class Duration>
+    bool wait_until(
+            const std::uint32_t value,
+            const std::chrono::time_point<Clock, Duration>& timeout_time,
+            const std::memory_order order = std::memory_order_seq_cst) noexcept
+    {
+        if constexpr (requires { umtx_clock_id<Clock>::value; }) {
+            const auto secs = std::chrono::time_point_cast<std::chrono::seconds>(timeout_time);
+            const auto ns = std::chrono::ceil<std::chrono::nanoseconds>(timeout_time - secs);
+            _umtx_time timeout{};
+            timeout._timeout = timespec{static_cast<std::time_t>(secs.time_since_epoch().count()),
+                static_cast<long>(ns.count())};
+            timeout._flags = UMTX_ABSTIME;
+            timeout._clockid = umtx_clock_id<Clock>::value;
+            // The size of the timeout structure is passed by the pointer argument `uaddr`.
+            return _umtx_op(address_(), k_wait_op, value, reinterpret_cast<void*>(sizeof(timeout)), &timeout) == 0 ||
+                errno != ETIMEDOUT;
+        } else {
+            return wait_until(value, std::chrono::steady_clock::now() + (timeout_time - Clock::now()), order);
+        }
+    }
+
+    void notify_one() noexcept { _umtx_op(address_(), k_wake_op, 1, nullptr, nullptr); }
+
+    void notify_all() noexcept { _umtx_op(address_(), k_wake_op, INT_MAX, nullptr, nullptr); }
+
+  private:
+    static constexpr int k_wait_op = k_process_shared ? UMTX_OP_WAIT_UINT : UMTX_OP_WAIT_UINT_PRIVATE;
+    static constexpr int k_wake_op = k_process_shared ? UMTX_OP_WAKE : UMTX_OP_WAKE_PRIVATE;
+
+    void* address_() noexcept { return static_cast<std::atomic<std::uint32_t>*>(this); }
+};
+
+using timed_atomic_uint32_t = basic_timed_atomic_uint32_t<false>;
+
+// The atomic integer which can be placed in a memory region shared by several processes.
+using process_shared_timed_atomic_uint32_t = basic_timed_atomic_uint32_t<true>;
+
+}
+
+}
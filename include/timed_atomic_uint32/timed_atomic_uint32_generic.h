@@ -0,0 +1,19 @@
+// Copyright (c) 2024, Chang Liu <github.com/slontia>. All rights reserved.
+//
+// This source code is licensed under MIT (found in the LICENSE file).
+
+#pragma once
+
+#include "timed_atomic_uint32_parking_lot.h"
+
+namespace slontia {
+
+namespace internal {
+
+// The platform provides no address-based waiting primitives known by this library, so the threads are parked in the
+// parking lot. There is no process-shared variant since the parking lot lives in the memory of the process.
+using timed_atomic_uint32_t = parking_lot_timed_atomic_uint32_t;
+
+}
+
+}
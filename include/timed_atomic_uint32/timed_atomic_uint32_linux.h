@@ -5,72 +5,223 @@
 #pragma once
 
 #include <linux/futex.h>
+#include <pthread.h>
 #include <sys/syscall.h>
-#include <string.h>
+#include <unistd.h>
 
 #include <atomic>
+#include <cerrno>
 #include <chrono>
+#include <climits>
+#include <cstdint>
+#include <ctime>
 
 namespace slontia {
 
 namespace internal {
 
+// The futex flag which makes `FUTEX_WAIT_BITSET` measure the absolute timeout against the clock `Clock`. Only the clocks
+// supported by the kernel are specialized.
 template <typename Clock>
-struct futex_wait_operator;
+struct futex_clock_flag;
 
+// `FUTEX_WAIT_BITSET` measures the timeout against `CLOCK_MONOTONIC` by default, which is the clock of
+// `std::chrono::steady_clock`.
 template <>
-struct futex_wait_operator<std::chrono::steady_clock>
+struct futex_clock_flag<std::chrono::steady_clock>
 {
-    static constexpr int value = FUTEX_WAIT;
+    static constexpr int value = 0;
 };
 
 template <>
-struct futex_wait_operator<std::chrono::system_clock>
+struct futex_clock_flag<std::chrono::system_clock>
 {
-    static constexpr int value = FUTEX_WAIT | FUTEX_CLOCK_REALTIME;
+    static constexpr int value = FUTEX_CLOCK_REALTIME;
 };
 
-class timed_atomic_uint32_t : public std::atomic_ref<std::uint32_t>
+// The `basic_timed_atomic_uint32_t` class template is an atomic 32-bit unsigned integer which supports waiting with a
+// timeout, implemented by the futex system call.
+//
+// If `k_process_shared` is false, private futex operations are issued, which saves the kernel from looking up the
+// memory mapping of the address. Otherwise, the atomic integer can be placed in a memory region shared by several
+// processes (e.g. memory mapped by `mmap` with `MAP_SHARED`).
+template <bool k_process_shared>
+class basic_timed_atomic_uint32_t : public std::atomic<std::uint32_t>
 {
+    static_assert(sizeof(std::atomic<std::uint32_t>) == sizeof(std::uint32_t) &&
+            std::atomic<std::uint32_t>::is_always_lock_free, "the futex word should be a plain 32-bit integer");
+
   public:
-    timed_atomic_uint32_t() : std::atomic_ref<std::uint32_t>{value_} {}
+    basic_timed_atomic_uint32_t() noexcept : std::atomic<std::uint32_t>{0} {}
 
-    timed_atomic_uint32_t(const std::uint32_t value)
-        : value_{std::move(value)}, std::atomic_ref<std::uint32_t>{value_} {}
+    basic_timed_atomic_uint32_t(const std::uint32_t value) noexcept : std::atomic<std::uint32_t>{value} {}
 
     void wait(const std::uint32_t value, const std::memory_order order = std::memory_order_seq_cst) noexcept
     {
-        syscall(SYS_futex, &value_, FUTEX_WAIT, value, nullptr, nullptr, 0);
+        futex_(FUTEX_WAIT, value, nullptr, 0);
     }
 
+    // Returns false if the `timeout_duration` has elapsed, otherwise returns true.
     template <typename Rep, typename Period>
     bool wait_for(
             const std::uint32_t value,
             const std::chrono::duration<Rep, Period>& timeout_duration,
             const std::memory_order order = std::memory_order_seq_cst) noexcept
     {
-        return wait_until(value, std::chrono::steady_clock::now() + timeout_duration);
+        return wait_until(value, std::chrono::steady_clock::now() + timeout_duration, order);
     }
 
+    // Returns false if the `timeout_time` has been reached, otherwise returns true.
+    // The absolute `timeout_time` is passed to the kernel directly if `Clock` is `std::chrono::steady_clock` or
+    // `std::chrono::system_clock`. Otherwise, it is converted to a time point of `std::chrono::steady_clock`.
     template <typename Clock, class Duration>
     bool wait_until(
             const std::uint32_t value,
             const std::chrono::time_point<Clock, Duration>& timeout_time,
             const std::memory_order order = std::memory_order_seq_cst) noexcept
     {
-        const auto secs = std::chrono::time_point_cast<std::chrono::seconds>(timeout_time);
-        const auto ns = std::chrono::time_point_cast<std::chrono::nanoseconds>(timeout_time) -
-            std::chrono::time_point_cast<std::chrono::nanoseconds>(secs);
-        timespec timeout{secs.time_since_epoch().count(), ns.count()};
-        return syscall(SYS_futex, &value_, futex_wait_operator<Clock>::value, value, timeout, nullptr, 0) == 0;
+        if constexpr (requires { futex_clock_flag<Clock>::value; }) {
+            const auto secs = std::chrono::time_point_cast<std::chrono::seconds>(timeout_time);
+            const auto ns = std::chrono::ceil<std::chrono::nanoseconds>(timeout_time - secs);
+            const timespec timeout{static_cast<std::time_t>(secs.time_since_epoch().count()),
+                static_cast<long>(ns.count())};
+            return futex_(FUTEX_WAIT_BITSET | futex_clock_flag<Clock>::value, value, &timeout,
+                    FUTEX_BITSET_MATCH_ANY) == 0 || errno != ETIMEDOUT;
+        } else {
+            return wait_until(value, std::chrono::steady_clock::now() + (timeout_time - Clock::now()), order);
+        }
+    }
+
+    void notify_one() noexcept { futex_(FUTEX_WAKE, 1, nullptr, 0); }
+
+    void notify_all() noexcept { futex_(FUTEX_WAKE, INT_MAX, nullptr, 0); }
+
+  private:
+    static constexpr int k_futex_private_flag = k_process_shared ? 0 : FUTEX_PRIVATE_FLAG;
+
+    long futex_(const int op, const std::uint32_t value, const timespec* const timeout, const std::uint32_t value3)
+        noexcept
+    {
+        auto* const address = reinterpret_cast<std::uint32_t*>(static_cast<std::atomic<std::uint32_t>*>(this));
+        return syscall(SYS_futex, address, op | k_futex_private_flag, value, timeout, nullptr, value3);
+    }
+};
+
+using timed_atomic_uint32_t = basic_timed_atomic_uint32_t<false>;
+
+// The atomic integer which can be placed in a memory region shared by several processes.
+using process_shared_timed_atomic_uint32_t = basic_timed_atomic_uint32_t<true>;
+
+// The flags of `futex_waitv` for the waiters on the atomic type `AtomicUInt32`. Only the atomic types whose
+// notifications always issue `FUTEX_WAKE` are specialized, since the notifications of other types (e.g.
+// `std::atomic<std::uint32_t>`) may be skipped when they do not observe the waiters parked by `futex_waitv`.
+template <typename AtomicUInt32>
+struct futex_waitv_flags;
+
+template <bool k_process_shared>
+struct futex_waitv_flags<basic_timed_atomic_uint32_t<k_process_shared>>
+{
+    // The value of `FUTEX_32`, which is not defined by the kernel headers older than 5.16.
+    static constexpr std::uint32_t value = 2 | (k_process_shared ? 0 : FUTEX_PRIVATE_FLAG);
+};
+
+// The waiter of `futex_waitv`, which has the same layout as `struct futex_waitv` of the kernel.
+struct futex_waiter
+{
+    std::uint64_t value_;
+    std::uint64_t address_;
+    std::uint32_t flags_;
+    std::uint32_t reserved_{0};
+};
+
+// Blocks until one of the `waiter_num` atomic integers described by `waiters` is notified, or returns immediately if
+// any of them does not equal to its value. Returns false if `futex_waitv` is not supported by the kernel (before 5.16),
+// otherwise returns true.
+inline bool futex_waitv(const futex_waiter* const waiters, const std::uint32_t waiter_num) noexcept
+{
+#ifdef SYS_futex_waitv
+    static constexpr long k_futex_waitv_number = SYS_futex_waitv;
+#else
+    static constexpr long k_futex_waitv_number = 449;
+#endif
+    static std::atomic<bool> supported{true};
+    if (!supported.load(std::memory_order::relaxed)) {
+        return false;
+    }
+    if (syscall(k_futex_waitv_number, waiters, waiter_num, 0, nullptr, 0) == -1 && errno == ENOSYS) {
+        supported.store(false, std::memory_order::relaxed);
+        return false;
+    }
+    return true;
+}
+
+inline std::uint32_t& cached_this_thread_id() noexcept
+{
+    thread_local std::uint32_t tid = 0;
+    return tid;
+}
+
+// Returns the kernel thread ID of the current thread. The ID is cached, and the cache is reset in the child process
+// created by `fork`, whose only thread has a different ID from the forking thread.
+inline std::uint32_t this_thread_id() noexcept
+{
+    auto& tid = cached_this_thread_id();
+    if (tid == 0) [[unlikely]] {
+        [[maybe_unused]] static const int registered =
+            pthread_atfork(nullptr, nullptr, [] { cached_this_thread_id() = 0; });
+        tid = static_cast<std::uint32_t>(syscall(SYS_gettid));
+    }
+    return tid;
+}
+
+// The `pi_futex_t` class is an exclusive lock implemented by the priority-inheritance futex operations. The futex word
+// stores the thread ID of the owner, so when a thread is blocked on the lock, the kernel boosts the priority of the
+// owner to the priority of the blocked thread until the lock is released, and transfers the ownership to the blocked
+// thread of the highest priority.
+//
+// Unlike the other locks of this library, `pi_futex_t` must be unlocked by the thread which locks it, and cannot be
+// locked recursively. The uncontended acquisition and release are done by CAS in user space.
+class pi_futex_t
+{
+    static_assert(sizeof(std::atomic<std::uint32_t>) == sizeof(std::uint32_t) &&
+            std::atomic<std::uint32_t>::is_always_lock_free, "the futex word should be a plain 32-bit integer");
+
+  public:
+    bool try_lock() noexcept
+    {
+        std::uint32_t expected = 0;
+        return word_.compare_exchange_strong(expected, this_thread_id(), std::memory_order::acquire,
+                std::memory_order::relaxed);
     }
 
-    void notify_one() noexcept { syscall(SYS_futex, &value_, FUTEX_WAKE, 1, nullptr, nullptr, 0); }
+    void lock() noexcept
+    {
+        // The kernel sets `FUTEX_WAITERS` in the futex word and blocks us until the ownership is transferred to us. The
+        // operation only fails transiently (e.g. when the owner is exiting), in which case we try again.
+        while (!try_lock() && futex_(FUTEX_LOCK_PI) != 0) {
+        }
+    }
 
-    void notify_all() noexcept { syscall(SYS_futex, &value_, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0); }
+    void unlock() noexcept
+    {
+        // The CAS fails if `FUTEX_WAITERS` is set, in which case the kernel has to transfer the ownership.
+        auto expected = this_thread_id();
+        if (!word_.compare_exchange_strong(expected, 0, std::memory_order::release, std::memory_order::relaxed)) {
+            futex_(FUTEX_UNLOCK_PI);
+        }
+    }
+
+    // Returns the thread ID of the owner, or 0 if the lock is not held.
+    std::uint32_t owner() const noexcept { return word_.load(std::memory_order::relaxed) & FUTEX_TID_MASK; }
 
   private:
-    alignas(std::atomic_ref<std::uint32_t>::required_alignment) std::uint32_t value_;
+    long futex_(const int op) noexcept
+    {
+        return syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word_), op | FUTEX_PRIVATE_FLAG, 0, nullptr,
+                nullptr, 0);
+    }
+
+    std::atomic<std::uint32_t> word_{0};
 };
 
 }
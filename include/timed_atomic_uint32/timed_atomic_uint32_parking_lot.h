@@ -0,0 +1,158 @@
+// Copyright (c) 2024, Chang Liu <github.com/slontia>. All rights reserved.
+//
+// This source code is licensed under MIT (found in the LICENSE file).
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <type_traits>
+
+namespace slontia {
+
+namespace internal {
+
+// The `parking_lot_timed_atomic_uint32_t` class is an atomic 32-bit unsigned integer which supports waiting with a
+// timeout, implemented only by the standard library so that it works on any platform.
+//
+// The waiting threads are parked in a global table of buckets hashed by the address of the atomic integer. Each bucket
+// is protected by a mutex and holds an intrusive list of the parked threads, and each parked thread waits on its own
+// condition variable, so a notification wakes only the threads waiting on the same address.
+class parking_lot_timed_atomic_uint32_t : public std::atomic<std::uint32_t>
+{
+  public:
+    parking_lot_timed_atomic_uint32_t() noexcept : std::atomic<std::uint32_t>{0} {}
+
+    parking_lot_timed_atomic_uint32_t(const std::uint32_t value) noexcept : std::atomic<std::uint32_t>{value} {}
+
+    // The accesses are ordered by the mutex of the bucket, so `order` is ignored.
+    void wait(const std::uint32_t value, [[maybe_unused]] const std::memory_order order = std::memory_order_seq_cst)
+        noexcept
+    {
+        park_(value, std::nullopt);
+    }
+
+    // Returns false if the `timeout_duration` has elapsed, otherwise returns true.
+    template <typename Rep, typename Period>
+    bool wait_for(
+            const std::uint32_t value,
+            const std::chrono::duration<Rep, Period>& timeout_duration,
+            const std::memory_order order = std::memory_order_seq_cst) noexcept
+    {
+        return wait_until(value, std::chrono::steady_clock::now() + timeout_duration, order);
+    }
+
+    // Returns false if the `timeout_time` has been reached, otherwise returns true.
+    // The `timeout_time` is converted to a time point of `std::chrono::steady_clock` if `Clock` is not
+    // `std::chrono::steady_clock`.
+    template <typename Clock, typename Duration>
+    bool wait_until(
+            const std::uint32_t value,
+            const std::chrono::time_point<Clock, Duration>& timeout_time,
+            const std::memory_order order = std::memory_order_seq_cst) noexcept
+    {
+        if constexpr (std::is_same_v<Clock, std::chrono::steady_clock>) {
+            return park_(value, std::chrono::ceil<std::chrono::steady_clock::duration>(timeout_time));
+        } else {
+            return wait_until(value, std::chrono::steady_clock::now() + (timeout_time - Clock::now()), order);
+        }
+    }
+
+    void notify_one() noexcept { unpark_(false); }
+
+    void notify_all() noexcept { unpark_(true); }
+
+  private:
+    // The number of buckets, which is a power of two so that the hash can be masked.
+    static constexpr std::size_t k_bucket_num = 64;
+
+    struct waiter
+    {
+        const void* address_;
+        std::condition_variable cv_{};
+        bool notified_{false};
+        waiter* prev_{nullptr};
+        waiter* next_{nullptr};
+    };
+
+    // The cache line size is hard-coded here since this header does not depend on `shared_mutex.h`.
+    struct alignas(64) bucket
+    {
+        std::mutex mutex_;
+        waiter* head_{nullptr};
+        waiter* tail_{nullptr};
+
+        void push_back(waiter& node) noexcept
+        {
+            node.prev_ = tail_;
+            (tail_ ? tail_->next_ : head_) = &node;
+            tail_ = &node;
+        }
+
+        void erase(waiter& node) noexcept
+        {
+            (node.prev_ ? node.prev_->next_ : head_) = node.next_;
+            (node.next_ ? node.next_->prev_ : tail_) = node.prev_;
+        }
+    };
+
+    static bucket& bucket_of_(const void* const address) noexcept
+    {
+        static std::array<bucket, k_bucket_num> buckets;
+        // The low bits are always zero because of the alignment.
+        return buckets[(std::hash<const void*>{}(address) >> 2) & (k_bucket_num - 1)];
+    }
+
+    // Returns false if the `deadline` has been reached before being notified, otherwise returns true.
+    //
+    // The value is checked under the lock of the bucket, and the notifier also takes the lock after modifying the value,
+    // so the notification cannot be missed between the check and the parking.
+    bool park_(const std::uint32_t value, const std::optional<std::chrono::steady_clock::time_point> deadline) noexcept
+    {
+        auto& bucket = bucket_of_(this);
+        std::unique_lock lock{bucket.mutex_};
+        if (load(std::memory_order_relaxed) != value) {
+            return true;
+        }
+        waiter node{.address_ = this};
+        bucket.push_back(node);
+        if (!deadline.has_value()) {
+            node.cv_.wait(lock, [&node] { return node.notified_; });
+        } else if (!node.cv_.wait_until(lock, *deadline, [&node] { return node.notified_; })) {
+            // The notifier unlinks the notified nodes, so only the timed-out node is unlinked by itself.
+            bucket.erase(node);
+            return false;
+        }
+        return true;
+    }
+
+    // The parked threads are woken in FIFO order.
+    void unpark_(const bool all) noexcept
+    {
+        auto& bucket = bucket_of_(this);
+        std::lock_guard lock{bucket.mutex_};
+        for (waiter* node = bucket.head_; node != nullptr;) {
+            waiter* const next = node->next_;
+            if (node->address_ == this) {
+                bucket.erase(*node);
+                node->notified_ = true;
+                // The condition variable is notified under the lock, so the node is still alive.
+                node->cv_.notify_one();
+                if (!all) {
+                    break;
+                }
+            }
+            node = next;
+        }
+    }
+};
+
+}
+
+}
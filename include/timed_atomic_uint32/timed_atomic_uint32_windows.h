@@ -6,6 +6,7 @@
 
 #include <windows.h>
 
+#include <algorithm>
 #include <atomic>
 #include <chrono>
 
@@ -13,19 +14,24 @@ namespace slontia {
 
 namespace internal {
 
-class timed_atomic_uint32_t : public std::atomic_ref<std::uint32_t>
+// The `timed_atomic_uint32_t` class is an atomic 32-bit unsigned integer which supports waiting with a timeout,
+// implemented by `WaitOnAddress`.
+class timed_atomic_uint32_t : public std::atomic<std::uint32_t>
 {
+    static_assert(sizeof(std::atomic<std::uint32_t>) == sizeof(std::uint32_t) &&
+            std::atomic<std::uint32_t>::is_always_lock_free, "the waited address should be a plain 32-bit integer");
+
   public:
-    timed_atomic_uint32_t() : std::atomic_ref<std::uint32_t>{value_} {}
+    timed_atomic_uint32_t() noexcept : std::atomic<std::uint32_t>{0} {}
 
-    timed_atomic_uint32_t(const std::uint32_t value)
-        : value_{std::move(value)}, std::atomic_ref<std::uint32_t>{value_} {}
+    timed_atomic_uint32_t(const std::uint32_t value) noexcept : std::atomic<std::uint32_t>{value} {}
 
     void wait(std::uint32_t value, const std::memory_order order = std::memory_order_seq_cst) noexcept
     {
-        WaitOnAddress(&value_, &value, sizeof(std::uint32_t), INFINITE);
+        WaitOnAddress(address_(), &value, sizeof(std::uint32_t), INFINITE);
     }
 
+    // Returns false if the `timeout_duration` has elapsed, otherwise returns true.
     template <typename Rep, typename Period>
     bool wait_for(
             std::uint32_t value,
@@ -33,29 +39,31 @@ class timed_atomic_uint32_t : public std::atomic_ref<std::uint32_t>
             const std::memory_order order = std::memory_order_seq_cst) noexcept
     {
         if (timeout_duration <= timeout_duration.zero()) [[unlikely]] {
-            return *this == value;
+            return load(order) != value;
         }
-        return WaitOnAddress(&value_, &value, sizeof(std::uint32_t), 
-            std::chrono::duration_cast<std::chrono::milliseconds>(timeout_duration).count());
+        // The timeout is clamped since `INFINITE` means no timeout.
+        const auto timeout_ms = static_cast<DWORD>(std::min<long long>(
+                    std::chrono::ceil<std::chrono::milliseconds>(timeout_duration).count(), INFINITE - 1));
+        return WaitOnAddress(address_(), &value, sizeof(std::uint32_t), timeout_ms) || GetLastError() != ERROR_TIMEOUT;
     }
 
+    // Returns false if the `timeout_time` has been reached, otherwise returns true.
     template <typename Clock, typename Duration>
     bool wait_until(
             const std::uint32_t value,
             const std::chrono::time_point<Clock, Duration>& timeout_time,
             const std::memory_order order = std::memory_order_seq_cst) noexcept
     {
-        return wait_for(value, timeout_time - Clock::now());
+        return wait_for(value, timeout_time - Clock::now(), order);
     }
 
-    void notify_one() noexcept { WakeByAddressSingle(&value_); }
+    void notify_one() noexcept { WakeByAddressSingle(address_()); }
 
-    void notify_all() noexcept { WakeByAddressAll(&value_); }
+    void notify_all() noexcept { WakeByAddressAll(address_()); }
 
   private:
-    alignas(std::atomic_ref<std::uint32_t>::required_alignment) std::uint32_t value_;
+    void* address_() noexcept { return static_cast<std::atomic<std::uint32_t>*>(this); }
 };
-
 }
 
 }
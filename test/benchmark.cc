@@ -3,17 +3,38 @@
 // This source code is licensed under MIT (found in the LICENSE file).
 
 #include "shared_mutex.h"
+#include "shared_mutex_builder.h"
+#include "sharded_shared_mutex.h"
+#include "packed_shared_mutex.h"
+#include "cohort_shared_mutex.h"
 #include "mutex_protect_wrapper.h"
+#include "sharded_wrapper.h"
+
+#include "benchmark_util.h"
 
 #include <algorithm>
+#include <array>
+#include <bit>
+#include <cctype>
+#include <fstream>
+#include <functional>
 #include <numeric>
 #include <latch>
+#include <optional>
+#include <random>
 #include <thread>
 #include <shared_mutex>
+#include <string>
+#include <unordered_map>
 
 #include <gtest/gtest.h>
 #include <gflags/gflags.h>
 
+#ifdef __linux__
+#include <sched.h>
+#include <sys/resource.h>
+#endif
+
 DEFINE_uint32(read_threads, 100, "Number of threads to read");
 DEFINE_uint32(try_read_threads, 100, "Number of threads to try to read");
 DEFINE_uint32(try_read_1ms_threads, 100, "Number of threads to try to read for 1 millisecond");
@@ -21,6 +42,18 @@ DEFINE_uint32(write_threads, 1, "Number of threads to write");
 DEFINE_uint32(try_write_threads, 1, "Number of threads to try to write");
 DEFINE_uint32(try_write_1ms_threads, 1, "Number of threads to try to write for 1 millisecond");
 DEFINE_uint32(operation_num, 100000, "Number of operations for each thread");
+DEFINE_bool(latency_histogram, false, "Measure the latency of each operation and print the percentiles");
+DEFINE_bool(perf_counters, false, "Count the hardware and software events of each thread by perf_event_open on Linux");
+DEFINE_uint64(perf_hitm_event, 0, "Raw perf event config counting the HITM loads, which is model-specific");
+DEFINE_string(json_output, "", "Path of the JSON file to write the results of all thread groups");
+DEFINE_string(csv_output, "", "Path of the CSV file to write the results of all thread groups");
+DEFINE_uint32(transfer_threads, 8, "Number of threads to transfer between two wrappers");
+DEFINE_uint32(transfer_wrapper_num, 4, "Number of wrappers to transfer between");
+DEFINE_uint32(max_lookup_threads, 16, "Maximum number of threads to look up the map, doubled from 1");
+DEFINE_uint32(lookup_key_num, 1024, "Number of keys in the map to look up");
+DEFINE_uint32(with_lock_threads, 8, "Number of threads to write by with_lock");
+DEFINE_uint32(numa_read_threads, 8, "Number of threads pinned to the NUMA nodes in turn to read");
+DEFINE_uint32(numa_write_threads, 8, "Number of threads pinned to the NUMA nodes in turn to write");
 
 class object
 {
@@ -81,12 +114,86 @@ static bool try_write_object_for_1ms(auto& obj)
     return operate_object([&] { return obj.try_lock_for(std::chrono::milliseconds(1)); }, &object::write);
 }
 
+// Returns the number of voluntary context switches of the current thread. A thread switches out voluntarily when it is
+// parked by a futex (or `WaitOnAddress`) system call, so the value reflects how often the thread sleeps in the kernel.
+static uint64_t voluntary_context_switches()
+{
+#ifdef __linux__
+    rusage usage;
+    getrusage(RUSAGE_THREAD, &usage);
+    return usage.ru_nvcsw;
+#else
+    return 0;
+#endif
+}
+
+// The number of times the current thread has been woken up after parking, and the number of notifications the current
+// thread has issued. They are only counted for the mutexes built on `wakeup_counting_atomic`.
+thread_local uint64_t tls_wakeup_count{0};
+thread_local uint64_t tls_notification_count{0};
+
+// The `wakeup_counting_atomic` class template wraps an atomic type used by `slontia::internal::shared_mutex`, and counts
+// the wakeups and notifications of the current thread.
+template <typename AtomicUInt32>
+class wakeup_counting_atomic : public AtomicUInt32
+{
+  public:
+    using AtomicUInt32::AtomicUInt32;
+
+    void wait(const uint32_t value, const std::memory_order order = std::memory_order_seq_cst) noexcept
+    {
+        AtomicUInt32::wait(value, order);
+        ++tls_wakeup_count;
+    }
+
+    template <typename Rep, typename Period>
+    bool wait_for(const uint32_t value, const std::chrono::duration<Rep, Period>& timeout_duration,
+            const std::memory_order order = std::memory_order_seq_cst) noexcept
+    {
+        const bool result = AtomicUInt32::wait_for(value, timeout_duration, order);
+        ++tls_wakeup_count;
+        return result;
+    }
+
+    template <typename Clock, typename Duration>
+    bool wait_until(const uint32_t value, const std::chrono::time_point<Clock, Duration>& timeout_time,
+            const std::memory_order order = std::memory_order_seq_cst) noexcept
+    {
+        const bool result = AtomicUInt32::wait_until(value, timeout_time, order);
+        ++tls_wakeup_count;
+        return result;
+    }
+
+    void notify_one() noexcept
+    {
+        AtomicUInt32::notify_one();
+        ++tls_notification_count;
+    }
+
+    void notify_all() noexcept
+    {
+        AtomicUInt32::notify_all();
+        ++tls_notification_count;
+    }
+};
+
+// The latency is only measured with `--latency_histogram` or when any output file is specified.
+static bool latency_measured()
+{
+    return FLAGS_latency_histogram || !FLAGS_json_output.empty() || !FLAGS_csv_output.empty();
+}
+
 class thread_group
 {
     struct thread_result
     {
         std::chrono::microseconds duration_;
         uint32_t success_count_{0};
+        uint64_t context_switch_count_{0};
+        uint64_t wakeup_count_{0};
+        uint64_t notification_count_{0};
+        latency_histogram latency_histogram_;
+        std::array<std::optional<uint64_t>, perf_counters::k_event_num> perf_counts_{};
     };
 
   public:
@@ -115,11 +222,26 @@ class thread_group
                 {
                     std::cout << (static_cast<double>(success_count) / FLAGS_operation_num * 100) << "%";
                 });
+        if (sum_item_(&thread_result::wakeup_count_) + sum_item_(&thread_result::notification_count_) > 0) {
+            print_per_operation_result_("wakeups per operation", &thread_result::wakeup_count_);
+            print_per_operation_result_("notifications per operation", &thread_result::notification_count_);
+        }
+#ifdef __linux__
+        print_per_operation_result_("context switches per operation", &thread_result::context_switch_count_);
+#endif
+        if (FLAGS_perf_counters) {
+            print_perf_result_();
+        }
+        const auto histogram = merged_latency_histogram_();
+        if (FLAGS_latency_histogram) {
+            print_latency_result_(histogram);
+        }
         std::cout << "\n";
+        record_result_(histogram);
     }
 
     template <typename T>
-    auto sum_item_(T thread_result::*const member_ptr) const
+    T sum_item_(T thread_result::*const member_ptr) const
     {
         return std::accumulate(result_begin_(), result_end_(), T{},
                 [&](const T value, const thread_result& result) { return value + result.*member_ptr; });
@@ -134,14 +256,37 @@ class thread_group
     template <typename Task>
     static void thread_main_(std::latch& latch, const Task task, thread_result& result)
     {
+        const bool measure_latency = latency_measured();
+        std::optional<perf_counters> counters;
+        if (FLAGS_perf_counters) {
+            counters.emplace(FLAGS_perf_hitm_event);
+        }
         latch.count_down();
         latch.wait();
+        if (counters) {
+            counters->start();
+        }
+        const auto start_context_switch_count = voluntary_context_switches();
+        const auto start_wakeup_count = tls_wakeup_count;
+        const auto start_notification_count = tls_notification_count;
         const auto start_ts = std::chrono::steady_clock::now();
         for (uint32_t i = 0; i < FLAGS_operation_num; ++i) {
-            result.success_count_ += task();
+            if (measure_latency) {
+                const auto operation_start_ts = std::chrono::steady_clock::now();
+                result.success_count_ += task();
+                result.latency_histogram_.record(std::chrono::steady_clock::now() - operation_start_ts);
+            } else {
+                result.success_count_ += task();
+            }
+        }
+        if (counters) {
+            result.perf_counts_ = counters->stop();
         }
         result.duration_ =
             std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_ts);
+        result.context_switch_count_ = voluntary_context_switches() - start_context_switch_count;
+        result.wakeup_count_ = tls_wakeup_count - start_wakeup_count;
+        result.notification_count_ = tls_notification_count - start_notification_count;
     }
 
     thread_result* result_begin_() { return &thread_results_[0]; }
@@ -150,23 +295,113 @@ class thread_group
     thread_result* result_end_() { return result_begin_() + threads_.size(); }
     const thread_result* result_end_() const { return result_begin_() + threads_.size(); }
 
-    template <typename T>
-    void print_result_(const char* const item_name, T thread_result::*const member_ptr, const auto output_item)
+    // Prints the distribution of the item projected from the result of each thread by `projection`, which is a member
+    // pointer or a function.
+    void print_result_(const char* const item_name, const auto projection, const auto output_item)
     {
+        const auto item = [&](const thread_result& result) { return std::invoke(projection, result); };
+        using item_type = std::decay_t<decltype(item(thread_results_[0]))>;
         std::sort(result_begin_(), result_end_(),
-                [&](const thread_result& _1, const thread_result& _2) { return _1.*member_ptr < _2.*member_ptr; });
+                [&](const thread_result& _1, const thread_result& _2) { return item(_1) < item(_2); });
         std::cout << "\n  - [" << item_name << "]\tavg: ";
-        output_item(sum_item_(member_ptr) / threads_.size());
+        output_item(std::accumulate(result_begin_(), result_end_(), item_type{},
+                    [&](const item_type value, const thread_result& result) { return value + item(result); }) /
+                threads_.size());
         std::cout << ",\tmin: ";
-        output_item(thread_results_[0].*member_ptr);
+        output_item(item(thread_results_[0]));
         std::cout << ",\t10%: ";
-        output_item(thread_results_[threads_.size() * 0.1].*member_ptr);
+        output_item(item(thread_results_[threads_.size() * 0.1]));
         std::cout << ",\t50%: ";
-        output_item(thread_results_[threads_.size() * 0.5].*member_ptr);
+        output_item(item(thread_results_[threads_.size() * 0.5]));
         std::cout << ",\t90%: ";
-        output_item(thread_results_[threads_.size() * 0.9].*member_ptr);
+        output_item(item(thread_results_[threads_.size() * 0.9]));
         std::cout << ",\tmax: ";
-        output_item(thread_results_[threads_.size() - 1].*member_ptr);
+        output_item(item(thread_results_[threads_.size() - 1]));
+    }
+
+    // Returns true if `event` is counted by all threads.
+    bool perf_event_counted_(const std::size_t event) const
+    {
+        return std::all_of(result_begin_(), result_end_(),
+                [&](const thread_result& result) { return result.perf_counts_[event].has_value(); });
+    }
+
+    // Prints the counts of the events for each successful acquisition.
+    void print_perf_result_()
+    {
+        for (std::size_t i = 0; i < perf_counters::k_event_num; ++i) {
+            if (!perf_event_counted_(i)) {
+                continue;
+            }
+            print_result_((std::string{perf_counters::k_event_names[i]} + " per acquisition").c_str(),
+                    [i](const thread_result& result)
+                    {
+                        return static_cast<double>(*result.perf_counts_[i]) / std::max(result.success_count_, 1u);
+                    },
+                    [](const double count) { std::cout << count; });
+        }
+    }
+
+    void print_per_operation_result_(const char* const item_name, uint64_t thread_result::*const member_ptr)
+    {
+        print_result_(item_name, member_ptr,
+                [](const uint64_t count) { std::cout << (static_cast<double>(count) / FLAGS_operation_num); });
+    }
+
+    latency_histogram merged_latency_histogram_() const
+    {
+        latency_histogram histogram;
+        std::for_each(result_begin_(), result_end_(),
+                [&](const thread_result& result) { histogram += result.latency_histogram_; });
+        return histogram;
+    }
+
+    // Prints the percentiles of the latency of the operations from all threads.
+    static void print_latency_result_(const latency_histogram& histogram)
+    {
+        std::cout << "\n  - [latency]\t";
+        for (const double percent : {50.0, 90.0, 99.0, 99.9}) {
+            std::cout << (percent == 50.0 ? "" : ",\t") << percent << "%: <"
+                << (static_cast<double>(histogram.percentile(percent).count()) / 1000) << "us";
+        }
+        std::cout << ",\tmax: " << (static_cast<double>(histogram.max().count()) / 1000) << "us";
+    }
+
+    // Records the result of the group to `result_recorder`, named after the running test.
+    void record_result_(const latency_histogram& histogram) const
+    {
+        const auto* const test_info = testing::UnitTest::GetInstance()->current_test_info();
+        const auto max_duration = std::max_element(result_begin_(), result_end_(),
+                [](const thread_result& _1, const thread_result& _2) { return _1.duration_ < _2.duration_; })->duration_;
+        const uint64_t operation_num = static_cast<uint64_t>(FLAGS_operation_num) * threads_.size();
+        result_recorder::instance().add(group_result{
+                .benchmark_ = test_info ? std::string{test_info->test_suite_name()} + "." + test_info->name() : "",
+                .mutex_ = test_info && test_info->type_param() ? test_info->type_param() : "",
+                .group_ = name_,
+                .thread_num_ = static_cast<uint32_t>(threads_.size()),
+                .operation_num_ = operation_num,
+                .success_count_ = sum_item_(&thread_result::success_count_),
+                .duration_ms_ = static_cast<double>(max_duration.count()) / 1000,
+                .throughput_ = max_duration.count() > 0 ? operation_num * 1e6 / max_duration.count() : 0,
+                .latency_histogram_ = histogram,
+                .perf_counts_per_acquisition_ = perf_counts_per_acquisition_()});
+    }
+
+    // Returns the total counts of the events divided by the total number of successful acquisitions of the group.
+    std::array<std::optional<double>, perf_counters::k_event_num> perf_counts_per_acquisition_() const
+    {
+        std::array<std::optional<double>, perf_counters::k_event_num> counts{};
+        const auto success_count = std::max(sum_item_(&thread_result::success_count_), 1u);
+        for (std::size_t i = 0; i < perf_counters::k_event_num; ++i) {
+            if (FLAGS_perf_counters && perf_event_counted_(i)) {
+                counts[i] = static_cast<double>(std::accumulate(result_begin_(), result_end_(), uint64_t{0},
+                            [i](const uint64_t sum, const thread_result& result)
+                            {
+                                return sum + *result.perf_counts_[i];
+                            })) / success_count;
+            }
+        }
+        return counts;
     }
 
     const char* name_{nullptr};
@@ -185,7 +420,30 @@ class benchmark : public testing::Test
 };
 
 using shared_mutexes = testing::Types<
-    slontia::shared_mutex, std::shared_mutex, slontia::shared_timed_mutex, std::shared_timed_mutex>;
+    slontia::shared_mutex, std::shared_mutex, slontia::shared_timed_mutex, std::shared_timed_mutex,
+    slontia::padded_shared_mutex, slontia::padded_shared_timed_mutex, slontia::sharded_shared_mutex<>,
+    slontia::packed_shared_mutex,
+    slontia::internal::shared_mutex<std::atomic<uint32_t>, slontia::compact_layout, slontia::spin_wait<>,
+        slontia::notify_always, slontia::reader_preferring>,
+    slontia::internal::shared_mutex<std::atomic<uint32_t>, slontia::compact_layout, slontia::spin_wait<>,
+        slontia::notify_always, slontia::phase_fair>,
+    slontia::internal::shared_timed_mutex<slontia::internal::timed_atomic_uint32_t, slontia::compact_layout,
+        slontia::spin_wait<>, slontia::notify_parked, slontia::phase_fair>,
+    slontia::internal::shared_mutex<std::atomic<uint32_t>, slontia::compact_layout, slontia::park_wait>,
+    slontia::internal::shared_mutex<std::atomic<uint32_t>, slontia::compact_layout, slontia::adaptive_spin_wait<>>,
+    slontia::internal::shared_mutex<wakeup_counting_atomic<std::atomic<uint32_t>>>,
+    slontia::internal::shared_timed_mutex<wakeup_counting_atomic<slontia::internal::timed_atomic_uint32_t>,
+        slontia::compact_layout, slontia::spin_wait<>, slontia::notify_always>,
+    slontia::internal::shared_timed_mutex<wakeup_counting_atomic<slontia::internal::timed_atomic_uint32_t>,
+        slontia::compact_layout, slontia::spin_wait<>, slontia::notify_parked>,
+    slontia::internal::packed_shared_mutex<wakeup_counting_atomic<std::atomic<uint32_t>>>,
+    slontia::internal::shared_mutex<std::atomic<uint32_t>, slontia::compact_layout, slontia::spin_wait<>,
+        slontia::notify_always, slontia::writer_preferring, slontia::no_stats, slontia::writer_handoff>,
+    slontia::internal::shared_timed_mutex<wakeup_counting_atomic<slontia::internal::timed_atomic_uint32_t>,
+        slontia::compact_layout, slontia::spin_wait<>, slontia::notify_parked, slontia::writer_preferring,
+        slontia::no_stats, slontia::writer_handoff>,
+    slontia::read_mostly_shared_mutex, slontia::fair_shared_mutex, slontia::write_heavy_shared_mutex,
+    slontia::instrumented_shared_timed_mutex>;
 
 TYPED_TEST_SUITE(benchmark, shared_mutexes);
 
@@ -228,10 +486,251 @@ TYPED_TEST(benchmark, main)
                 [](uint32_t sum, const thread_group& group) { return sum + group.actual_operate_count(); }));
 }
 
+template <typename SharedMutex>
+class transfer_benchmark : public testing::Test
+{
+  protected:
+    using wrapper_type = slontia::mutex_protect_wrapper<uint64_t, SharedMutex>;
+
+    static constexpr uint64_t k_initial_value = 1000000;
+
+    // Picks two different wrappers randomly.
+    std::pair<wrapper_type&, wrapper_type&> pick_wrappers_() const
+    {
+        thread_local std::minstd_rand engine{std::random_device{}()};
+        const auto from = engine() % FLAGS_transfer_wrapper_num;
+        const auto to = (from + 1 + engine() % (FLAGS_transfer_wrapper_num - 1)) % FLAGS_transfer_wrapper_num;
+        return {wrappers_[from], wrappers_[to]};
+    }
+
+    // Runs `transfer_fn` by `FLAGS_transfer_threads` threads and checks that the total value is unchanged.
+    void run_(const char* const name, const auto transfer_fn)
+    {
+        std::latch latch{FLAGS_transfer_threads};
+        thread_group group{name, FLAGS_transfer_threads, latch, [&]
+            {
+                auto [from, to] = pick_wrappers_();
+                transfer_fn(from, to);
+                return true;
+            }};
+        group.print_result();
+        EXPECT_EQ(k_initial_value * FLAGS_transfer_wrapper_num,
+                std::accumulate(wrappers_.get(), wrappers_.get() + FLAGS_transfer_wrapper_num, uint64_t{0},
+                    [](const uint64_t sum, wrapper_type& wrapper) { return sum + *wrapper.lock_shared(); }));
+    }
+
+    const std::unique_ptr<wrapper_type[]> wrappers_ = [&]
+        {
+            auto wrappers = std::make_unique<wrapper_type[]>(FLAGS_transfer_wrapper_num);
+            for (uint32_t i = 0; i < FLAGS_transfer_wrapper_num; ++i) {
+                *wrappers[i].lock() = k_initial_value;
+            }
+            return wrappers;
+        }();
+};
+
+using transfer_shared_mutexes = testing::Types<slontia::shared_mutex, std::shared_mutex, slontia::shared_timed_mutex,
+      slontia::packed_shared_mutex>;
+
+TYPED_TEST_SUITE(transfer_benchmark, transfer_shared_mutexes);
+
+// Transfers between two wrappers which are locked in order of their indexes, which is the common practice to avoid
+// deadlock without `slontia::lock_all`.
+TYPED_TEST(transfer_benchmark, ordered_lock)
+{
+    ASSERT_GE(FLAGS_transfer_wrapper_num, 2);
+    this->run_("transfer by ordered locks", [&](auto& from, auto& to)
+        {
+            const bool in_order = &from < &to;
+            auto first = (in_order ? from : to).lock();
+            auto second = (in_order ? to : from).lock();
+            --*(in_order ? first : second);
+            ++*(in_order ? second : first);
+        });
+}
+
+TYPED_TEST(transfer_benchmark, lock_all)
+{
+    ASSERT_GE(FLAGS_transfer_wrapper_num, 2);
+    this->run_("transfer by lock_all", [&](auto& from, auto& to)
+        {
+            auto [from_ptr, to_ptr] = slontia::lock_all(from.lock_request(), to.lock_request());
+            --*from_ptr;
+            ++*to_ptr;
+        });
+}
+
+// Looks up random keys of a map by 1, 2, 4, ... `FLAGS_max_lookup_threads` threads. `lock_shared` locks the map
+// containing the key in shared mode.
+static void lookup_map(const auto lock_shared)
+{
+    for (uint32_t thread_num = 1; thread_num <= FLAGS_max_lookup_threads; thread_num *= 2) {
+        std::latch latch{thread_num};
+        thread_group group{"lookup", thread_num, latch, [&]
+            {
+                thread_local std::minstd_rand engine{std::random_device{}()};
+                const uint32_t key = engine() % FLAGS_lookup_key_num;
+                return lock_shared(key)->at(key) == key;
+            }};
+        group.print_result();
+        EXPECT_EQ(thread_num * FLAGS_operation_num, group.actual_operate_count());
+    }
+}
+
+TEST(lookup_benchmark, single_wrapper)
+{
+    slontia::mutex_protect_wrapper<std::unordered_map<uint32_t, uint32_t>, slontia::shared_mutex> map;
+    for (uint32_t i = 0; i < FLAGS_lookup_key_num; ++i) {
+        map.lock()->emplace(i, i);
+    }
+    lookup_map([&](uint32_t) { return map.lock_shared(); });
+}
+
+TEST(lookup_benchmark, sharded_wrapper)
+{
+    slontia::sharded_wrapper<std::unordered_map<uint32_t, uint32_t>, slontia::shared_mutex> map;
+    for (uint32_t i = 0; i < FLAGS_lookup_key_num; ++i) {
+        map.lock(i)->emplace(i, i);
+    }
+    lookup_map([&](const uint32_t key) { return map.lock_shared(key); });
+}
+
+// Writes the object by `with_lock` with `FLAGS_with_lock_threads` threads. The baseline is `locked_write`, which is the
+// same as `write_object`.
+template <typename Write>
+static void write_object_with_lock(const char* const name)
+{
+    slontia::mutex_protect_wrapper<object, slontia::shared_mutex, slontia::locked_read, Write> obj;
+    std::latch latch{FLAGS_with_lock_threads};
+    thread_group group{name, FLAGS_with_lock_threads, latch, [&]
+        {
+            obj.with_lock(&object::write);
+            return true;
+        }};
+    group.print_result();
+    EXPECT_EQ(FLAGS_with_lock_threads * FLAGS_operation_num, obj.lock()->read());
+}
+
+TEST(with_lock_benchmark, locked_write)
+{
+    write_object_with_lock<slontia::locked_write>("write by with_lock");
+}
+
+TEST(with_lock_benchmark, combining_write)
+{
+    write_object_with_lock<slontia::combining_write<>>("write by combining with_lock");
+}
+
+// Returns the CPUs of each NUMA node, which are read from sysfs. If the topology is unknown, returns one node without
+// CPUs.
+static std::vector<std::vector<uint32_t>> numa_node_cpus()
+{
+    std::vector<std::vector<uint32_t>> nodes;
+#ifdef __linux__
+    for (uint32_t node = 0; ; ++node) {
+        std::ifstream cpu_list{"/sys/devices/system/node/node" + std::to_string(node) + "/cpulist"};
+        if (!cpu_list) {
+            break;
+        }
+        auto& cpus = nodes.emplace_back();
+        // The CPU list is like "0-15,32-47".
+        for (std::string range; std::getline(cpu_list, range, ','); ) {
+            if (range.empty() || !std::isdigit(static_cast<unsigned char>(range[0]))) {
+                continue;
+            }
+            const auto dash_pos = range.find('-');
+            const auto first = static_cast<uint32_t>(std::stoul(range));
+            const auto last = dash_pos == std::string::npos ? first :
+                static_cast<uint32_t>(std::stoul(range.substr(dash_pos + 1)));
+            for (uint32_t cpu = first; cpu <= last; ++cpu) {
+                cpus.emplace_back(cpu);
+            }
+        }
+    }
+#endif
+    if (nodes.empty()) {
+        nodes.emplace_back();
+    }
+    return nodes;
+}
+
+// Pins the current thread to the CPUs of `node`, and tells `slontia::cohort_shared_mutex` the node of the thread.
+static void pin_this_thread_to_numa_node(const std::vector<uint32_t>& cpus, const uint32_t node)
+{
+#ifdef __linux__
+    if (!cpus.empty()) {
+        cpu_set_t cpu_set;
+        CPU_ZERO(&cpu_set);
+        for (const uint32_t cpu : cpus) {
+            CPU_SET(cpu, &cpu_set);
+        }
+        sched_setaffinity(0, sizeof(cpu_set), &cpu_set);
+    }
+#endif
+    slontia::set_this_thread_numa_node(node);
+}
+
+template <typename SharedMutex>
+class numa_benchmark : public testing::Test
+{
+  protected:
+    slontia::mutex_protect_wrapper<object, SharedMutex> obj_;
+};
+
+using numa_shared_mutexes = testing::Types<slontia::shared_mutex, slontia::padded_shared_mutex,
+      slontia::sharded_shared_mutex<>, slontia::cohort_shared_mutex<>>;
+
+TYPED_TEST_SUITE(numa_benchmark, numa_shared_mutexes);
+
+// Reads and writes the object by threads which are pinned to the NUMA nodes in turn, so the writers on each node
+// contend with the writers on other nodes.
+TYPED_TEST(numa_benchmark, main)
+{
+    const auto nodes = numa_node_cpus();
+    std::cout << "NUMA nodes: " << nodes.size() << "\n";
+    std::atomic<uint32_t> next_node{0};
+    const auto pinned = [&](const auto task)
+        {
+            return [&, task]
+                {
+                    thread_local const bool is_pinned = [&]
+                        {
+                            const auto node = next_node.fetch_add(1) % nodes.size();
+                            pin_this_thread_to_numa_node(nodes[node], node);
+                            return true;
+                        }();
+                    static_cast<void>(is_pinned);
+                    return task();
+                };
+        };
+
+    std::latch latch{FLAGS_numa_read_threads + FLAGS_numa_write_threads};
+    std::vector<thread_group> thread_groups;
+    if (FLAGS_numa_read_threads > 0) {
+        thread_groups.emplace_back("read", FLAGS_numa_read_threads, latch,
+                pinned([&] { return read_object(this->obj_); }));
+    }
+    if (FLAGS_numa_write_threads > 0) {
+        thread_groups.emplace_back("write", FLAGS_numa_write_threads, latch,
+                pinned([&] { return write_object(this->obj_); }));
+    }
+    std::ranges::for_each(thread_groups, &thread_group::print_result);
+    std::cout << "\n";
+
+    EXPECT_EQ(FLAGS_numa_write_threads * FLAGS_operation_num, this->obj_.lock()->read());
+}
+
 int main(int argc, char** argv)
 {
   testing::InitGoogleTest(&argc, argv);
   gflags::ParseCommandLineFlags(&argc, &argv, true);
-  return RUN_ALL_TESTS();
+  const int ret = RUN_ALL_TESTS();
+  if (!FLAGS_json_output.empty()) {
+    result_recorder::instance().write_json(FLAGS_json_output);
+  }
+  if (!FLAGS_csv_output.empty()) {
+    result_recorder::instance().write_csv(FLAGS_csv_output);
+  }
+  return ret;
 }
 
@@ -0,0 +1,323 @@
+// Copyright (c) 2024, Chang Liu <github.com/slontia>. All rights reserved.
+//
+// This source code is licensed under MIT (found in the LICENSE file).
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <numeric>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// The `latency_histogram` class counts the latency of operations in logarithmic buckets like HDR histograms. Each range
+// from (1 << i) to (1 << (i + 1)) nanoseconds is divided into `k_sub_bucket_num` linear sub-buckets, so the percentiles
+// are accurate to 1 / `k_sub_bucket_num` of the value. The maximum latency is recorded exactly.
+class latency_histogram
+{
+  public:
+    void record(const std::chrono::nanoseconds latency)
+    {
+        const auto value = static_cast<uint64_t>(std::max<int64_t>(latency.count(), 0));
+        ++bucket_counts_[std::min(bucket_index_(value), k_bucket_num - 1)];
+        max_ = std::max(max_, value);
+    }
+
+    latency_histogram& operator+=(const latency_histogram& o)
+    {
+        for (std::size_t i = 0; i < k_bucket_num; ++i) {
+            bucket_counts_[i] += o.bucket_counts_[i];
+        }
+        max_ = std::max(max_, o.max_);
+        return *this;
+    }
+
+    uint64_t count() const { return std::accumulate(bucket_counts_.begin(), bucket_counts_.end(), uint64_t{0}); }
+
+    // Returns the upper bound of the bucket where the `percent`% operation is, or the maximum latency if `percent` is
+    // 100.
+    std::chrono::nanoseconds percentile(const double percent) const
+    {
+        const auto total_count = count();
+        if (total_count == 0 || percent >= 100) {
+            return max();
+        }
+        const auto rank = std::min(static_cast<uint64_t>(total_count * percent / 100), total_count - 1);
+        uint64_t count = 0;
+        for (std::size_t i = 0; i < k_bucket_num; ++i) {
+            if ((count += bucket_counts_[i]) > rank) {
+                return std::chrono::nanoseconds{std::min(bucket_upper_bound_(i), max_)};
+            }
+        }
+        return max();
+    }
+
+    std::chrono::nanoseconds max() const { return std::chrono::nanoseconds{max_}; }
+
+  private:
+    static constexpr std::size_t k_sub_bucket_bits = 3;
+    static constexpr std::size_t k_sub_bucket_num = 1 << k_sub_bucket_bits;
+
+    // The buckets cover the latency up to about 2^40 nanoseconds (18 minutes).
+    static constexpr std::size_t k_bucket_num = (40 - k_sub_bucket_bits + 1) * k_sub_bucket_num;
+
+    // The values less than `k_sub_bucket_num` are counted in individual buckets, and the value in the range from
+    // (1 << e) to (1 << (e + 1)) is counted in the sub-bucket decided by the `k_sub_bucket_bits` bits following the
+    // highest bit.
+    static std::size_t bucket_index_(const uint64_t value)
+    {
+        if (value < k_sub_bucket_num) {
+            return value;
+        }
+        const std::size_t shift = std::bit_width(value) - 1 - k_sub_bucket_bits;
+        return (shift + 1) * k_sub_bucket_num + ((value >> shift) - k_sub_bucket_num);
+    }
+
+    static uint64_t bucket_upper_bound_(const std::size_t index)
+    {
+        if (index < k_sub_bucket_num) {
+            return index + 1;
+        }
+        const std::size_t shift = index / k_sub_bucket_num - 1;
+        return (k_sub_bucket_num + index % k_sub_bucket_num + 1) << shift;
+    }
+
+    std::array<uint64_t, k_bucket_num> bucket_counts_{};
+    uint64_t max_{0};
+};
+
+// The `perf_counters` class counts the hardware and software events of the calling thread by `perf_event_open` on
+// Linux. The events which cannot be opened (e.g. restricted by `/proc/sys/kernel/perf_event_paranoid`, unsupported by
+// the processor or the virtual machine) are unavailable, and no events are available on other platforms.
+// - `k_llc_misses` counts the read misses of the last level cache;
+// - `k_hitm` counts the raw event `hitm_config` if it is not 0. The loads hitting a modified cache line in another core
+//   (HITM) reflect the coherence traffic, but the event code is model-specific, e.g. 0x4d2
+//   (`MEM_LOAD_L3_HIT_RETIRED.XSNP_HITM`) on Intel Skylake;
+// - `k_futex_calls` counts the `SYS_futex` system calls by the tracepoint `syscalls:sys_enter_futex`, including the ones
+//   issued by `std::atomic::wait` and `std::shared_mutex`.
+class perf_counters
+{
+  public:
+    enum event { k_cycles, k_instructions, k_llc_misses, k_hitm, k_context_switches, k_futex_calls, k_event_num };
+
+    static constexpr std::array<const char*, k_event_num> k_event_names{
+        "cycles", "instructions", "llc_misses", "hitm", "context_switches", "futex_calls"};
+
+    explicit perf_counters(const uint64_t hitm_config)
+    {
+#ifdef __linux__
+        open_(k_cycles, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+        open_(k_instructions, PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+        open_(k_llc_misses, PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+        if (hitm_config != 0) {
+            open_(k_hitm, PERF_TYPE_RAW, hitm_config);
+        }
+        open_(k_context_switches, PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES);
+        if (const auto id = futex_tracepoint_id_()) {
+            open_(k_futex_calls, PERF_TYPE_TRACEPOINT, *id);
+        }
+#endif
+    }
+
+    perf_counters(const perf_counters&) = delete;
+    perf_counters& operator=(const perf_counters&) = delete;
+
+    ~perf_counters()
+    {
+#ifdef __linux__
+        for (const int fd : fds_) {
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+#endif
+    }
+
+    // Resets and starts counting the available events.
+    void start()
+    {
+#ifdef __linux__
+        for (const int fd : fds_) {
+            if (fd >= 0) {
+                ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+                ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+            }
+        }
+#endif
+    }
+
+    // Stops counting, and returns the counts of the events, which are empty for the unavailable ones.
+    std::array<std::optional<uint64_t>, k_event_num> stop()
+    {
+        std::array<std::optional<uint64_t>, k_event_num> counts{};
+#ifdef __linux__
+        for (std::size_t i = 0; i < k_event_num; ++i) {
+            uint64_t count = 0;
+            if (fds_[i] >= 0 && ioctl(fds_[i], PERF_EVENT_IOC_DISABLE, 0) == 0 &&
+                    read(fds_[i], &count, sizeof(count)) == sizeof(count)) {
+                counts[i] = count;
+            }
+        }
+#endif
+        return counts;
+    }
+
+  private:
+#ifdef __linux__
+    void open_(const event event, const uint32_t type, const uint64_t config)
+    {
+        perf_event_attr attr{};
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.disabled = 1;
+        // Count the events in the kernel as well, e.g. the cycles spent in the futex system calls, unless it is not
+        // permitted.
+        for (const bool exclude_kernel : {false, true}) {
+            attr.exclude_kernel = exclude_kernel;
+            attr.exclude_hv = exclude_kernel;
+            if ((fds_[event] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0)) >= 0) {
+                return;
+            }
+        }
+    }
+
+    static std::optional<uint64_t> futex_tracepoint_id_()
+    {
+        for (const char* const path : {"/sys/kernel/tracing/events/syscalls/sys_enter_futex/id",
+                "/sys/kernel/debug/tracing/events/syscalls/sys_enter_futex/id"}) {
+            uint64_t id = 0;
+            if (std::ifstream{path} >> id) {
+                return id;
+            }
+        }
+        return std::nullopt;
+    }
+
+    std::array<int, k_event_num> fds_ = [] { std::array<int, k_event_num> fds; fds.fill(-1); return fds; }();
+#endif
+};
+
+// The result of a group of threads running the same operations, which is written to `--json_output` and `--csv_output` to
+// track the regressions between versions.
+struct group_result
+{
+    std::string benchmark_;
+    std::string mutex_;
+    std::string group_;
+    uint32_t thread_num_;
+    uint64_t operation_num_;
+    uint64_t success_count_;
+    double duration_ms_;
+    double throughput_;
+    latency_histogram latency_histogram_;
+
+    // The average counts of the events for each successful acquisition, which are empty if the events are not counted.
+    std::array<std::optional<double>, perf_counters::k_event_num> perf_counts_per_acquisition_{};
+};
+
+// Collects the results of all groups, and writes them to the output files when the benchmarks finish.
+class result_recorder
+{
+  public:
+    static result_recorder& instance()
+    {
+        static result_recorder recorder;
+        return recorder;
+    }
+
+    void add(group_result result) { results_.emplace_back(std::move(result)); }
+
+    void write_json(const std::string& path) const
+    {
+        std::ofstream out{path};
+        out << "[";
+        for (std::size_t i = 0; i < results_.size(); ++i) {
+            const auto& result = results_[i];
+            out << (i == 0 ? "\n" : ",\n") << "  {\"benchmark\": " << json_string_(result.benchmark_)
+                << ", \"mutex\": " << json_string_(result.mutex_) << ", \"group\": " << json_string_(result.group_)
+                << ", \"threads\": " << result.thread_num_ << ", \"operations\": " << result.operation_num_
+                << ", \"successes\": " << result.success_count_ << ", \"duration_ms\": " << result.duration_ms_
+                << ", \"throughput\": " << result.throughput_;
+            for (const auto& [name, percent] : k_percentiles) {
+                out << ", \"" << name << "_ns\": " << result.latency_histogram_.percentile(percent).count();
+            }
+            for (std::size_t event_index = 0; event_index < perf_counters::k_event_num; ++event_index) {
+                if (const auto count = result.perf_counts_per_acquisition_[event_index]) {
+                    out << ", \"" << perf_counters::k_event_names[event_index] << "_per_acquisition\": " << *count;
+                }
+            }
+            out << "}";
+        }
+        out << "\n]\n";
+    }
+
+    void write_csv(const std::string& path) const
+    {
+        std::ofstream out{path};
+        out << "benchmark,mutex,group,threads,operations,successes,duration_ms,throughput";
+        for (const auto& [name, percent] : k_percentiles) {
+            out << "," << name << "_ns";
+        }
+        for (const char* const name : perf_counters::k_event_names) {
+            out << "," << name << "_per_acquisition";
+        }
+        out << "\n";
+        for (const auto& result : results_) {
+            out << csv_string_(result.benchmark_) << "," << csv_string_(result.mutex_) << ","
+                << csv_string_(result.group_) << "," << result.thread_num_ << "," << result.operation_num_ << ","
+                << result.success_count_ << "," << result.duration_ms_ << "," << result.throughput_;
+            for (const auto& [name, percent] : k_percentiles) {
+                out << "," << result.latency_histogram_.percentile(percent).count();
+            }
+            for (const auto& count : result.perf_counts_per_acquisition_) {
+                out << ",";
+                if (count) {
+                    out << *count;
+                }
+            }
+            out << "\n";
+        }
+    }
+
+  private:
+    static constexpr std::array<std::pair<const char*, double>, 5> k_percentiles{
+        {{"p50", 50.0}, {"p90", 90.0}, {"p99", 99.0}, {"p999", 99.9}, {"max", 100.0}}};
+
+    static std::string json_string_(const std::string& str)
+    {
+        std::string quoted = "\"";
+        for (const char c : str) {
+            if (c == '"' || c == '\\') {
+                quoted += '\\';
+            }
+            quoted += c;
+        }
+        return quoted + "\"";
+    }
+
+    static std::string csv_string_(const std::string& str)
+    {
+        std::string quoted = "\"";
+        for (const char c : str) {
+            quoted += c == '"' ? "\"\"" : std::string(1, c);
+        }
+        return quoted + "\"";
+    }
+
+    std::vector<group_result> results_;
+};
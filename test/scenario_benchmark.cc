@@ -0,0 +1,288 @@
+// Copyright (c) 2024, Chang Liu <github.com/slontia>. All rights reserved.
+//
+// This source code is licensed under MIT (found in the LICENSE file).
+
+#include "shared_mutex.h"
+#include "sharded_shared_mutex.h"
+#include "packed_shared_mutex.h"
+#include "cohort_shared_mutex.h"
+
+#include "benchmark_util.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <latch>
+#include <mutex>
+#include <random>
+#include <shared_mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <gflags/gflags.h>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+DEFINE_string(read_percents, "100,95,90,75,50", "Comma-separated percentages of reads among the operations");
+DEFINE_string(critical_sections, "empty,100ns,1us,cache_lines",
+        "Comma-separated kinds of critical sections: empty, 100ns, 1us or cache_lines");
+DEFINE_uint32(touched_cache_lines, 16, "Number of cache lines touched by the cache_lines critical section");
+DEFINE_uint32(max_threads, 0, "Maximum number of threads, doubled from 1. The default is twice the number of cores");
+DEFINE_bool(pin_threads, false, "Pin the i-th thread to the i-th core in turn");
+DEFINE_uint32(arrival_rate, 0,
+        "Operations per second issued by each thread regardless of the completion (open loop), or 0 for closed loop");
+DEFINE_uint32(scenario_operation_num, 2000, "Number of operations for each thread in each scenario");
+DEFINE_string(json_output, "", "Path of the JSON file to write the results of all scenarios");
+DEFINE_string(csv_output, "", "Path of the CSV file to write the results of all scenarios");
+
+// The kinds of critical sections. `k_delay_100ns` and `k_delay_1us` spin for the time while holding the mutex, and
+// `k_cache_lines` reads or writes `--touched_cache_lines` cache lines.
+enum class critical_section { k_empty, k_delay_100ns, k_delay_1us, k_cache_lines };
+
+static std::vector<std::string> split(const std::string& str)
+{
+    std::vector<std::string> items;
+    std::istringstream stream{str};
+    for (std::string item; std::getline(stream, item, ',');) {
+        if (!item.empty()) {
+            items.emplace_back(item);
+        }
+    }
+    return items;
+}
+
+static std::vector<uint32_t> read_percents()
+{
+    std::vector<uint32_t> percents;
+    for (const auto& item : split(FLAGS_read_percents)) {
+        percents.emplace_back(std::min<uint32_t>(std::stoul(item), 100));
+    }
+    return percents;
+}
+
+static std::vector<std::pair<std::string, critical_section>> critical_sections()
+{
+    std::vector<std::pair<std::string, critical_section>> sections;
+    for (const auto& item : split(FLAGS_critical_sections)) {
+        if (item == "empty") {
+            sections.emplace_back(item, critical_section::k_empty);
+        } else if (item == "100ns") {
+            sections.emplace_back(item, critical_section::k_delay_100ns);
+        } else if (item == "1us") {
+            sections.emplace_back(item, critical_section::k_delay_1us);
+        } else if (item == "cache_lines") {
+            sections.emplace_back(std::to_string(FLAGS_touched_cache_lines) + " cache lines",
+                    critical_section::k_cache_lines);
+        } else {
+            ADD_FAILURE() << "unknown critical section: " << item;
+        }
+    }
+    return sections;
+}
+
+// Returns 1, 2, 4, ... up to `--max_threads`, which is twice the number of cores by default.
+static std::vector<uint32_t> thread_nums()
+{
+    const uint32_t max_thread_num =
+        FLAGS_max_threads > 0 ? FLAGS_max_threads : std::max(std::thread::hardware_concurrency(), 1u) * 2;
+    std::vector<uint32_t> nums;
+    for (uint32_t num = 1; num < max_thread_num; num *= 2) {
+        nums.emplace_back(num);
+    }
+    nums.emplace_back(max_thread_num);
+    return nums;
+}
+
+static void pin_this_thread_to_core(const uint32_t index)
+{
+#ifdef __linux__
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(index % std::max(std::thread::hardware_concurrency(), 1u), &cpus);
+    sched_setaffinity(0, sizeof(cpus), &cpus);
+#endif
+}
+
+static void spin_for(const std::chrono::nanoseconds duration)
+{
+    const auto end_ts = std::chrono::steady_clock::now() + duration;
+    while (std::chrono::steady_clock::now() < end_ts) {
+    }
+}
+
+// The object protected by the mutex. Each writer increases the counters of the touched cache lines by one, so the
+// counters of the touched cache lines are always equal to each other for readers.
+class object
+{
+  public:
+    explicit object(const uint32_t cache_line_num) : lines_(std::max<uint32_t>(cache_line_num, 1)) {}
+
+    void read(const critical_section section) const
+    {
+        const auto line_num = touched_line_num_(section);
+        const auto value = lines_[0].value_;
+        for (std::size_t i = 1; i < line_num; ++i) {
+            EXPECT_EQ(value, lines_[i].value_);
+        }
+        delay_(section);
+    }
+
+    void write(const critical_section section)
+    {
+        const auto line_num = touched_line_num_(section);
+        for (std::size_t i = 0; i < line_num; ++i) {
+            ++lines_[i].value_;
+        }
+        delay_(section);
+    }
+
+    uint64_t write_count() const { return lines_[0].value_; }
+
+  private:
+    struct alignas(slontia::internal::k_cache_line_size) cache_line
+    {
+        uint64_t value_{0};
+    };
+
+    std::size_t touched_line_num_(const critical_section section) const
+    {
+        return section == critical_section::k_cache_lines ? lines_.size() : 1;
+    }
+
+    static void delay_(const critical_section section)
+    {
+        if (section == critical_section::k_delay_100ns) {
+            spin_for(std::chrono::nanoseconds{100});
+        } else if (section == critical_section::k_delay_1us) {
+            spin_for(std::chrono::microseconds{1});
+        }
+    }
+
+    std::vector<cache_line> lines_;
+};
+
+template <typename SharedMutex>
+class scenario_benchmark : public testing::Test
+{
+  protected:
+    // Runs `thread_num` threads which read the object with the probability of `read_percent`% and write it otherwise,
+    // and records the throughput and the latency of acquisitions. In the open loop, the latency is measured from the
+    // time the operation is scheduled to issue, so the delay of the following operations is not hidden.
+    void run_(const uint32_t read_percent, const std::string& section_name, const critical_section section,
+            const uint32_t thread_num)
+    {
+        SharedMutex mutex;
+        object obj{FLAGS_touched_cache_lines};
+        std::vector<latency_histogram> histograms(thread_num);
+        std::vector<std::chrono::nanoseconds> durations(thread_num);
+        std::atomic<uint64_t> write_count{0};
+        std::latch latch{thread_num};
+        {
+            std::vector<std::jthread> threads;
+            for (uint32_t i = 0; i < thread_num; ++i) {
+                threads.emplace_back([&, i]
+                    {
+                        if (FLAGS_pin_threads) {
+                            pin_this_thread_to_core(i);
+                        }
+                        std::minstd_rand engine{i + 1};
+                        uint64_t local_write_count = 0;
+                        const auto interval = FLAGS_arrival_rate > 0 ?
+                            std::chrono::nanoseconds{1000000000 / FLAGS_arrival_rate} : std::chrono::nanoseconds{0};
+                        latch.arrive_and_wait();
+                        const auto start_ts = std::chrono::steady_clock::now();
+                        for (uint32_t j = 0; j < FLAGS_scenario_operation_num; ++j) {
+                            auto operation_start_ts = std::chrono::steady_clock::now();
+                            if (FLAGS_arrival_rate > 0) {
+                                operation_start_ts = start_ts + interval * j;
+                                while (std::chrono::steady_clock::now() < operation_start_ts) {
+                                    std::this_thread::yield();
+                                }
+                            }
+                            if (engine() % 100 < read_percent) {
+                                std::shared_lock lock{mutex};
+                                histograms[i].record(std::chrono::steady_clock::now() - operation_start_ts);
+                                obj.read(section);
+                            } else {
+                                std::unique_lock lock{mutex};
+                                histograms[i].record(std::chrono::steady_clock::now() - operation_start_ts);
+                                obj.write(section);
+                                ++local_write_count;
+                            }
+                        }
+                        durations[i] = std::chrono::steady_clock::now() - start_ts;
+                        write_count += local_write_count;
+                    });
+            }
+        }
+        EXPECT_EQ(write_count, obj.write_count());
+
+        latency_histogram histogram;
+        for (const auto& thread_histogram : histograms) {
+            histogram += thread_histogram;
+        }
+        const auto duration = *std::max_element(durations.begin(), durations.end());
+        const uint64_t operation_num = static_cast<uint64_t>(FLAGS_scenario_operation_num) * thread_num;
+        const double throughput = duration.count() > 0 ? operation_num * 1e9 / duration.count() : 0;
+        const std::string scenario = std::to_string(read_percent) + "% reads, " + section_name + ", " +
+            std::to_string(thread_num) + " threads";
+        std::cout << scenario << "\t[throughput] " << throughput << " ops/s\t[latency] 50%: <"
+            << histogram.percentile(50).count() << "ns, 99%: <" << histogram.percentile(99).count() << "ns, 99.9%: <"
+            << histogram.percentile(99.9).count() << "ns, max: " << histogram.max().count() << "ns\n";
+
+        const auto* const test_info = testing::UnitTest::GetInstance()->current_test_info();
+        result_recorder::instance().add(group_result{
+                .benchmark_ = std::string{test_info->test_suite_name()} + "." + test_info->name(),
+                .mutex_ = test_info->type_param() ? test_info->type_param() : "",
+                .group_ = scenario,
+                .thread_num_ = thread_num,
+                .operation_num_ = operation_num,
+                .success_count_ = operation_num,
+                .duration_ms_ = static_cast<double>(duration.count()) / 1000000,
+                .throughput_ = throughput,
+                .latency_histogram_ = histogram});
+    }
+};
+
+using scenario_shared_mutexes = testing::Types<
+    slontia::shared_mutex, slontia::shared_timed_mutex, std::shared_mutex, std::shared_timed_mutex,
+    slontia::padded_shared_mutex, slontia::sharded_shared_mutex<>, slontia::packed_shared_mutex,
+    slontia::cohort_shared_mutex<>,
+    slontia::internal::shared_mutex<std::atomic<uint32_t>, slontia::compact_layout, slontia::spin_wait<>,
+        slontia::notify_always, slontia::phase_fair>,
+    slontia::internal::shared_mutex<std::atomic<uint32_t>, slontia::compact_layout, slontia::spin_wait<>,
+        slontia::notify_always, slontia::writer_preferring, slontia::no_stats, slontia::writer_handoff>>;
+
+TYPED_TEST_SUITE(scenario_benchmark, scenario_shared_mutexes);
+
+// Sweeps the read ratios, the critical sections and the thread numbers.
+TYPED_TEST(scenario_benchmark, matrix)
+{
+    for (const auto read_percent : read_percents()) {
+        for (const auto& [section_name, section] : critical_sections()) {
+            for (const auto thread_num : thread_nums()) {
+                this->run_(read_percent, section_name, section, thread_num);
+            }
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  const int ret = RUN_ALL_TESTS();
+  if (!FLAGS_json_output.empty()) {
+    result_recorder::instance().write_json(FLAGS_json_output);
+  }
+  if (!FLAGS_csv_output.empty()) {
+    result_recorder::instance().write_csv(FLAGS_csv_output);
+  }
+  return ret;
+}
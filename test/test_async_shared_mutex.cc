@@ -0,0 +1,226 @@
+// Copyright (c) 2024, Chang Liu <github.com/slontia>. All rights reserved.
+//
+// This source code is licensed under MIT (found in the LICENSE file).
+
+#include "async_shared_mutex.h"
+#include "mutex_protect_wrapper.h"
+
+#include <gtest/gtest.h>
+#include <gflags/gflags.h>
+
+#include <atomic>
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+// The executor which queues the coroutines to resume until `run` is invoked.
+class queue_executor
+{
+  public:
+    void schedule(const std::coroutine_handle<> handle)
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        handles_.emplace_back(handle);
+    }
+
+    // Resumes the queued coroutines until there are none. Returns the number of resumed coroutines.
+    std::size_t run()
+    {
+        std::size_t resumed_num = 0;
+        while (const auto handle = pop_()) {
+            handle.resume();
+            ++resumed_num;
+        }
+        return resumed_num;
+    }
+
+  private:
+    std::coroutine_handle<> pop_()
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        if (handles_.empty()) {
+            return nullptr;
+        }
+        const auto handle = handles_.front();
+        handles_.pop_front();
+        return handle;
+    }
+
+    std::mutex mutex_;
+    std::deque<std::coroutine_handle<>> handles_;
+};
+
+// The coroutine which starts eagerly and destroys itself when it finishes.
+struct detached_task
+{
+    struct promise_type
+    {
+        detached_task get_return_object() noexcept { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() noexcept {}
+        void unhandled_exception() noexcept { std::terminate(); }
+    };
+};
+
+using async_shared_mutex = slontia::async_shared_mutex<queue_executor>;
+
+struct test_async_shared_mutex : public testing::Test
+{
+    queue_executor executor_;
+    async_shared_mutex mutex_{executor_};
+};
+
+TEST_F(test_async_shared_mutex, lock_suspends_until_unlocked)
+{
+    bool locked_1 = false;
+    bool locked_2 = false;
+    [&]() -> detached_task
+    {
+        co_await mutex_.lock();
+        locked_1 = true;
+    }();
+    [&]() -> detached_task
+    {
+        co_await mutex_.lock();
+        locked_2 = true;
+        mutex_.unlock();
+    }();
+    ASSERT_TRUE(locked_1);
+    ASSERT_FALSE(locked_2);
+    ASSERT_FALSE(mutex_.try_lock_shared());
+    mutex_.unlock();
+    // The coroutine is resumed by the executor rather than inline.
+    ASSERT_FALSE(locked_2);
+    ASSERT_EQ(1, executor_.run());
+    ASSERT_TRUE(locked_2);
+    ASSERT_TRUE(mutex_.try_lock());
+}
+
+TEST_F(test_async_shared_mutex, readers_are_granted_together)
+{
+    ASSERT_TRUE(mutex_.try_lock());
+    int reader_num = 0;
+    for (int i = 0; i < 3; ++i) {
+        [&]() -> detached_task
+        {
+            co_await mutex_.lock_shared();
+            ++reader_num;
+        }();
+    }
+    mutex_.unlock();
+    ASSERT_EQ(3, executor_.run());
+    ASSERT_EQ(3, reader_num);
+    ASSERT_TRUE(mutex_.try_lock_shared());
+    ASSERT_FALSE(mutex_.try_lock());
+    for (int i = 0; i < 4; ++i) {
+        mutex_.unlock_shared();
+    }
+    ASSERT_TRUE(mutex_.try_lock());
+}
+
+TEST_F(test_async_shared_mutex, waiting_writer_precedes_new_readers)
+{
+    ASSERT_TRUE(mutex_.try_lock_shared());
+    std::vector<int> order;
+    [&]() -> detached_task
+    {
+        co_await mutex_.lock();
+        order.emplace_back(1);
+        mutex_.unlock();
+    }();
+    // New readers have to wait for the queued writer.
+    ASSERT_FALSE(mutex_.try_lock_shared());
+    [&]() -> detached_task
+    {
+        co_await mutex_.lock_shared();
+        order.emplace_back(2);
+        mutex_.unlock_shared();
+    }();
+    [&]() -> detached_task
+    {
+        co_await mutex_.lock();
+        order.emplace_back(3);
+        mutex_.unlock();
+    }();
+    mutex_.unlock_shared();
+    executor_.run();
+    ASSERT_EQ((std::vector<int>{1, 3, 2}), order);
+    ASSERT_TRUE(mutex_.try_lock());
+}
+
+TEST_F(test_async_shared_mutex, concurrent_coroutines)
+{
+    constexpr int k_coroutine_num = 1000;
+    int a = 0;
+    int b = 0;
+    std::atomic<int> finished_num{0};
+    std::vector<std::jthread> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([&]
+            {
+                for (int j = 0; j < k_coroutine_num; ++j) {
+                    [&]() -> detached_task
+                    {
+                        co_await mutex_.lock();
+                        ++a;
+                        ++b;
+                        mutex_.unlock();
+                        co_await mutex_.lock_shared();
+                        EXPECT_EQ(a, b);
+                        mutex_.unlock_shared();
+                        ++finished_num;
+                    }();
+                    executor_.run();
+                }
+                while (finished_num < 4 * k_coroutine_num) {
+                    executor_.run();
+                    std::this_thread::yield();
+                }
+            });
+    }
+    threads.clear();
+    ASSERT_EQ(4 * k_coroutine_num, a);
+    ASSERT_TRUE(mutex_.try_lock());
+}
+
+TEST_F(test_async_shared_mutex, wrapper_async_lock)
+{
+    slontia::mutex_protect_wrapper<int, async_shared_mutex> obj{std::piecewise_construct, std::forward_as_tuple(executor_),
+        std::make_tuple(0)};
+    std::vector<int> values;
+    std::coroutine_handle<> writer;
+    [&]() -> detached_task
+    {
+        auto locked_obj = co_await obj.async_lock();
+        static_assert(std::is_same_v<decltype(obj)::locked_ptr, decltype(locked_obj)>);
+        *locked_obj = 1;
+        // Suspend while holding the lock.
+        struct suspend_writer
+        {
+            bool await_ready() const noexcept { return false; }
+            void await_suspend(const std::coroutine_handle<> handle) noexcept { writer_ = handle; }
+            void await_resume() const noexcept {}
+            std::coroutine_handle<>& writer_;
+        };
+        co_await suspend_writer{writer};
+    }();
+    [&]() -> detached_task
+    {
+        auto locked_obj = co_await obj.async_lock_shared();
+        static_assert(std::is_same_v<decltype(obj)::shared_locked_ptr, decltype(locked_obj)>);
+        values.emplace_back(*locked_obj);
+    }();
+    ASSERT_TRUE(values.empty());
+    ASSERT_FALSE(obj.try_lock_shared());
+    // The writer releases the lock when its `locked_ptr` is destructed.
+    writer.resume();
+    ASSERT_EQ(1, executor_.run());
+    ASSERT_EQ((std::vector<int>{1}), values);
+    ASSERT_EQ(1, *obj.try_lock());
+}
@@ -3,9 +3,26 @@
 // This source code is licensed under MIT (found in the LICENSE file).
 
 #include "mutex_protect_wrapper.h"
+#include "contention_profiler.h"
+#include "cow_wrapper.h"
+#include "shared_mutex.h"
+#include "sharded_wrapper.h"
 
+#include <atomic>
 #include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
 #include <shared_mutex>
+#include <source_location>
+#include <sstream>
+#include <stdexcept>
+#include <stop_token>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 #include <gtest/gtest.h>
 #include <gflags/gflags.h>
@@ -32,6 +49,28 @@ TEST(test_lock_wrapper, type_assert)
     static_assert(std::is_same_v<const int&, decltype(*obj.try_lock_shared_until(std::chrono::system_clock::time_point{}))>);
 }
 
+TEST(test_lock_wrapper, try_lock_until_shared_deadline)
+{
+    slontia::mutex_protect_wrapper<int, slontia::shared_timed_mutex> obj;
+    slontia::mutex_protect_wrapper<int, std::shared_timed_mutex> std_obj;
+
+    const slontia::deadline deadline{std::chrono::milliseconds(10)};
+    {
+        auto locked_obj = obj.try_lock_until(deadline);
+        auto std_locked_obj = std_obj.try_lock_shared_until(deadline);
+        ASSERT_TRUE(locked_obj);
+        ASSERT_TRUE(std_locked_obj);
+        std::jthread{[&]
+            {
+                EXPECT_FALSE(obj.try_lock_shared_until(deadline));
+                EXPECT_FALSE(std_obj.try_lock_const_until(deadline));
+                EXPECT_TRUE(deadline.expired());
+            }};
+    }
+    EXPECT_TRUE(obj.try_lock_const_until(deadline));
+    EXPECT_TRUE(std_obj.try_lock_until(deadline));
+}
+
 TEST(test_lock_wrapper, try_lock_succeed)
 {
     slontia::mutex_protect_wrapper<int, std::mutex> obj;
@@ -161,3 +200,653 @@ TEST(test_lock_wrapper, shared_locked_ptr_is_copyable)
     ASSERT_TRUE(obj.try_lock());
 }
 
+TEST(test_lock_wrapper, copy_shared_locked_ptr_while_writer_waiting)
+{
+    slontia::mutex_protect_wrapper<int, slontia::shared_mutex> obj;
+
+    auto ptr = obj.lock_shared();
+    std::atomic<bool> locked{false};
+    std::jthread writer{[&]
+        {
+            *obj.lock() = 1;
+            locked = true;
+        }};
+    // The writer blocks new readers once it is waiting, but the copy only adds an ownership to the held one.
+    while (obj.try_lock_shared()) {
+        std::this_thread::yield();
+    }
+    auto ptr_2 = ptr;
+    ptr.reset();
+    EXPECT_FALSE(locked);
+    EXPECT_EQ(0, *ptr_2);
+    ptr_2.reset();
+    writer.join();
+    EXPECT_TRUE(locked);
+}
+
+
+TEST(test_lock_wrapper, upgradable_locked_ptr_coexists_with_shared_locked_ptr)
+{
+    slontia::mutex_protect_wrapper<int, slontia::shared_mutex> obj;
+
+    static_assert(std::is_same_v<const int&, decltype(*obj.lock_upgrade())>);
+    static_assert(!std::is_copy_constructible_v<decltype(obj.lock_upgrade())>);
+
+    auto ptr = obj.lock_upgrade();
+    ASSERT_TRUE(obj.try_lock_shared());
+    ASSERT_FALSE(obj.try_lock_upgrade());
+    ASSERT_FALSE(obj.try_lock());
+
+    ptr.reset();
+    ASSERT_TRUE(obj.try_lock_upgrade());
+}
+
+TEST(test_lock_wrapper, move_construct_locked_ptr_upgradable_to_mutable)
+{
+    using mutex_protect_wrapper = slontia::mutex_protect_wrapper<int, slontia::shared_mutex>;
+    mutex_protect_wrapper obj;
+
+    static_assert(std::is_constructible_v<mutex_protect_wrapper::locked_ptr, mutex_protect_wrapper::upgradable_locked_ptr&&>);
+    static_assert(!std::is_constructible_v<mutex_protect_wrapper::upgradable_locked_ptr, mutex_protect_wrapper::locked_ptr&&>);
+
+    auto ptr = obj.lock_upgrade();
+    mutex_protect_wrapper::locked_ptr ptr_2 = std::move(ptr);
+    ASSERT_FALSE(ptr);
+    *ptr_2 = 1;
+    ASSERT_FALSE(obj.try_lock_shared());
+
+    ptr_2.reset();
+    ASSERT_EQ(1, *obj.lock_shared());
+}
+
+TEST(test_lock_wrapper, move_construct_locked_ptr_unique_to_shared)
+{
+    using mutex_protect_wrapper = slontia::mutex_protect_wrapper<int, slontia::shared_mutex>;
+    mutex_protect_wrapper obj;
+
+    static_assert(std::is_constructible_v<mutex_protect_wrapper::shared_locked_ptr, mutex_protect_wrapper::locked_ptr&&>);
+    static_assert(std::is_constructible_v<mutex_protect_wrapper::shared_locked_ptr, mutex_protect_wrapper::const_locked_ptr&&>);
+    static_assert(std::is_assignable_v<mutex_protect_wrapper::shared_locked_ptr&, mutex_protect_wrapper::locked_ptr&&>);
+
+    auto ptr = obj.lock();
+    *ptr = 1;
+    mutex_protect_wrapper::shared_locked_ptr ptr_2 = std::move(ptr);
+    ASSERT_FALSE(ptr);
+    ASSERT_EQ(1, *ptr_2);
+    ASSERT_TRUE(obj.try_lock_shared());
+    ASSERT_FALSE(obj.try_lock());
+
+    ptr_2.reset();
+    mutex_protect_wrapper::shared_locked_ptr ptr_3 = obj.lock_const();
+    ASSERT_TRUE(obj.try_lock_shared());
+    ASSERT_FALSE(obj.try_lock());
+    ptr_3.reset();
+    ASSERT_TRUE(obj.try_lock());
+}
+
+TEST(test_lock_wrapper, move_construct_locked_ptr_upgradable_to_shared)
+{
+    using mutex_protect_wrapper = slontia::mutex_protect_wrapper<int, slontia::shared_mutex>;
+    mutex_protect_wrapper obj;
+
+    auto ptr = obj.lock_upgrade();
+    mutex_protect_wrapper::shared_locked_ptr ptr_2 = std::move(ptr);
+    ASSERT_FALSE(ptr);
+    ASSERT_TRUE(obj.try_lock_upgrade());
+    ASSERT_FALSE(obj.try_lock());
+}
+
+template <typename T>
+constexpr bool k_has_stats = requires(const T& obj) { obj.stats(); };
+
+TEST(test_lock_wrapper, lock_with_stop_token)
+{
+    slontia::mutex_protect_wrapper<int, slontia::shared_timed_mutex> obj;
+    std::stop_source stop_source;
+    ASSERT_TRUE(obj.lock(stop_source.get_token()));
+    ASSERT_TRUE(obj.lock_const(stop_source.get_token()));
+    auto locked_obj = obj.lock_shared(stop_source.get_token());
+    ASSERT_TRUE(locked_obj);
+    std::jthread writer{[&](const std::stop_token stop_token)
+        {
+            EXPECT_FALSE(obj.lock(stop_token));
+            EXPECT_FALSE(obj.lock_const(stop_token));
+        }};
+    writer.request_stop();
+    writer.join();
+    ASSERT_TRUE(obj.lock_shared(stop_source.get_token()));
+    locked_obj.reset();
+    stop_source.request_stop();
+    auto locked_mutable_obj = obj.lock(stop_source.get_token());
+    ASSERT_TRUE(locked_mutable_obj);
+    ASSERT_FALSE(obj.lock_shared(stop_source.get_token()));
+}
+
+TEST(test_lock_wrapper, stats)
+{
+    using mutex_type = slontia::internal::shared_mutex<std::atomic<std::uint32_t>, slontia::compact_layout,
+          slontia::spin_wait<>, slontia::notify_always, slontia::writer_preferring, slontia::lock_stats<>>;
+    using mutex_protect_wrapper = slontia::mutex_protect_wrapper<int, mutex_type>;
+    static_assert(k_has_stats<mutex_protect_wrapper>);
+    static_assert(!k_has_stats<slontia::mutex_protect_wrapper<int, slontia::shared_mutex>>);
+    mutex_protect_wrapper obj;
+
+    *obj.lock() = 1;
+    {
+        auto ptr = obj.lock_shared();
+        auto ptr_2 = ptr;
+        ASSERT_FALSE(obj.try_lock());
+    }
+    const auto stats = obj.stats();
+    ASSERT_EQ(1, stats.exclusive_.acquisition_num_);
+    // Copying a `shared_locked_ptr` acquires another shared ownership.
+    ASSERT_EQ(2, stats.shared_.acquisition_num_);
+    ASSERT_EQ(0, stats.exclusive_.timeout_num_);
+}
+
+TEST(test_lock_wrapper, lock_all_mixed_ownerships)
+{
+    slontia::mutex_protect_wrapper<int, slontia::shared_mutex> obj_1;
+    slontia::mutex_protect_wrapper<int, std::shared_mutex> obj_2;
+    slontia::mutex_protect_wrapper<int, std::mutex> obj_3;
+
+    auto [ptr_1, ptr_2, ptr_3] =
+        slontia::lock_all(obj_1.lock_request(), obj_2.lock_shared_request(), obj_3.lock_const_request());
+    static_assert(std::is_same_v<decltype(obj_1)::locked_ptr, decltype(ptr_1)>);
+    static_assert(std::is_same_v<decltype(obj_2)::shared_locked_ptr, decltype(ptr_2)>);
+    static_assert(std::is_same_v<decltype(obj_3)::const_locked_ptr, decltype(ptr_3)>);
+    *ptr_1 = 1;
+    ASSERT_FALSE(obj_1.try_lock_shared());
+    ASSERT_TRUE(obj_2.try_lock_shared());
+    ASSERT_FALSE(obj_2.try_lock());
+    ASSERT_FALSE(obj_3.try_lock());
+
+    ptr_1.reset();
+    ptr_2.reset();
+    ptr_3.reset();
+    ASSERT_EQ(1, *obj_1.try_lock());
+    ASSERT_TRUE(obj_2.try_lock());
+    ASSERT_TRUE(obj_3.try_lock());
+}
+
+TEST(test_lock_wrapper, lock_all_back_off_when_one_is_held)
+{
+    slontia::mutex_protect_wrapper<int, slontia::shared_mutex> obj_1;
+    slontia::mutex_protect_wrapper<int, slontia::shared_mutex> obj_2;
+
+    // Hold the wrapper with the higher address, so `lock_all` has to back off after locking the other one.
+    auto& held_obj = std::less<const void*>{}(&obj_1, &obj_2) ? obj_2 : obj_1;
+    auto& other_obj = &held_obj == &obj_1 ? obj_2 : obj_1;
+    auto held_ptr = held_obj.lock();
+    std::jthread thread{[&]
+        {
+            auto [ptr_1, ptr_2] = slontia::lock_all(obj_1.lock_request(), obj_2.lock_request());
+            ++*ptr_1;
+            ++*ptr_2;
+        }};
+    // The other wrapper becomes available again once `lock_all` backs off.
+    while (!other_obj.try_lock()) {
+        std::this_thread::yield();
+    }
+    held_ptr.reset();
+    thread.join();
+    ASSERT_EQ(1, *obj_1.lock());
+    ASSERT_EQ(1, *obj_2.lock());
+}
+
+TEST(test_lock_wrapper, lock_all_transfer_without_deadlock)
+{
+    constexpr int k_transfer_num = 10000;
+    slontia::mutex_protect_wrapper<int, slontia::shared_mutex> obj_1{k_transfer_num};
+    slontia::mutex_protect_wrapper<int, slontia::shared_mutex> obj_2{k_transfer_num};
+
+    const auto transfer = [](auto& from, auto& to)
+    {
+        auto [from_ptr, to_ptr] = slontia::lock_all(from.lock_request(), to.lock_request());
+        --*from_ptr;
+        ++*to_ptr;
+    };
+    std::vector<std::jthread> threads;
+    threads.emplace_back([&] { for (int i = 0; i < k_transfer_num; ++i) transfer(obj_1, obj_2); });
+    threads.emplace_back([&] { for (int i = 0; i < k_transfer_num; ++i) transfer(obj_2, obj_1); });
+    // Threads locking the wrappers in a fixed order do not deadlock with `lock_all` either.
+    threads.emplace_back([&]
+        {
+            for (int i = 0; i < k_transfer_num; ++i) {
+                auto ptr_2 = obj_2.lock();
+                auto ptr_1 = obj_1.lock_shared();
+                ASSERT_EQ(2 * k_transfer_num, *ptr_1 + *ptr_2);
+            }
+        });
+    threads.clear();
+    ASSERT_EQ(k_transfer_num, *obj_1.lock());
+    ASSERT_EQ(k_transfer_num, *obj_2.lock());
+}
+
+TEST(test_sharded_wrapper, route_keys_to_shards)
+{
+    slontia::sharded_wrapper<std::unordered_map<int, int>, slontia::shared_mutex, 4> obj;
+    static_assert(alignof(decltype(obj)) == slontia::internal::k_cache_line_size);
+    static_assert(sizeof(obj) >= 4 * slontia::internal::k_cache_line_size);
+
+    for (int i = 0; i < 100; ++i) {
+        obj.lock(i)->emplace(i, i);
+    }
+    std::size_t size = 0;
+    for (std::size_t i = 0; i < obj.shard_num(); ++i) {
+        const auto shard_size = obj.shard(i).lock_shared()->size();
+        ASSERT_GT(shard_size, 0);
+        size += shard_size;
+    }
+    ASSERT_EQ(100, size);
+    for (int i = 0; i < 100; ++i) {
+        ASSERT_EQ(i, obj.lock_shared(i)->at(i));
+        ASSERT_EQ(&obj.shard(obj.shard_index(i)), &obj.shard_of(i));
+    }
+}
+
+TEST(test_sharded_wrapper, construct_shards_with_arguments)
+{
+    slontia::sharded_wrapper<std::pair<int, int>, std::shared_mutex, 3> obj(2, 1);
+    for (std::size_t i = 0; i < obj.shard_num(); ++i) {
+        ASSERT_EQ((std::pair<int, int>{2, 1}), *obj.shard(i).lock_shared());
+    }
+}
+
+TEST(test_sharded_wrapper, lock_key_blocks_only_its_shard)
+{
+    slontia::sharded_wrapper<int, slontia::shared_mutex, 2> obj;
+    int key_1 = 0;
+    while (obj.shard_index(key_1) != 0) {
+        ++key_1;
+    }
+    int key_2 = 0;
+    while (obj.shard_index(key_2) != 1) {
+        ++key_2;
+    }
+
+    auto ptr = obj.lock(key_1);
+    ASSERT_FALSE(obj.try_lock_shared(key_1));
+    ASSERT_TRUE(obj.try_lock(key_2));
+    ASSERT_TRUE(obj.try_lock_shared(key_2));
+}
+
+TEST(test_sharded_wrapper, lock_all_shared_blocks_writers_of_all_shards)
+{
+    slontia::sharded_wrapper<int, slontia::shared_mutex, 4> obj;
+    {
+        auto ptrs = obj.lock_all();
+        for (std::size_t i = 0; i < ptrs.size(); ++i) {
+            *ptrs[i] = i;
+        }
+        ASSERT_FALSE(obj.shard(3).try_lock_shared());
+    }
+    auto ptrs = obj.lock_all_shared();
+    for (std::size_t i = 0; i < ptrs.size(); ++i) {
+        ASSERT_EQ(i, *ptrs[i]);
+        ASSERT_FALSE(obj.shard(i).try_lock());
+        ASSERT_TRUE(obj.shard(i).try_lock_shared());
+    }
+}
+
+struct optimistic_object
+{
+    std::uint64_t a_{0};
+    std::uint64_t b_{0};
+};
+
+TEST(test_lock_wrapper, read_optimistic_with_locked_read)
+{
+    slontia::mutex_protect_wrapper<std::vector<int>, slontia::shared_mutex> obj{1, 2};
+    static_assert(sizeof(obj) == sizeof(slontia::mutex_protect_wrapper<std::vector<int>, slontia::shared_mutex,
+                slontia::locked_read>));
+
+    ASSERT_EQ(2, obj.read_optimistic([&](const std::vector<int>& v)
+                {
+                    // The mutex is locked in shared mode while reading.
+                    EXPECT_FALSE(obj.try_lock());
+                    EXPECT_TRUE(obj.try_lock_shared());
+                    return v.size();
+                }));
+    ASSERT_EQ((std::vector<int>{1, 2}), obj.snapshot());
+}
+
+TEST(test_lock_wrapper, read_optimistic_without_locking)
+{
+    slontia::mutex_protect_wrapper<optimistic_object, slontia::shared_mutex, slontia::optimistic_read<>> obj;
+    obj.lock()->a_ = 1;
+    obj.read_optimistic([&](const optimistic_object& o)
+        {
+            EXPECT_EQ(1, o.a_);
+            EXPECT_TRUE(obj.try_lock());
+        });
+    ASSERT_EQ(1, obj.snapshot().a_);
+}
+
+TEST(test_lock_wrapper, read_optimistic_falls_back_to_lock_shared)
+{
+    slontia::mutex_protect_wrapper<optimistic_object, slontia::shared_mutex, slontia::optimistic_read<>> obj;
+    auto ptr = obj.lock();
+    ptr->a_ = 1;
+    std::atomic<bool> read{false};
+    std::jthread thread{[&]
+        {
+            // The version is odd until the writer releases, so the reader has to lock the mutex.
+            EXPECT_EQ(2, obj.snapshot().a_);
+            read = true;
+        }};
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    ASSERT_FALSE(read);
+    ptr->a_ = 2;
+    ptr.reset();
+    thread.join();
+    ASSERT_TRUE(read);
+}
+
+TEST(test_lock_wrapper, read_optimistic_with_concurrent_writers)
+{
+    constexpr std::uint64_t k_write_num = 100000;
+    slontia::mutex_protect_wrapper<optimistic_object, slontia::shared_mutex, slontia::optimistic_read<>> obj;
+    std::jthread writer{[&]
+        {
+            for (std::uint64_t i = 0; i < k_write_num; ++i) {
+                auto ptr = obj.lock();
+                ++ptr->a_;
+                ++ptr->b_;
+            }
+        }};
+    std::jthread downgrading_writer{[&]
+        {
+            for (std::uint64_t i = 0; i < k_write_num; ++i) {
+                auto ptr = obj.lock();
+                ++ptr->a_;
+                ++ptr->b_;
+                decltype(obj)::shared_locked_ptr shared_ptr = std::move(ptr);
+                EXPECT_EQ(shared_ptr->a_, shared_ptr->b_);
+            }
+        }};
+    std::uint64_t last_a = 0;
+    while (last_a < 2 * k_write_num) {
+        const auto o = obj.snapshot();
+        ASSERT_EQ(o.a_, o.b_);
+        ASSERT_GE(o.a_, last_a);
+        last_a = o.a_;
+    }
+}
+
+// Counts the number of alive objects to check that the retired versions are reclaimed.
+struct counted_object
+{
+    counted_object(const int value) : value_{value} { ++s_alive_num_; }
+    counted_object(const counted_object& o) : value_{o.value_} { ++s_alive_num_; }
+    ~counted_object() { --s_alive_num_; }
+
+    int value_;
+    inline static std::atomic<int> s_alive_num_{0};
+};
+
+TEST(test_cow_wrapper, read_and_update)
+{
+    {
+        slontia::cow_wrapper<counted_object> obj{1};
+        auto ptr = obj.read();
+        ASSERT_TRUE(ptr);
+        ASSERT_EQ(1, ptr->value_);
+        ptr.reset();
+        ASSERT_FALSE(ptr);
+
+        obj.update([](counted_object& o) { ++o.value_; });
+        ASSERT_EQ(2, obj.read()->value_);
+        obj.store(counted_object{5});
+        ASSERT_EQ(5, (*obj.read()).value_);
+        ASSERT_EQ(1, counted_object::s_alive_num_);
+    }
+    ASSERT_EQ(0, counted_object::s_alive_num_);
+}
+
+TEST(test_cow_wrapper, pinned_version_is_not_reclaimed)
+{
+    slontia::cow_wrapper<counted_object, 4> obj{1};
+    auto ptr = obj.read();
+    auto ptr_2 = ptr;
+    std::atomic<bool> updated{false};
+    std::jthread writer{[&]
+        {
+            obj.update([](counted_object& o) { o.value_ = 2; });
+            updated = true;
+        }};
+    // The new version is published before the writer waits for the readers of the old versions.
+    while (obj.read()->value_ != 2) {
+        std::this_thread::yield();
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    ASSERT_FALSE(updated);
+    ASSERT_EQ(1, ptr->value_);
+    ASSERT_EQ(2, counted_object::s_alive_num_);
+
+    ptr.reset();
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    ASSERT_FALSE(updated);
+    ptr_2 = nullptr;
+    writer.join();
+    ASSERT_TRUE(updated);
+    ASSERT_EQ(1, counted_object::s_alive_num_);
+}
+
+TEST(test_cow_wrapper, concurrent_readers_and_writers)
+{
+    constexpr int k_update_num = 1000;
+    slontia::cow_wrapper<std::vector<int>> obj{0, 0};
+    std::atomic<bool> stopped{false};
+    std::vector<std::jthread> readers;
+    for (int i = 0; i < 4; ++i) {
+        readers.emplace_back([&]
+            {
+                int last_value = 0;
+                while (!stopped) {
+                    const auto ptr = obj.read();
+                    ASSERT_EQ((*ptr)[0], (*ptr)[1]);
+                    ASSERT_GE((*ptr)[0], last_value);
+                    last_value = (*ptr)[0];
+                }
+            });
+    }
+    std::vector<std::jthread> writers;
+    for (int i = 0; i < 2; ++i) {
+        writers.emplace_back([&]
+            {
+                for (int j = 0; j < k_update_num; ++j) {
+                    obj.update([](std::vector<int>& v)
+                        {
+                            ++v[0];
+                            ++v[1];
+                        });
+                }
+            });
+    }
+    writers.clear();
+    stopped = true;
+    readers.clear();
+    ASSERT_EQ(2 * k_update_num, (*obj.read())[0]);
+}
+
+TEST(test_lock_wrapper, with_lock_and_with_shared_lock)
+{
+    slontia::mutex_protect_wrapper<int, slontia::shared_mutex> obj;
+    ASSERT_EQ(1, obj.with_lock([&](int& value)
+                {
+                    EXPECT_FALSE(obj.try_lock_shared());
+                    return ++value;
+                }));
+    obj.with_shared_lock([&](const int& value)
+        {
+            EXPECT_EQ(1, value);
+            EXPECT_FALSE(obj.try_lock());
+            EXPECT_TRUE(obj.try_lock_shared());
+        });
+}
+
+TEST(test_lock_wrapper, with_lock_combining)
+{
+    using mutex_protect_wrapper = slontia::mutex_protect_wrapper<std::vector<int>, slontia::shared_mutex,
+          slontia::locked_read, slontia::combining_write<>>;
+    mutex_protect_wrapper obj;
+    ASSERT_EQ(1, obj.with_lock([](std::vector<int>& v)
+                {
+                    v.emplace_back(1);
+                    return v.size();
+                }));
+    obj.with_lock([](std::vector<int>& v) { v.emplace_back(2); });
+    ASSERT_EQ((std::vector<int>{1, 2}), *obj.lock_shared());
+    ASSERT_THROW(obj.with_lock([](std::vector<int>& v) { return v.at(2); }), std::out_of_range);
+    ASSERT_TRUE(obj.try_lock());
+}
+
+TEST(test_lock_wrapper, with_lock_combining_while_locked)
+{
+    using mutex_protect_wrapper = slontia::mutex_protect_wrapper<int, slontia::shared_mutex, slontia::locked_read,
+          slontia::combining_write<4>>;
+    mutex_protect_wrapper obj;
+    auto ptr = obj.lock();
+    std::vector<std::jthread> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([&] { obj.with_lock([](int& value) { ++value; }); });
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    ASSERT_EQ(0, *ptr);
+    ptr.reset();
+    threads.clear();
+    ASSERT_EQ(4, *obj.lock());
+}
+
+TEST(test_lock_wrapper, with_lock_combining_concurrently)
+{
+    using mutex_protect_wrapper = slontia::mutex_protect_wrapper<optimistic_object, slontia::shared_mutex,
+          slontia::optimistic_read<>, slontia::combining_write<>>;
+    constexpr std::uint64_t k_write_num = 10000;
+    mutex_protect_wrapper obj;
+    std::vector<std::jthread> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([&]
+            {
+                for (std::uint64_t j = 0; j < k_write_num; ++j) {
+                    const auto a = obj.with_lock([](optimistic_object& o)
+                            {
+                                ++o.b_;
+                                return ++o.a_;
+                            });
+                    ASSERT_GT(a, 0);
+                    const auto snapshot = obj.snapshot();
+                    ASSERT_EQ(snapshot.a_, snapshot.b_);
+                }
+            });
+    }
+    threads.clear();
+    ASSERT_EQ(4 * k_write_num, obj.lock()->a_);
+}
+
+// Returns the contention recorded at the line of `location`, or null if it is not recorded.
+static std::optional<slontia::contention_site> find_contention_site(const std::source_location& location)
+{
+    for (const auto& site : slontia::contention_profiler::report()) {
+        if (site.location_.line() == location.line() &&
+                std::string_view{site.location_.file_name()} == location.file_name()) {
+            return site;
+        }
+    }
+    return std::nullopt;
+}
+
+TEST(test_contention_profiler, record_contended_call_sites)
+{
+    slontia::contention_profiler::set_sample_period(1);
+    slontia::contention_profiler::reset();
+    slontia::mutex_protect_wrapper<int, slontia::shared_mutex, slontia::locked_read, slontia::locked_write,
+        slontia::sampled_profile> obj;
+
+    const auto uncontended_location = std::source_location::current();
+    *obj.lock(uncontended_location) = 1;
+
+    // The same call site is executed by both threads.
+    const auto contended_location = std::source_location::current();
+    {
+        auto locked_obj = obj.lock();
+        std::vector<std::jthread> threads;
+        for (int i = 0; i < 2; ++i) {
+            threads.emplace_back([&]
+                {
+                    slontia::contention_profiler::set_sample_period(1);
+                    EXPECT_EQ(1, *obj.lock_shared(contended_location));
+                });
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        locked_obj.reset();
+    }
+
+    EXPECT_FALSE(find_contention_site(uncontended_location).has_value());
+    const auto site = find_contention_site(contended_location);
+    ASSERT_TRUE(site.has_value());
+    EXPECT_EQ(2, site->contended_num_);
+    EXPECT_GT(site->total_wait_time_, std::chrono::nanoseconds::zero());
+    EXPECT_GE(site->total_wait_time_, site->max_wait_time_);
+
+    std::ostringstream os;
+    slontia::contention_profiler::dump(os);
+    EXPECT_NE(std::string::npos, os.str().find(contended_location.file_name()));
+    slontia::contention_profiler::set_sample_period(slontia::contention_profiler::k_default_sample_period);
+}
+
+TEST(test_contention_profiler, record_failed_try_lock)
+{
+    slontia::contention_profiler::set_sample_period(1);
+    slontia::contention_profiler::reset();
+    slontia::mutex_protect_wrapper<int, std::mutex, slontia::locked_read, slontia::locked_write,
+        slontia::sampled_profile> obj;
+
+    const auto locked_obj = obj.lock();
+    std::jthread{[&]
+        {
+            slontia::contention_profiler::set_sample_period(1);
+            const auto location = std::source_location::current();
+            EXPECT_FALSE(obj.try_lock(location));
+            const auto site = find_contention_site(location);
+            ASSERT_TRUE(site.has_value());
+            EXPECT_EQ(1, site->contended_num_);
+        }};
+    slontia::contention_profiler::set_sample_period(slontia::contention_profiler::k_default_sample_period);
+}
+
+TEST(test_contention_profiler, record_sharded_call_sites)
+{
+    slontia::contention_profiler::set_sample_period(1);
+    slontia::contention_profiler::reset();
+    slontia::sharded_wrapper<int, slontia::shared_mutex, 2, slontia::sampled_profile> obj;
+
+    const auto locked_obj = obj.lock(0);
+    std::jthread{[&]
+        {
+            slontia::contention_profiler::set_sample_period(1);
+            const auto location = std::source_location::current();
+            EXPECT_FALSE(obj.try_lock_shared(0, location));
+            const auto site = find_contention_site(location);
+            ASSERT_TRUE(site.has_value());
+            EXPECT_EQ(1, site->contended_num_);
+        }};
+    slontia::contention_profiler::set_sample_period(slontia::contention_profiler::k_default_sample_period);
+}
+
+TEST(test_contention_profiler, sample_period)
+{
+    slontia::contention_profiler::set_sample_period(4);
+    std::uint32_t sampled_num = 0;
+    for (int i = 0; i < 16; ++i) {
+        sampled_num += slontia::contention_profiler::sample();
+    }
+    EXPECT_EQ(4, sampled_num);
+
+    slontia::contention_profiler::set_sample_period(0);
+    for (int i = 0; i < 16; ++i) {
+        EXPECT_FALSE(slontia::contention_profiler::sample());
+    }
+    slontia::contention_profiler::set_sample_period(slontia::contention_profiler::k_default_sample_period);
+}
@@ -3,14 +3,35 @@
 // This source code is licensed under MIT (found in the LICENSE file).
 
 #include "shared_mutex.h"
+#include "shared_mutex_builder.h"
+#include "sharded_shared_mutex.h"
+#include "packed_shared_mutex.h"
+#include "cohort_shared_mutex.h"
+#include "lock_many.h"
+#include "timed_atomic_uint32/timed_atomic_uint32_parking_lot.h"
 
 #include <gtest/gtest.h>
 #include <gflags/gflags.h>
 
+#include <numeric>
+#include <stop_token>
 #include <thread>
 #include <shared_mutex>
+#include <vector>
 
-enum class lock_mode { k_lock, k_try_lock, k_try_lock_for, k_try_lock_until };
+#if defined(__linux__) || defined(__APPLE__) || defined(__FreeBSD__)
+#include "process_shared_mutex.h"
+
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include "pi_shared_mutex.h"
+#endif
+
+enum class lock_mode { k_lock, k_try_lock, k_try_lock_for, k_try_lock_until, k_try_lock_until_deadline };
 
 template <lock_mode Mode>
 struct try_lock_func
@@ -43,6 +64,13 @@ bool try_lock_func<lock_mode::k_try_lock_until>::try_lock(Mutex& mutex)
     return mutex.try_lock_until(std::chrono::steady_clock::now() + std::chrono::milliseconds(1));
 }
 
+template <>
+template <typename Mutex>
+bool try_lock_func<lock_mode::k_try_lock_until_deadline>::try_lock(Mutex& mutex)
+{
+    return mutex.try_lock_until(slontia::deadline{std::chrono::milliseconds(1)});
+}
+
 template <>
 template <typename Mutex>
 bool try_lock_func<lock_mode::k_try_lock>::try_lock_shared(Mutex& mutex)
@@ -64,6 +92,13 @@ bool try_lock_func<lock_mode::k_try_lock_until>::try_lock_shared(Mutex& mutex)
     return mutex.try_lock_shared_until(std::chrono::steady_clock::now() + std::chrono::milliseconds(1));
 }
 
+template <>
+template <typename Mutex>
+bool try_lock_func<lock_mode::k_try_lock_until_deadline>::try_lock_shared(Mutex& mutex)
+{
+    return mutex.try_lock_shared_until(slontia::deadline{std::chrono::milliseconds(1)});
+}
+
 template <lock_mode Mode>
 struct lock_func
 {
@@ -159,8 +194,114 @@ using test_shared_mutex_tuple = merge_tuples_t<
             lock_mode_sequence<lock_mode::k_try_lock>>,
         shared_mutex_tuple_t<
             slontia::shared_timed_mutex,
-            lock_mode_sequence<lock_mode::k_lock, lock_mode::k_try_lock, lock_mode::k_try_lock_for, lock_mode::k_try_lock_until>,
-            lock_mode_sequence<lock_mode::k_try_lock, lock_mode::k_try_lock_for, lock_mode::k_try_lock_until>>
+            lock_mode_sequence<lock_mode::k_lock, lock_mode::k_try_lock, lock_mode::k_try_lock_for, lock_mode::k_try_lock_until,
+                lock_mode::k_try_lock_until_deadline>,
+            lock_mode_sequence<lock_mode::k_try_lock, lock_mode::k_try_lock_for, lock_mode::k_try_lock_until,
+                lock_mode::k_try_lock_until_deadline>>,
+        shared_mutex_tuple_t<
+            slontia::padded_shared_mutex,
+            lock_mode_sequence<lock_mode::k_lock, lock_mode::k_try_lock>,
+            lock_mode_sequence<lock_mode::k_try_lock>>,
+        shared_mutex_tuple_t<
+            slontia::padded_shared_timed_mutex,
+            lock_mode_sequence<lock_mode::k_lock, lock_mode::k_try_lock_for>,
+            lock_mode_sequence<lock_mode::k_try_lock, lock_mode::k_try_lock_until>>,
+        shared_mutex_tuple_t<
+            slontia::internal::shared_mutex<std::atomic<std::uint32_t>, slontia::compact_layout, slontia::park_wait>,
+            lock_mode_sequence<lock_mode::k_lock, lock_mode::k_try_lock>,
+            lock_mode_sequence<lock_mode::k_try_lock>>,
+        shared_mutex_tuple_t<
+            slontia::internal::shared_timed_mutex<slontia::internal::timed_atomic_uint32_t, slontia::compact_layout,
+                slontia::adaptive_spin_wait<>>,
+            lock_mode_sequence<lock_mode::k_lock, lock_mode::k_try_lock_for>,
+            lock_mode_sequence<lock_mode::k_try_lock, lock_mode::k_try_lock_for, lock_mode::k_try_lock_until>>,
+        shared_mutex_tuple_t<
+            slontia::sharded_shared_mutex<>,
+            lock_mode_sequence<lock_mode::k_lock, lock_mode::k_try_lock>,
+            lock_mode_sequence<lock_mode::k_try_lock>>,
+        shared_mutex_tuple_t<
+            slontia::sharded_shared_mutex<1>,
+            lock_mode_sequence<lock_mode::k_lock, lock_mode::k_try_lock>,
+            lock_mode_sequence<lock_mode::k_try_lock>>,
+        shared_mutex_tuple_t<
+            slontia::internal::shared_mutex<std::atomic<std::uint32_t>, slontia::compact_layout, slontia::spin_wait<>,
+                slontia::notify_always, slontia::reader_preferring>,
+            lock_mode_sequence<lock_mode::k_lock, lock_mode::k_try_lock>,
+            lock_mode_sequence<lock_mode::k_try_lock>>,
+        shared_mutex_tuple_t<
+            slontia::internal::shared_timed_mutex<slontia::internal::timed_atomic_uint32_t, slontia::compact_layout,
+                slontia::spin_wait<>, slontia::notify_parked, slontia::reader_preferring>,
+            lock_mode_sequence<lock_mode::k_lock, lock_mode::k_try_lock_for, lock_mode::k_try_lock_until_deadline>,
+            lock_mode_sequence<lock_mode::k_try_lock, lock_mode::k_try_lock_until>>,
+        shared_mutex_tuple_t<
+            slontia::internal::shared_mutex<std::atomic<std::uint32_t>, slontia::compact_layout, slontia::spin_wait<>,
+                slontia::notify_always, slontia::phase_fair>,
+            lock_mode_sequence<lock_mode::k_lock, lock_mode::k_try_lock>,
+            lock_mode_sequence<lock_mode::k_try_lock>>,
+        shared_mutex_tuple_t<
+            slontia::internal::shared_timed_mutex<slontia::internal::timed_atomic_uint32_t, slontia::compact_layout,
+                slontia::spin_wait<>, slontia::notify_parked, slontia::phase_fair>,
+            lock_mode_sequence<lock_mode::k_lock, lock_mode::k_try_lock_until>,
+            lock_mode_sequence<lock_mode::k_try_lock, lock_mode::k_try_lock_for, lock_mode::k_try_lock_until_deadline>>,
+        shared_mutex_tuple_t<
+            slontia::packed_shared_mutex,
+            lock_mode_sequence<lock_mode::k_lock, lock_mode::k_try_lock>,
+            lock_mode_sequence<lock_mode::k_try_lock>>,
+        shared_mutex_tuple_t<
+            slontia::cohort_shared_mutex<>,
+            lock_mode_sequence<lock_mode::k_lock, lock_mode::k_try_lock>,
+            lock_mode_sequence<lock_mode::k_try_lock>>,
+        shared_mutex_tuple_t<
+            slontia::cohort_shared_mutex<1, 1>,
+            lock_mode_sequence<lock_mode::k_lock, lock_mode::k_try_lock>,
+            lock_mode_sequence<lock_mode::k_try_lock>>,
+        shared_mutex_tuple_t<
+            slontia::internal::packed_shared_mutex<std::atomic<std::uint32_t>, slontia::park_wait,
+                slontia::notify_parked>,
+            lock_mode_sequence<lock_mode::k_lock, lock_mode::k_try_lock>,
+            lock_mode_sequence<lock_mode::k_try_lock>>,
+        shared_mutex_tuple_t<
+            slontia::internal::shared_mutex<std::atomic<std::uint32_t>, slontia::compact_layout, slontia::spin_wait<>,
+                slontia::notify_always, slontia::writer_preferring, slontia::lock_stats<>>,
+            lock_mode_sequence<lock_mode::k_lock, lock_mode::k_try_lock>,
+            lock_mode_sequence<lock_mode::k_try_lock>>,
+        shared_mutex_tuple_t<
+            slontia::internal::shared_timed_mutex<slontia::internal::timed_atomic_uint32_t, slontia::compact_layout,
+                slontia::spin_wait<>, slontia::notify_parked, slontia::phase_fair, slontia::lock_stats<2>>,
+            lock_mode_sequence<lock_mode::k_lock, lock_mode::k_try_lock_for>,
+            lock_mode_sequence<lock_mode::k_try_lock, lock_mode::k_try_lock_until>>,
+        shared_mutex_tuple_t<
+            slontia::internal::shared_mutex<std::atomic<std::uint32_t>, slontia::compact_layout, slontia::spin_wait<>,
+                slontia::notify_always, slontia::writer_preferring, slontia::no_stats, slontia::writer_handoff>,
+            lock_mode_sequence<lock_mode::k_lock, lock_mode::k_try_lock>,
+            lock_mode_sequence<lock_mode::k_try_lock>>,
+        shared_mutex_tuple_t<
+            slontia::internal::shared_timed_mutex<slontia::internal::timed_atomic_uint32_t, slontia::compact_layout,
+                slontia::park_wait, slontia::notify_parked, slontia::writer_preferring, slontia::lock_stats<>,
+                slontia::writer_handoff>,
+            lock_mode_sequence<lock_mode::k_lock, lock_mode::k_try_lock_for>,
+            lock_mode_sequence<lock_mode::k_try_lock, lock_mode::k_try_lock_until>>,
+        shared_mutex_tuple_t<
+            slontia::internal::shared_timed_mutex<slontia::internal::parking_lot_timed_atomic_uint32_t,
+                slontia::compact_layout, slontia::park_wait, slontia::notify_parked>,
+            lock_mode_sequence<lock_mode::k_lock, lock_mode::k_try_lock_until>,
+            lock_mode_sequence<lock_mode::k_try_lock, lock_mode::k_try_lock_for, lock_mode::k_try_lock_until_deadline>>,
+        shared_mutex_tuple_t<
+            slontia::read_mostly_shared_mutex,
+            lock_mode_sequence<lock_mode::k_lock, lock_mode::k_try_lock>,
+            lock_mode_sequence<lock_mode::k_try_lock>>,
+        shared_mutex_tuple_t<
+            slontia::fair_shared_mutex,
+            lock_mode_sequence<lock_mode::k_lock, lock_mode::k_try_lock>,
+            lock_mode_sequence<lock_mode::k_try_lock>>,
+        shared_mutex_tuple_t<
+            slontia::write_heavy_shared_mutex,
+            lock_mode_sequence<lock_mode::k_lock, lock_mode::k_try_lock>,
+            lock_mode_sequence<lock_mode::k_try_lock>>,
+        shared_mutex_tuple_t<
+            slontia::instrumented_shared_timed_mutex,
+            lock_mode_sequence<lock_mode::k_lock, lock_mode::k_try_lock_for, lock_mode::k_try_lock_until_deadline>,
+            lock_mode_sequence<lock_mode::k_try_lock, lock_mode::k_try_lock_until>>
     >;
 
 template <typename SharedMutex>
@@ -230,3 +371,1285 @@ TYPED_TEST(test_shared_mutex, lock_and_unlock_shared_in_different_thread)
     EXPECT_TRUE(this->try_lock());
 }
 
+
+TEST(test_shared_mutex_builder, compose_policies_by_name)
+{
+    using builder = slontia::shared_mutex_builder<>;
+    static_assert(std::is_same_v<slontia::internal::shared_mutex<std::atomic<std::uint32_t>>, builder::type>);
+    static_assert(std::is_same_v<
+            slontia::internal::shared_mutex<std::atomic<std::uint32_t>, slontia::padded_layout, slontia::spin_wait<>,
+                slontia::notify_always, slontia::phase_fair>,
+            builder::with_fairness<slontia::phase_fair>::with_layout<slontia::padded_layout>::type>);
+    static_assert(std::is_same_v<
+            builder::with_layout<slontia::padded_layout>::with_fairness<slontia::phase_fair>::type,
+            builder::with_fairness<slontia::phase_fair>::with_layout<slontia::padded_layout>::type>);
+    static_assert(std::is_same_v<
+            slontia::internal::shared_timed_mutex<slontia::internal::timed_atomic_uint32_t, slontia::compact_layout,
+                slontia::spin_wait<>, slontia::notify_parked>,
+            builder::with_atomic<slontia::internal::timed_atomic_uint32_t>::with_wake<slontia::notify_parked>
+                ::timed_type>);
+    // The disabled policies take no space.
+    static_assert(sizeof(builder::with_stats<slontia::no_stats>::with_handoff<slontia::no_handoff>::type) ==
+            2 * sizeof(std::atomic<std::uint32_t>));
+}
+
+template <typename SharedMutex>
+struct test_upgrade_mutex : protected SharedMutex, public testing::Test {};
+
+using test_upgrade_mutex_tuple = testing::Types<slontia::shared_mutex, slontia::shared_timed_mutex,
+      slontia::padded_shared_mutex, slontia::internal::shared_mutex<std::atomic<std::uint32_t>,
+      slontia::compact_layout, slontia::park_wait>>;
+
+TYPED_TEST_SUITE(test_upgrade_mutex, test_upgrade_mutex_tuple);
+
+TYPED_TEST(test_upgrade_mutex, upgrade_lock_coexists_with_shared_lock)
+{
+    this->lock_upgrade();
+    EXPECT_TRUE(this->try_lock_shared());
+    EXPECT_FALSE(this->try_lock_upgrade());
+    EXPECT_FALSE(this->try_lock());
+    this->unlock_shared();
+    this->unlock_upgrade();
+    EXPECT_TRUE(this->try_lock());
+}
+
+TYPED_TEST(test_upgrade_mutex, cannot_upgrade_lock_when_unique_locked)
+{
+    this->lock();
+    EXPECT_FALSE(this->try_lock_upgrade());
+    this->unlock();
+    EXPECT_TRUE(this->try_lock_upgrade());
+}
+
+TYPED_TEST(test_upgrade_mutex, cannot_upgrade_until_all_shared_unlocked)
+{
+    this->lock_upgrade();
+    this->lock_shared();
+    EXPECT_FALSE(this->try_unlock_upgrade_and_lock());
+    this->unlock_shared();
+    EXPECT_TRUE(this->try_unlock_upgrade_and_lock());
+    EXPECT_FALSE(this->try_lock_shared());
+    this->unlock();
+    EXPECT_TRUE(this->try_lock());
+}
+
+TYPED_TEST(test_upgrade_mutex, upgrade_blocks_until_shared_unlocked)
+{
+    this->lock_upgrade();
+    this->lock_shared();
+    std::jthread thread{[this] { this->unlock_upgrade_and_lock(); }};
+    this->unlock_shared();
+    thread.join();
+    EXPECT_FALSE(this->try_lock_shared());
+    this->unlock();
+    EXPECT_TRUE(this->try_lock_shared());
+}
+
+TYPED_TEST(test_upgrade_mutex, upgrade_lock_blocks_until_upgrade_unlocked)
+{
+    this->lock_upgrade();
+    std::jthread thread{[this] { this->lock_upgrade(); }};
+    this->unlock_upgrade();
+    thread.join();
+    EXPECT_FALSE(this->try_lock_upgrade());
+    this->unlock_upgrade();
+    EXPECT_TRUE(this->try_lock());
+}
+
+TYPED_TEST(test_upgrade_mutex, downgrade_unique_lock_to_upgrade_lock)
+{
+    this->lock();
+    this->unlock_and_lock_upgrade();
+    EXPECT_TRUE(this->try_lock_shared());
+    EXPECT_FALSE(this->try_lock_upgrade());
+    this->unlock_shared();
+    this->unlock_upgrade();
+    EXPECT_TRUE(this->try_lock());
+}
+
+TYPED_TEST(test_upgrade_mutex, downgrade_upgrade_lock_to_shared_lock)
+{
+    this->lock_upgrade();
+    this->unlock_upgrade_and_lock_shared();
+    EXPECT_TRUE(this->try_lock_upgrade());
+    EXPECT_FALSE(this->try_unlock_upgrade_and_lock());
+    this->unlock_shared();
+    EXPECT_TRUE(this->try_unlock_upgrade_and_lock());
+}
+
+TYPED_TEST(test_upgrade_mutex, downgrade_unique_lock_to_shared_lock)
+{
+    this->lock();
+    this->unlock_and_lock_shared();
+    EXPECT_TRUE(this->try_lock_shared());
+    this->unlock_shared();
+    EXPECT_FALSE(this->try_lock());
+    this->unlock_shared();
+    EXPECT_TRUE(this->try_lock());
+}
+
+TYPED_TEST(test_upgrade_mutex, downgrade_blocks_waiting_writer)
+{
+    this->lock();
+    std::atomic<bool> locked{false};
+    std::jthread thread{[&]
+        {
+            this->lock();
+            locked = true;
+            this->unlock();
+        }};
+    this->unlock_and_lock_shared();
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    EXPECT_FALSE(locked);
+    this->unlock_shared();
+    thread.join();
+    EXPECT_TRUE(locked);
+}
+
+// Exposes the states of the mutex to observe whether the threads are blocked.
+template <typename SharedMutex>
+struct observable_shared_mutex : public SharedMutex
+{
+    using SharedMutex::writing_num_;
+    using SharedMutex::holding_num_;
+
+    // Blocks until `n` threads are acquiring or holding the mutex for exclusive ownership.
+    void wait_for_writers(const std::uint32_t n)
+    {
+        while (writing_num_.load() < n) {
+            std::this_thread::yield();
+        }
+    }
+
+    // Blocks until `n` threads are acquiring or holding the mutex for shared ownership.
+    void wait_for_readers(const std::uint32_t n)
+    {
+        while ((holding_num_.load() & ~(1u << 31)) < n) {
+            std::this_thread::yield();
+        }
+    }
+};
+
+template <typename SharedMutex>
+struct test_shared_mutex_fairness : public observable_shared_mutex<SharedMutex>, public testing::Test {};
+
+template <typename Fairness>
+using fairness_shared_mutex = slontia::internal::shared_mutex<std::atomic<std::uint32_t>, slontia::compact_layout,
+      slontia::spin_wait<>, slontia::notify_always, Fairness>;
+
+template <typename Fairness>
+using fairness_shared_timed_mutex = slontia::internal::shared_timed_mutex<slontia::internal::timed_atomic_uint32_t,
+      slontia::compact_layout, slontia::spin_wait<>, slontia::notify_parked, Fairness>;
+
+using test_shared_mutex_fairness_tuple = testing::Types<
+    fairness_shared_mutex<slontia::reader_preferring>, fairness_shared_mutex<slontia::phase_fair>,
+    fairness_shared_timed_mutex<slontia::reader_preferring>, fairness_shared_timed_mutex<slontia::phase_fair>>;
+
+TYPED_TEST_SUITE(test_shared_mutex_fairness, test_shared_mutex_fairness_tuple);
+
+TYPED_TEST(test_shared_mutex_fairness, reader_registered_during_writer_phase_precedes_waiting_writer)
+{
+    this->lock();
+    std::atomic<bool> writer_locked{false};
+    std::jthread reader{[&]
+        {
+            this->lock_shared();
+            EXPECT_FALSE(writer_locked);
+            this->unlock_shared();
+        }};
+    this->wait_for_readers(1);
+    std::jthread writer{[&]
+        {
+            this->lock();
+            writer_locked = true;
+            this->unlock();
+        }};
+    this->wait_for_writers(2);
+    this->unlock();
+}
+
+TYPED_TEST(test_shared_mutex_fairness, reader_waits_for_waiting_writer_only_if_phase_fair)
+{
+    constexpr bool k_phase_fair = std::is_same_v<fairness_shared_mutex<slontia::phase_fair>, TypeParam> ||
+        std::is_same_v<fairness_shared_timed_mutex<slontia::phase_fair>, TypeParam>;
+    this->lock_shared();
+    std::atomic<bool> writer_unlocked{false};
+    std::jthread writer{[&]
+        {
+            this->lock();
+            writer_unlocked = true;
+            this->unlock();
+        }};
+    this->wait_for_writers(1);
+    EXPECT_EQ(!k_phase_fair, this->try_lock_shared());
+    std::jthread reader{[&]
+        {
+            this->lock_shared();
+            EXPECT_EQ(k_phase_fair, writer_unlocked);
+            this->unlock_shared();
+        }};
+    if constexpr (!k_phase_fair) {
+        this->unlock_shared();
+        reader.join();
+    }
+    this->unlock_shared();
+}
+
+template <typename SharedMutex>
+struct test_shared_mutex_phase_fair : public observable_shared_mutex<SharedMutex>, public testing::Test {};
+
+using test_shared_mutex_phase_fair_tuple = testing::Types<fairness_shared_mutex<slontia::phase_fair>,
+    fairness_shared_timed_mutex<slontia::phase_fair>>;
+
+TYPED_TEST_SUITE(test_shared_mutex_phase_fair, test_shared_mutex_phase_fair_tuple);
+
+TYPED_TEST(test_shared_mutex_phase_fair, waiting_reader_not_let_in_by_arriving_writer)
+{
+    this->lock_shared();
+    std::atomic<bool> writer_locked{false};
+    const auto write = [&]
+        {
+            this->lock();
+            writer_locked = true;
+            this->unlock();
+        };
+    std::jthread first_writer{write};
+    this->wait_for_writers(1);
+    std::atomic<bool> reader_locked{false};
+    std::jthread reader{[&]
+        {
+            this->lock_shared();
+            reader_locked = true;
+            EXPECT_TRUE(writer_locked);
+            this->unlock_shared();
+        }};
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    std::jthread second_writer{write};
+    this->wait_for_writers(2);
+    // The failed acquisition wakes the parked reader up, which should keep waiting.
+    EXPECT_FALSE(this->try_lock());
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    EXPECT_FALSE(reader_locked);
+    this->unlock_shared();
+}
+
+TEST(test_shared_mutex_phase_fair, waiting_reader_not_let_in_by_writer_timing_out)
+{
+    observable_shared_mutex<fairness_shared_timed_mutex<slontia::phase_fair>> mutex;
+    mutex.lock_shared();
+    std::atomic<bool> writer_locked{false};
+    std::jthread writer{[&]
+        {
+            mutex.lock();
+            writer_locked = true;
+            mutex.unlock();
+        }};
+    mutex.wait_for_writers(1);
+    std::atomic<bool> reader_locked{false};
+    std::jthread reader{[&]
+        {
+            EXPECT_TRUE(mutex.try_lock_shared_for(std::chrono::seconds(10)));
+            reader_locked = true;
+            EXPECT_TRUE(writer_locked);
+            mutex.unlock_shared();
+        }};
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    std::jthread second_writer{[&]
+        {
+            EXPECT_FALSE(mutex.try_lock_for(std::chrono::milliseconds(50)));
+        }};
+    mutex.wait_for_writers(2);
+    std::jthread third_writer{[&]
+        {
+            mutex.lock();
+            writer_locked = true;
+            mutex.unlock();
+        }};
+    mutex.wait_for_writers(3);
+    second_writer.join();
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    EXPECT_FALSE(reader_locked);
+    mutex.unlock_shared();
+}
+
+TEST(test_shared_mutex_fairness, reader_waits_for_waiting_writer_if_writer_preferring)
+{
+    observable_shared_mutex<fairness_shared_mutex<slontia::writer_preferring>> mutex;
+    mutex.lock_shared();
+    std::jthread writer{[&]
+        {
+            mutex.lock();
+            mutex.unlock();
+        }};
+    mutex.wait_for_writers(1);
+    EXPECT_FALSE(mutex.try_lock_shared());
+    mutex.unlock_shared();
+}
+
+template <typename SharedMutex>
+struct test_shared_mutex_batch : public observable_shared_mutex<SharedMutex>, public testing::Test {};
+
+using test_shared_mutex_batch_tuple = testing::Types<slontia::shared_mutex, slontia::shared_timed_mutex,
+    fairness_shared_mutex<slontia::reader_preferring>, fairness_shared_mutex<slontia::phase_fair>,
+    fairness_shared_timed_mutex<slontia::phase_fair>,
+    slontia::internal::shared_mutex<std::atomic<std::uint32_t>, slontia::compact_layout, slontia::spin_wait<>,
+        slontia::notify_always, slontia::writer_preferring, slontia::lock_stats<>>>;
+
+TYPED_TEST_SUITE(test_shared_mutex_batch, test_shared_mutex_batch_tuple);
+
+TYPED_TEST(test_shared_mutex_batch, cannot_unique_lock_until_all_batch_unlocked)
+{
+    this->lock_shared(3);
+    this->unlock_shared(2);
+    EXPECT_FALSE(this->try_lock());
+    this->unlock_shared();
+    EXPECT_TRUE(this->try_lock());
+}
+
+TYPED_TEST(test_shared_mutex_batch, try_lock_batch_fails_without_holding_any)
+{
+    this->lock();
+    EXPECT_FALSE(this->try_lock_shared(3));
+    this->unlock();
+    EXPECT_TRUE(this->try_lock());
+    this->unlock();
+    EXPECT_TRUE(this->try_lock_shared(3));
+    this->unlock_shared(3);
+    EXPECT_TRUE(this->try_lock());
+}
+
+TYPED_TEST(test_shared_mutex_batch, unlock_batch_in_different_threads)
+{
+    this->lock_shared(4);
+    {
+        std::vector<std::jthread> threads;
+        for (int i = 0; i < 4; ++i) {
+            threads.emplace_back([this] { this->unlock_shared(); });
+        }
+    }
+    EXPECT_TRUE(this->try_lock());
+}
+
+TYPED_TEST(test_shared_mutex_batch, batch_blocked_by_unique_lock)
+{
+    this->lock();
+    std::atomic<bool> locked{false};
+    std::jthread reader{[&]
+        {
+            this->lock_shared(2);
+            locked = true;
+            this->unlock_shared(2);
+        }};
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    EXPECT_FALSE(locked);
+    this->unlock();
+    reader.join();
+    EXPECT_TRUE(locked);
+    EXPECT_TRUE(this->try_lock());
+}
+
+TYPED_TEST(test_shared_mutex_batch, add_shared_not_blocked_by_waiting_writer)
+{
+    this->lock_shared();
+    std::atomic<bool> locked{false};
+    std::jthread writer{[&]
+        {
+            this->lock();
+            locked = true;
+            this->unlock();
+        }};
+    this->wait_for_writers(1);
+    this->add_shared(2);
+    this->unlock_shared(2);
+    EXPECT_FALSE(locked);
+    this->unlock_shared();
+    writer.join();
+    EXPECT_TRUE(locked);
+}
+
+template <typename SharedMutex>
+struct test_shared_mutex_stop : public observable_shared_mutex<SharedMutex>, public testing::Test {};
+
+using test_shared_mutex_stop_tuple = testing::Types<slontia::shared_timed_mutex, slontia::padded_shared_timed_mutex,
+    slontia::internal::shared_timed_mutex<slontia::internal::timed_atomic_uint32_t, slontia::compact_layout,
+        slontia::park_wait>,
+    fairness_shared_timed_mutex<slontia::reader_preferring>, fairness_shared_timed_mutex<slontia::phase_fair>,
+    slontia::internal::shared_timed_mutex<slontia::internal::timed_atomic_uint32_t, slontia::compact_layout,
+        slontia::spin_wait<>, slontia::notify_parked, slontia::writer_preferring, slontia::no_stats,
+        slontia::writer_handoff>,
+    slontia::internal::shared_timed_mutex<slontia::internal::parking_lot_timed_atomic_uint32_t,
+        slontia::compact_layout, slontia::park_wait>>;
+
+TYPED_TEST_SUITE(test_shared_mutex_stop, test_shared_mutex_stop_tuple);
+
+TYPED_TEST(test_shared_mutex_stop, lock_if_not_stopped)
+{
+    std::stop_source stop_source;
+    EXPECT_TRUE(this->lock(stop_source.get_token()));
+    this->unlock();
+    EXPECT_TRUE(this->lock_shared(stop_source.get_token()));
+    EXPECT_TRUE(this->lock_shared(std::stop_token{}));
+    this->unlock_shared();
+    this->unlock_shared();
+    // The stopped acquisitions still succeed if they do not have to wait.
+    stop_source.request_stop();
+    EXPECT_TRUE(this->lock_shared(stop_source.get_token()));
+    EXPECT_FALSE(this->lock(stop_source.get_token()));
+    this->unlock_shared();
+    EXPECT_TRUE(this->lock(stop_source.get_token()));
+    EXPECT_FALSE(this->lock_shared(stop_source.get_token()));
+    this->unlock();
+}
+
+TYPED_TEST(test_shared_mutex_stop, stop_waiting_writer)
+{
+    this->lock_shared();
+    std::jthread writer{[&](const std::stop_token stop_token) { EXPECT_FALSE(this->lock(stop_token)); }};
+    this->wait_for_writers(1);
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    writer.request_stop();
+    writer.join();
+    // The readers are not blocked by the writer anymore.
+    EXPECT_EQ(0, this->writing_num_.load());
+    EXPECT_TRUE(this->try_lock_shared());
+    this->unlock_shared();
+    this->unlock_shared();
+    EXPECT_TRUE(this->try_lock());
+    this->unlock();
+}
+
+TYPED_TEST(test_shared_mutex_stop, stop_waiting_reader)
+{
+    this->lock();
+    std::jthread reader{[&](const std::stop_token stop_token) { EXPECT_FALSE(this->lock_shared(stop_token)); }};
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    reader.request_stop();
+    reader.join();
+    this->unlock();
+    // The writers are not blocked by the reader anymore.
+    EXPECT_TRUE(this->try_lock());
+    this->unlock();
+}
+
+TYPED_TEST(test_shared_mutex_stop, waiting_writer_acquires_after_other_writer_stopped)
+{
+    this->lock_shared();
+    std::jthread stopped_writer{[&](const std::stop_token stop_token) { EXPECT_FALSE(this->lock(stop_token)); }};
+    std::atomic<bool> locked{false};
+    std::jthread writer{[&]
+        {
+            EXPECT_TRUE(this->lock(std::stop_token{}));
+            locked = true;
+            this->unlock();
+        }};
+    this->wait_for_writers(2);
+    stopped_writer.request_stop();
+    stopped_writer.join();
+    EXPECT_FALSE(locked);
+    this->unlock_shared();
+    writer.join();
+    EXPECT_TRUE(locked);
+}
+
+template <typename SharedMutex>
+struct test_shared_mutex_deadline : public observable_shared_mutex<SharedMutex>, public testing::Test {};
+
+TYPED_TEST_SUITE(test_shared_mutex_deadline, test_shared_mutex_stop_tuple);
+
+TYPED_TEST(test_shared_mutex_deadline, timeout_not_renewed_by_wakeups)
+{
+    this->lock();
+    std::atomic<bool> finished{false};
+    std::jthread notifier{[&]
+        {
+            while (!finished) {
+                this->writing_num_.notify_all();
+                this->holding_num_.notify_all();
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }};
+    EXPECT_FALSE(this->try_lock_for(std::chrono::milliseconds(20)));
+    EXPECT_FALSE(this->try_lock_shared_for(std::chrono::milliseconds(20)));
+    finished = true;
+    this->unlock();
+}
+
+TYPED_TEST(test_shared_mutex_deadline, share_deadline_across_mutexes)
+{
+    TypeParam other;
+    this->lock();
+    other.lock();
+    const slontia::deadline deadline{std::chrono::milliseconds(10)};
+    EXPECT_FALSE(this->try_lock_until(deadline));
+    EXPECT_TRUE(deadline.expired());
+    EXPECT_FALSE(other.try_lock_shared_until(deadline));
+    this->unlock();
+    other.unlock();
+    // The uncontended acquisitions still succeed after the deadline.
+    EXPECT_TRUE(this->try_lock_until(deadline));
+    EXPECT_TRUE(other.try_lock_shared_until(deadline));
+    this->unlock();
+    other.unlock_shared();
+}
+
+TEST(test_deadline, remaining_and_expired)
+{
+    const slontia::deadline past{std::chrono::steady_clock::now() - std::chrono::seconds(1)};
+    EXPECT_TRUE(past.expired());
+    EXPECT_EQ(std::chrono::steady_clock::duration::zero(), past.remaining());
+
+    const slontia::deadline future{std::chrono::hours(1)};
+    EXPECT_FALSE(future.expired());
+    EXPECT_GT(future.remaining(), std::chrono::minutes(59));
+
+    const slontia::deadline system_future{std::chrono::system_clock::now() + std::chrono::hours(1)};
+    EXPECT_GT(system_future.at(), std::chrono::steady_clock::now() + std::chrono::minutes(59));
+}
+
+TEST(test_packed_shared_mutex, downgrade_unique_lock_to_shared_lock)
+{
+    slontia::packed_shared_mutex mutex;
+    mutex.lock();
+    mutex.unlock_and_lock_shared();
+    EXPECT_TRUE(mutex.try_lock_shared());
+    EXPECT_FALSE(mutex.try_lock());
+    mutex.unlock_shared();
+    mutex.unlock_shared();
+    EXPECT_TRUE(mutex.try_lock());
+}
+
+TEST(test_packed_shared_mutex, writer_blocks_new_readers)
+{
+    slontia::packed_shared_mutex mutex;
+    mutex.lock_shared();
+    std::jthread thread{[&]
+        {
+            mutex.lock();
+            mutex.unlock();
+        }};
+    // Wait until the writer is registered, after which no readers can acquire the mutex.
+    while (mutex.try_lock_shared()) {
+        mutex.unlock_shared();
+        std::this_thread::yield();
+    }
+    mutex.unlock_shared();
+    thread.join();
+    EXPECT_TRUE(mutex.try_lock());
+}
+
+// Exposes the handoff policy to observe whether the writers are parked.
+struct observable_handoff_shared_mutex
+    : public slontia::internal::shared_mutex<std::atomic<std::uint32_t>, slontia::compact_layout, slontia::spin_wait<>,
+        slontia::notify_always, slontia::writer_preferring, slontia::lock_stats<>, slontia::writer_handoff>
+{
+    // Blocks until a writer is parked following the handoff policy.
+    void wait_for_parked_writer()
+    {
+        while (!this->handoff_.has_parked()) {
+            std::this_thread::yield();
+        }
+    }
+};
+
+TEST(test_shared_mutex_handoff, unlock_hands_over_to_parked_writer)
+{
+    observable_handoff_shared_mutex mutex;
+    mutex.lock();
+    std::atomic<bool> writer_locked{false};
+    std::atomic<bool> writer_may_unlock{false};
+    std::jthread writer{[&]
+        {
+            mutex.lock();
+            writer_locked = true;
+            while (!writer_may_unlock) {
+                std::this_thread::yield();
+            }
+            mutex.unlock();
+        }};
+    mutex.wait_for_parked_writer();
+    mutex.unlock();
+    // The mutex has been handed over to the parked writer, so it cannot be stolen even before the writer is scheduled.
+    EXPECT_FALSE(mutex.try_lock());
+    EXPECT_FALSE(mutex.try_lock_shared());
+    while (!writer_locked) {
+        std::this_thread::yield();
+    }
+    writer_may_unlock = true;
+    writer.join();
+    ASSERT_TRUE(mutex.try_lock());
+    mutex.unlock();
+    EXPECT_EQ(1, mutex.stats().exclusive_.contended_acquisition_num_);
+}
+
+TEST(test_shared_mutex_handoff, parked_writer_competes_after_downgrade)
+{
+    observable_handoff_shared_mutex mutex;
+    mutex.lock();
+    std::atomic<bool> writer_locked{false};
+    std::jthread writer{[&]
+        {
+            mutex.lock();
+            writer_locked = true;
+            mutex.unlock();
+        }};
+    mutex.wait_for_parked_writer();
+    // The mutex is not handed over since it is still held in shared mode.
+    mutex.unlock_and_lock_shared();
+    EXPECT_FALSE(writer_locked);
+    mutex.unlock_shared();
+    writer.join();
+    EXPECT_TRUE(writer_locked);
+    ASSERT_TRUE(mutex.try_lock());
+    mutex.unlock();
+}
+
+// Exposes the states of the cohort mutex to observe whether the writers are blocked.
+template <std::uint32_t k_max_handoff_num>
+struct observable_cohort_shared_mutex
+    : public slontia::internal::cohort_shared_mutex<std::atomic<std::uint32_t>, 2, k_max_handoff_num>
+{
+    using slontia::internal::cohort_shared_mutex<std::atomic<std::uint32_t>, 2, k_max_handoff_num>::nodes_;
+
+    // Blocks until `n` writers are waiting for the local mutex of `node`.
+    void wait_for_local_writers(const std::size_t node, const std::uint32_t n)
+    {
+        while (this->nodes_[node].writer_.waiting_num_.load() < n) {
+            std::this_thread::yield();
+        }
+    }
+
+    // Blocks until a writer of `node` is holding the local mutex.
+    void wait_for_local_holder(const std::size_t node)
+    {
+        while (this->nodes_[node].writer_.holding_.load() == 0) {
+            std::this_thread::yield();
+        }
+    }
+};
+
+TEST(test_cohort_shared_mutex, writer_on_same_node_precedes_writer_on_other_node)
+{
+    observable_cohort_shared_mutex<64> mutex;
+    slontia::set_this_thread_numa_node(0);
+    mutex.lock();
+    std::vector<uint32_t> nodes;
+    std::jthread remote_writer{[&]
+        {
+            slontia::set_this_thread_numa_node(1);
+            mutex.lock();
+            nodes.emplace_back(1);
+            mutex.unlock();
+        }};
+    // The remote writer holds the local mutex of node 1, and waits for the global mutex.
+    mutex.wait_for_local_holder(1);
+    std::jthread local_writer{[&]
+        {
+            slontia::set_this_thread_numa_node(0);
+            mutex.lock();
+            nodes.emplace_back(0);
+            mutex.unlock();
+        }};
+    mutex.wait_for_local_writers(0, 1);
+    mutex.unlock();
+    remote_writer.join();
+    local_writer.join();
+    EXPECT_EQ((std::vector<uint32_t>{0, 1}), nodes);
+}
+
+TEST(test_cohort_shared_mutex, release_global_mutex_after_max_handoffs)
+{
+    observable_cohort_shared_mutex<1> mutex;
+    slontia::set_this_thread_numa_node(0);
+    mutex.lock();
+    std::atomic<bool> local_writer_locked{false};
+    std::atomic<bool> local_writer_may_unlock{false};
+    std::jthread local_writer{[&]
+        {
+            slontia::set_this_thread_numa_node(0);
+            mutex.lock();
+            local_writer_locked = true;
+            while (!local_writer_may_unlock) {
+                std::this_thread::yield();
+            }
+            mutex.unlock();
+        }};
+    mutex.wait_for_local_writers(0, 1);
+    // Hand the global mutex over to the local writer.
+    mutex.unlock();
+    while (!local_writer_locked) {
+        std::this_thread::yield();
+    }
+    EXPECT_EQ(1, mutex.nodes_[0].writer_.handoff_num_);
+    std::atomic<bool> another_local_writer_locked{false};
+    std::atomic<bool> another_local_writer_may_unlock{false};
+    std::jthread another_local_writer{[&]
+        {
+            slontia::set_this_thread_numa_node(0);
+            mutex.lock();
+            another_local_writer_locked = true;
+            while (!another_local_writer_may_unlock) {
+                std::this_thread::yield();
+            }
+            mutex.unlock();
+        }};
+    mutex.wait_for_local_writers(0, 1);
+    local_writer_may_unlock = true;
+    local_writer.join();
+    while (!another_local_writer_locked) {
+        std::this_thread::yield();
+    }
+    // The global mutex has been released even though a writer was waiting on the same node, so the writer has locked
+    // the global mutex by itself.
+    EXPECT_EQ(0, mutex.nodes_[0].writer_.handoff_num_);
+    another_local_writer_may_unlock = true;
+    another_local_writer.join();
+    EXPECT_FALSE(mutex.nodes_[0].writer_.global_owned_);
+    EXPECT_TRUE(mutex.try_lock());
+    mutex.unlock();
+}
+
+TEST(test_cohort_shared_mutex, readers_on_different_nodes)
+{
+    slontia::cohort_shared_mutex<2> mutex;
+    slontia::set_this_thread_numa_node(0);
+    mutex.lock_shared();
+    std::jthread reader{[&]
+        {
+            slontia::set_this_thread_numa_node(1);
+            mutex.lock_shared();
+            // Release the shared ownership acquired on the other node.
+            mutex.unlock_shared();
+            mutex.unlock_shared();
+        }};
+    reader.join();
+    EXPECT_TRUE(mutex.try_lock());
+    EXPECT_FALSE(mutex.try_lock_shared());
+    mutex.unlock();
+}
+
+template <typename Fairness>
+using stats_shared_timed_mutex = slontia::internal::shared_timed_mutex<slontia::internal::timed_atomic_uint32_t,
+      slontia::compact_layout, slontia::spin_wait<>, slontia::notify_parked, Fairness, slontia::lock_stats<>>;
+
+template <typename SharedMutex>
+struct test_shared_mutex_stats : public observable_shared_mutex<SharedMutex>, public testing::Test {};
+
+using test_shared_mutex_stats_tuple = testing::Types<stats_shared_timed_mutex<slontia::writer_preferring>,
+      stats_shared_timed_mutex<slontia::reader_preferring>, stats_shared_timed_mutex<slontia::phase_fair>>;
+
+TYPED_TEST_SUITE(test_shared_mutex_stats, test_shared_mutex_stats_tuple);
+
+TYPED_TEST(test_shared_mutex_stats, record_uncontended_acquisitions)
+{
+    this->lock();
+    this->unlock();
+    EXPECT_TRUE(this->try_lock_shared());
+    EXPECT_TRUE(this->try_lock_shared_for(std::chrono::milliseconds(1)));
+    EXPECT_FALSE(this->try_lock());
+    const auto stats = this->stats();
+    EXPECT_EQ(1, stats.exclusive_.acquisition_num_);
+    EXPECT_EQ(0, stats.exclusive_.contended_acquisition_num_);
+    EXPECT_EQ(1, std::accumulate(stats.exclusive_.hold_time_histogram_.begin(),
+                stats.exclusive_.hold_time_histogram_.end(), std::uint64_t{0}));
+    EXPECT_EQ(2, stats.shared_.acquisition_num_);
+    EXPECT_EQ(0, stats.shared_.contended_acquisition_num_);
+    EXPECT_EQ(0, stats.shared_.timeout_num_);
+    this->unlock_shared();
+    this->unlock_shared();
+}
+
+TYPED_TEST(test_shared_mutex_stats, record_timeouts)
+{
+    this->lock_shared();
+    EXPECT_FALSE(this->try_lock_for(std::chrono::milliseconds(1)));
+    this->unlock_shared();
+    this->lock();
+    EXPECT_FALSE(this->try_lock_shared_for(std::chrono::milliseconds(1)));
+    this->unlock();
+    const auto stats = this->stats();
+    EXPECT_EQ(1, stats.exclusive_.timeout_num_);
+    EXPECT_EQ(1, stats.exclusive_.acquisition_num_);
+    EXPECT_EQ(1, stats.shared_.timeout_num_);
+    EXPECT_EQ(1, stats.shared_.acquisition_num_);
+    EXPECT_TRUE(this->try_lock());
+}
+
+TYPED_TEST(test_shared_mutex_stats, record_contended_acquisitions)
+{
+    this->lock();
+    std::jthread reader{[&]
+        {
+            this->lock_shared();
+            this->unlock_shared();
+        }};
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    this->unlock();
+    reader.join();
+    const auto stats = this->stats();
+    EXPECT_EQ(1, stats.shared_.acquisition_num_);
+    EXPECT_EQ(1, stats.shared_.contended_acquisition_num_);
+    EXPECT_EQ(1, std::accumulate(stats.shared_.wait_time_histogram_.begin(), stats.shared_.wait_time_histogram_.end(),
+                std::uint64_t{0}));
+    EXPECT_GT(stats.exclusive_.hold_time_, std::chrono::milliseconds(5));
+}
+
+TEST(test_shared_mutex_stats, record_shared_hold_time_in_progress)
+{
+    slontia::internal::shared_mutex<std::atomic<std::uint32_t>, slontia::compact_layout, slontia::spin_wait<>,
+        slontia::notify_always, slontia::writer_preferring, slontia::lock_stats<>> mutex;
+    mutex.lock_shared();
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    EXPECT_GT(mutex.stats().shared_.hold_time_, std::chrono::milliseconds(5));
+    mutex.unlock_shared();
+    const auto hold_time = mutex.stats().shared_.hold_time_;
+    EXPECT_GT(hold_time, std::chrono::milliseconds(5));
+    EXPECT_EQ(hold_time, mutex.stats().shared_.hold_time_);
+}
+
+TEST(test_shared_mutex_layout, compact_and_padded_size)
+{
+    static_assert(sizeof(slontia::internal::shared_mutex<std::atomic<std::uint32_t>, slontia::compact_layout,
+                slontia::spin_wait<>, slontia::notify_always, slontia::writer_preferring, slontia::no_stats>) ==
+            sizeof(slontia::shared_mutex));
+    static_assert(sizeof(slontia::packed_shared_mutex) == sizeof(std::atomic<std::uint32_t>));
+    static_assert(sizeof(slontia::shared_mutex) == 2 * sizeof(std::atomic<std::uint32_t>));
+    static_assert(sizeof(slontia::padded_shared_mutex) == 2 * slontia::internal::k_cache_line_size);
+    static_assert(alignof(slontia::padded_shared_timed_mutex) == slontia::internal::k_cache_line_size);
+}
+
+template <typename SharedMutex>
+struct test_lock_many : public testing::Test {};
+
+using test_lock_many_tuple = testing::Types<slontia::shared_mutex, slontia::shared_timed_mutex,
+      slontia::padded_shared_timed_mutex,
+      slontia::internal::shared_timed_mutex<slontia::internal::timed_atomic_uint32_t, slontia::compact_layout,
+          slontia::park_wait, slontia::notify_always>>;
+
+TYPED_TEST_SUITE(test_lock_many, test_lock_many_tuple);
+
+TYPED_TEST(test_lock_many, lock_all_mutexes)
+{
+    TypeParam mutex_1;
+    TypeParam mutex_2;
+    slontia::lock_many(mutex_1, mutex_2);
+    EXPECT_FALSE(mutex_1.try_lock_shared());
+    EXPECT_FALSE(mutex_2.try_lock_shared());
+    mutex_1.unlock();
+    mutex_2.unlock();
+    slontia::lock_many_shared(mutex_1, mutex_2);
+    EXPECT_FALSE(mutex_1.try_lock());
+    EXPECT_TRUE(mutex_2.try_lock_shared());
+    mutex_1.unlock_shared();
+    mutex_2.unlock_shared();
+    mutex_2.unlock_shared();
+}
+
+TYPED_TEST(test_lock_many, not_hold_while_blocked)
+{
+    TypeParam mutex_1;
+    TypeParam mutex_2;
+    TypeParam mutex_3;
+    std::atomic<bool> acquired{false};
+    mutex_2.lock();
+    mutex_3.lock_shared();
+    std::jthread thread{[&]
+        {
+            slontia::lock_many(mutex_1, mutex_2, mutex_3);
+            acquired = true;
+            mutex_1.unlock();
+            mutex_2.unlock();
+            mutex_3.unlock();
+        }};
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    EXPECT_FALSE(acquired.load());
+    // The mutex which can be acquired is not held while the thread is blocked by others.
+    EXPECT_TRUE(mutex_1.try_lock());
+    mutex_1.unlock();
+    mutex_2.unlock();
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    EXPECT_FALSE(acquired.load());
+    mutex_3.unlock_shared();
+    thread.join();
+    EXPECT_TRUE(acquired.load());
+}
+
+TYPED_TEST(test_lock_many, shared_blocked_by_writer)
+{
+    TypeParam mutex_1;
+    TypeParam mutex_2;
+    std::atomic<bool> acquired{false};
+    mutex_2.lock();
+    std::jthread thread{[&]
+        {
+            slontia::lock_many_shared(mutex_1, mutex_2);
+            acquired = true;
+            mutex_1.unlock_shared();
+            mutex_2.unlock_shared();
+        }};
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    EXPECT_FALSE(acquired.load());
+    EXPECT_TRUE(mutex_1.try_lock());
+    mutex_1.unlock();
+    mutex_2.unlock();
+    thread.join();
+    EXPECT_TRUE(acquired.load());
+}
+
+TYPED_TEST(test_lock_many, transfer_between_mutexes)
+{
+    static constexpr uint32_t k_thread_num = 4;
+    static constexpr uint32_t k_operation_num = 10000;
+    static constexpr uint32_t k_mutex_num = 4;
+    struct account
+    {
+        TypeParam mutex_;
+        int64_t balance_{0};
+    };
+    std::array<account, k_mutex_num> accounts;
+    {
+        std::vector<std::jthread> threads;
+        for (uint32_t i = 0; i < k_thread_num; ++i) {
+            threads.emplace_back([&, i]
+                {
+                    for (uint32_t j = 0; j < k_operation_num; ++j) {
+                        auto& from = accounts[(i + j) % k_mutex_num];
+                        auto& to = accounts[(i + j * 3 + 1) % k_mutex_num];
+                        if (&from == &to) {
+                            continue;
+                        }
+                        if (j % 4 == 0) {
+                            slontia::lock_many_shared(from.mutex_, to.mutex_);
+                            EXPECT_GE(from.balance_ + to.balance_, -static_cast<int64_t>(k_thread_num * k_operation_num));
+                            from.mutex_.unlock_shared();
+                            to.mutex_.unlock_shared();
+                        } else {
+                            slontia::lock_many(to.mutex_, from.mutex_);
+                            --from.balance_;
+                            ++to.balance_;
+                            from.mutex_.unlock();
+                            to.mutex_.unlock();
+                        }
+                    }
+                });
+        }
+    }
+    int64_t sum = 0;
+    for (const auto& account : accounts) {
+        sum += account.balance_;
+    }
+    EXPECT_EQ(0, sum);
+}
+
+TEST(test_lock_many, different_mutex_types)
+{
+    slontia::shared_mutex mutex_1;
+    slontia::shared_timed_mutex mutex_2;
+    mutex_1.lock_shared();
+    std::jthread thread{[&]
+        {
+            slontia::lock_many(mutex_1, mutex_2);
+            mutex_1.unlock();
+            mutex_2.unlock();
+        }};
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    mutex_1.unlock_shared();
+}
+
+template <typename TimedAtomicUInt32>
+struct test_timed_atomic_uint32 : public testing::Test {};
+
+using test_timed_atomic_uint32_tuple =
+    testing::Types<slontia::internal::timed_atomic_uint32_t, slontia::internal::parking_lot_timed_atomic_uint32_t>;
+
+TYPED_TEST_SUITE(test_timed_atomic_uint32, test_timed_atomic_uint32_tuple);
+
+TYPED_TEST(test_timed_atomic_uint32, wait_until_timeout)
+{
+    TypeParam atom{1};
+    EXPECT_FALSE(atom.wait_until(1, std::chrono::steady_clock::now() + std::chrono::milliseconds(1)));
+    EXPECT_FALSE(atom.wait_until(1, std::chrono::system_clock::now() + std::chrono::milliseconds(1)));
+    EXPECT_FALSE(atom.wait_for(1, std::chrono::milliseconds(1)));
+}
+
+TYPED_TEST(test_timed_atomic_uint32, wait_until_value_changed)
+{
+    TypeParam atom{1};
+    EXPECT_TRUE(atom.wait_until(0, std::chrono::steady_clock::now() + std::chrono::seconds(10)));
+    EXPECT_TRUE(atom.wait_for(0, std::chrono::seconds(10)));
+}
+
+TYPED_TEST(test_timed_atomic_uint32, wait_until_notified)
+{
+    TypeParam atom{0};
+    std::jthread thread{[&]
+        {
+            atom.store(1);
+            atom.notify_all();
+        }};
+    while (atom.load() == 0) {
+        EXPECT_TRUE(atom.wait_until(0, std::chrono::steady_clock::now() + std::chrono::seconds(10)));
+    }
+}
+
+TEST(test_parking_lot_timed_atomic_uint32, notified_without_value_changed)
+{
+    slontia::internal::parking_lot_timed_atomic_uint32_t atom{0};
+    slontia::internal::parking_lot_timed_atomic_uint32_t other_atom{0};
+    std::atomic<bool> woken{false};
+    std::jthread thread{[&]
+        {
+            EXPECT_TRUE(atom.wait_until(0, std::chrono::steady_clock::now() + std::chrono::seconds(10)));
+            woken = true;
+        }};
+    while (!woken.load()) {
+        // The waiter of another address is not woken.
+        other_atom.notify_all();
+        atom.notify_one();
+        std::this_thread::yield();
+    }
+    EXPECT_EQ(0, atom.load());
+}
+
+#if defined(__linux__) || defined(__APPLE__) || defined(__FreeBSD__)
+TEST(test_timed_atomic_uint32, process_shared_wait_until_timeout)
+{
+    slontia::internal::process_shared_timed_atomic_uint32_t atom{1};
+    EXPECT_FALSE(atom.wait_until(1, std::chrono::steady_clock::now() + std::chrono::milliseconds(1)));
+    EXPECT_TRUE(atom.wait_until(0, std::chrono::steady_clock::now() + std::chrono::seconds(10)));
+}
+
+// Maps an anonymous memory region shared with the child processes, and constructs `T` in it.
+template <typename T>
+T* map_shared_object()
+{
+    void* const address = mmap(nullptr, sizeof(T), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    return address == MAP_FAILED ? nullptr : new (address) T{};
+}
+
+template <typename T>
+void unmap_shared_object(T* const object)
+{
+    munmap(object, sizeof(T));
+}
+
+// Forks a child process running `fn`, and returns the exit status of the child process.
+template <typename Fn>
+int run_in_child_process(const Fn& fn)
+{
+    const pid_t pid = fork();
+    if (pid == 0) {
+        fn();
+        _exit(0);
+    }
+    int status = -1;
+    waitpid(pid, &status, 0);
+    return status;
+}
+
+template <typename SharedMutex>
+struct test_process_shared_mutex : public testing::Test {};
+
+using test_process_shared_mutex_tuple = testing::Types<slontia::process_shared_mutex,
+      slontia::robust_process_shared_mutex>;
+
+TYPED_TEST_SUITE(test_process_shared_mutex, test_process_shared_mutex_tuple);
+
+TYPED_TEST(test_process_shared_mutex, exclusive_across_processes)
+{
+    static constexpr uint32_t k_process_num = 4;
+    static constexpr uint32_t k_operation_num = 10000;
+    struct shared_object
+    {
+        TypeParam mutex_;
+        uint64_t a_{0};
+        uint64_t b_{0};
+    };
+    auto* const obj = map_shared_object<shared_object>();
+    ASSERT_NE(nullptr, obj);
+    std::vector<pid_t> pids;
+    for (uint32_t i = 0; i < k_process_num; ++i) {
+        const pid_t pid = fork();
+        if (pid == 0) {
+            bool consistent = true;
+            for (uint32_t j = 0; j < k_operation_num; ++j) {
+                if (j % 2 == 0) {
+                    std::shared_lock lock{obj->mutex_};
+                    consistent = consistent && obj->a_ == obj->b_;
+                } else {
+                    std::unique_lock lock{obj->mutex_};
+                    ++obj->a_;
+                    ++obj->b_;
+                }
+            }
+            _exit(consistent ? 0 : 1);
+        }
+        ASSERT_GT(pid, 0);
+        pids.emplace_back(pid);
+    }
+    for (const pid_t pid : pids) {
+        int status = -1;
+        waitpid(pid, &status, 0);
+        EXPECT_TRUE(WIFEXITED(status));
+        EXPECT_EQ(0, WEXITSTATUS(status));
+    }
+    EXPECT_EQ(k_process_num * k_operation_num / 2, obj->a_);
+    EXPECT_EQ(obj->a_, obj->b_);
+    unmap_shared_object(obj);
+}
+
+TYPED_TEST(test_process_shared_mutex, wait_for_another_process)
+{
+    auto* const mutex = map_shared_object<TypeParam>();
+    ASSERT_NE(nullptr, mutex);
+    mutex->lock();
+    const pid_t pid = fork();
+    if (pid == 0) {
+        // Blocked until the parent process unlocks.
+        mutex->lock_shared();
+        mutex->unlock_shared();
+        _exit(mutex->try_lock_for(std::chrono::seconds(10)) ? 0 : 1);
+    }
+    ASSERT_GT(pid, 0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    mutex->unlock();
+    int status = -1;
+    waitpid(pid, &status, 0);
+    EXPECT_TRUE(WIFEXITED(status));
+    EXPECT_EQ(0, WEXITSTATUS(status));
+    // The child process exits with the exclusive ownership held.
+    EXPECT_FALSE(mutex->try_lock_shared());
+    unmap_shared_object(mutex);
+}
+
+TEST(test_robust_process_shared_mutex, recover_from_dead_owner)
+{
+    auto* const mutex = map_shared_object<slontia::robust_process_shared_mutex>();
+    ASSERT_NE(nullptr, mutex);
+    EXPECT_EQ(0, run_in_child_process([&] { mutex->lock(); }));
+    EXPECT_FALSE(mutex->try_lock());
+    EXPECT_FALSE(mutex->try_lock_shared_for(std::chrono::milliseconds(1)));
+    // The dead owner is found when the acquisition fails for `k_owner_check_interval`.
+    mutex->lock_shared();
+    mutex->unlock_shared();
+    EXPECT_EQ(0, run_in_child_process([&] { mutex->lock(); }));
+    EXPECT_TRUE(mutex->try_lock_for(std::chrono::seconds(10)));
+    EXPECT_TRUE(mutex->recovered());
+    EXPECT_FALSE(mutex->recovered());
+    mutex->unlock();
+    unmap_shared_object(mutex);
+}
+
+TEST(test_robust_process_shared_mutex, not_recover_from_alive_owner)
+{
+    auto* const mutex = map_shared_object<slontia::robust_process_shared_mutex>();
+    ASSERT_NE(nullptr, mutex);
+    mutex->lock();
+    EXPECT_EQ(0, run_in_child_process([&]
+                {
+                    _exit(mutex->try_lock_shared_for(slontia::robust_process_shared_mutex::k_owner_check_interval * 3)
+                                ? 1 : 0);
+                }));
+    EXPECT_FALSE(mutex->recovered());
+    mutex->unlock();
+    unmap_shared_object(mutex);
+}
+#endif
+
+#ifdef __linux__
+TEST(test_pi_futex, owner_is_this_thread)
+{
+    slontia::internal::pi_futex_t lock;
+    EXPECT_EQ(0, lock.owner());
+    lock.lock();
+    EXPECT_EQ(syscall(SYS_gettid), lock.owner());
+    std::jthread([&] { EXPECT_FALSE(lock.try_lock()); }).join();
+    lock.unlock();
+    EXPECT_EQ(0, lock.owner());
+}
+
+TEST(test_pi_futex, ownership_transferred_by_kernel)
+{
+    slontia::internal::pi_futex_t lock;
+    std::atomic<bool> acquired{false};
+    lock.lock();
+    std::jthread thread{[&]
+        {
+            lock.lock();
+            acquired = true;
+            lock.unlock();
+        }};
+    // Wait until the thread is blocked in the kernel, which sets `FUTEX_WAITERS` so that we unlock by the kernel.
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    EXPECT_FALSE(acquired.load());
+    lock.unlock();
+    thread.join();
+    EXPECT_TRUE(acquired.load());
+    EXPECT_EQ(0, lock.owner());
+}
+
+TEST(test_pi_shared_mutex, exclusive_and_shared)
+{
+    slontia::pi_shared_mutex mutex;
+    mutex.lock();
+    std::jthread([&]
+        {
+            EXPECT_FALSE(mutex.try_lock());
+            EXPECT_FALSE(mutex.try_lock_shared());
+        }).join();
+    mutex.unlock();
+    EXPECT_TRUE(mutex.try_lock_shared());
+    EXPECT_TRUE(mutex.try_lock_shared());
+    EXPECT_FALSE(mutex.try_lock());
+    mutex.unlock_shared();
+    mutex.unlock_shared();
+    EXPECT_TRUE(mutex.try_lock());
+    mutex.unlock();
+}
+
+TEST(test_pi_shared_mutex, reader_blocked_by_writer)
+{
+    slontia::pi_shared_mutex mutex;
+    std::atomic<bool> acquired{false};
+    mutex.lock();
+    std::jthread thread{[&]
+        {
+            mutex.lock_shared();
+            acquired = true;
+            mutex.unlock_shared();
+        }};
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    EXPECT_FALSE(acquired.load());
+    mutex.unlock();
+    thread.join();
+    EXPECT_TRUE(acquired.load());
+}
+
+TEST(test_pi_shared_mutex, concurrent_reads_and_writes)
+{
+    static constexpr uint32_t k_thread_num = 4;
+    static constexpr uint32_t k_operation_num = 10000;
+    slontia::pi_shared_mutex mutex;
+    uint64_t a = 0;
+    uint64_t b = 0;
+    {
+        std::vector<std::jthread> threads;
+        for (uint32_t i = 0; i < k_thread_num; ++i) {
+            threads.emplace_back([&, i]
+                {
+                    for (uint32_t j = 0; j < k_operation_num; ++j) {
+                        if ((i + j) % 4 == 0) {
+                            std::unique_lock lock{mutex};
+                            ++a;
+                            ++b;
+                        } else {
+                            std::shared_lock lock{mutex};
+                            EXPECT_EQ(a, b);
+                        }
+                    }
+                });
+        }
+    }
+    EXPECT_EQ(k_thread_num * k_operation_num / 4, a);
+    EXPECT_EQ(a, b);
+}
+#endif